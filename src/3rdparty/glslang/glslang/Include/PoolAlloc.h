@@ -176,6 +176,26 @@ public:
     //
     void* allocate(size_t numBytes);
 
+    //
+    // Call setMemoryLimit() to cap the number of bytes the pool may hold
+    // in pages that are in use.  Zero means no limit.  Going over the limit
+    // does not make allocate() fail, since callers do not check for that;
+    // instead isMemoryLimitExceeded() becomes true, and the owner of the
+    // pool is expected to abandon the work at the next opportunity.
+    //
+    void setMemoryLimit(size_t numBytes) { memoryLimit = numBytes; }
+    size_t getMemoryLimit() const { return memoryLimit; }
+    bool isMemoryLimitExceeded() const { return memoryLimitExceeded; }
+
+    //
+    // Peak number of bytes held in pages that were in use since the last
+    // call to resetPeak().  resetPeak() also clears the exceeded flag.
+    //
+    size_t getPeakBytes() const { return peakBytes; }
+    void resetPeak() { peakBytes = bytesInUse; memoryLimitExceeded = false; }
+
+    size_t getPageSize() const { return pageSize; }
+
     //
     // There is no deallocate.  The point of this class is that
     // deallocation can be skipped by the user of it, as the model
@@ -240,6 +260,13 @@ protected:
 
     int numCalls;           // just an interesting statistic
     size_t totalBytes;      // just an interesting statistic
+
+    void pageAcquired(size_t numBytes);
+
+    size_t bytesInUse;      // bytes held by the pages in inUseList
+    size_t peakBytes;       // high-water mark of bytesInUse
+    size_t memoryLimit;     // 0 means unlimited
+    bool memoryLimitExceeded;
 private:
     TPoolAllocator& operator=(const TPoolAllocator&);  // don't allow assignment operator
     TPoolAllocator(const TPoolAllocator&);  // don't allow default copy constructor
@@ -74,7 +74,11 @@ TPoolAllocator::TPoolAllocator(int growthIncrement, int allocationAlignment) :
     alignment(allocationAlignment),
     freeList(nullptr),
     inUseList(nullptr),
-    numCalls(0)
+    numCalls(0),
+    bytesInUse(0),
+    peakBytes(0),
+    memoryLimit(0),
+    memoryLimitExceeded(false)
 {
     //
     // Don't allow page sizes we know are smaller than all common
@@ -208,6 +212,8 @@ void TPoolAllocator::pop()
         // but we will still control the memory and reuse it.
         inUseList->~tHeader(); // currently, just a debug allocation checker
 
+        bytesInUse -= pageCount * pageSize;
+
         if (pageCount > 1) {
             delete [] reinterpret_cast<char*>(inUseList);
         } else {
@@ -271,8 +277,10 @@ void* TPoolAllocator::allocate(size_t numBytes)
             return 0;
 
         // Use placement-new to initialize header
-        new(memory) tHeader(inUseList, (numBytesToAlloc + pageSize - 1) / pageSize);
+        const size_t pageCount = (numBytesToAlloc + pageSize - 1) / pageSize;
+        new(memory) tHeader(inUseList, pageCount);
         inUseList = memory;
+        pageAcquired(pageCount * pageSize);
 
         currentPageOffset = pageSize;  // make next allocation come from a new page
 
@@ -296,6 +304,7 @@ void* TPoolAllocator::allocate(size_t numBytes)
     // Use placement-new to initialize header
     new(memory) tHeader(inUseList, 1);
     inUseList = memory;
+    pageAcquired(pageSize);
 
     unsigned char* ret = reinterpret_cast<unsigned char*>(inUseList) + headerSkip;
     currentPageOffset = (headerSkip + allocationSize + alignmentMask) & ~alignmentMask;
@@ -303,6 +312,18 @@ void* TPoolAllocator::allocate(size_t numBytes)
     return initializeAllocation(inUseList, ret, numBytes);
 }
 
+//
+// Account for a page (or multi-page block) that got put on the in-use list.
+//
+void TPoolAllocator::pageAcquired(size_t numBytes)
+{
+    bytesInUse += numBytes;
+    if (bytesInUse > peakBytes)
+        peakBytes = bytesInUse;
+    if (memoryLimit && bytesInUse > memoryLimit)
+        memoryLimitExceeded = true;
+}
+
 //
 // Check all allocations in a list for damage by calling check on each.
 //
@@ -41,6 +41,7 @@
 // This is the platform independent interface between an OGL driver
 // and the shading language compiler/linker.
 //
+#include <atomic>
 #include <cstring>
 #include <iostream>
 #include <sstream>
@@ -226,6 +227,11 @@ enum EPrecisionClass {
 TSymbolTable* CommonSymbolTable[VersionCount][SpvVersionCount][ProfileCount][SourceCount][EPcCount] = {};
 TSymbolTable* SharedSymbolTables[VersionCount][SpvVersionCount][ProfileCount][SourceCount][EShLangCount] = {};
 
+// Set, with release semantics, once the tables above are complete for a given
+// version/profile combination, so that threads can check for existing tables
+// without taking the global lock.
+std::atomic<bool> SymbolTablesReady[VersionCount][SpvVersionCount][ProfileCount][SourceCount] = {};
+
 TPoolAllocator* PerProcessGPA = nullptr;
 
 //
@@ -409,17 +415,24 @@ bool AddContextSpecificSymbols(const TBuiltInResource* resources, TInfoSink& inf
 //
 void SetupBuiltinSymbolTable(int version, EProfile profile, const SpvVersion& spvVersion, EShSource source)
 {
+    int versionIndex = MapVersionToIndex(version);
+    int spvVersionIndex = MapSpvVersionToIndex(spvVersion);
+    int profileIndex = MapProfileToIndex(profile);
+    int sourceIndex = MapSourceToIndex(source);
+    std::atomic<bool>& ready = SymbolTablesReady[versionIndex][spvVersionIndex][profileIndex][sourceIndex];
+
+    // Fast path: the tables exist already, and are never modified again
+    // until FinalizeProcess()
+    if (ready.load(std::memory_order_acquire))
+        return;
+
     TInfoSink infoSink;
 
     // Make sure only one thread tries to do this at a time
     glslang::GetGlobalLock();
 
-    // See if it's already been done for this version/profile combination
-    int versionIndex = MapVersionToIndex(version);
-    int spvVersionIndex = MapSpvVersionToIndex(spvVersion);
-    int profileIndex = MapProfileToIndex(profile);
-    int sourceIndex = MapSourceToIndex(source);
-    if (CommonSymbolTable[versionIndex][spvVersionIndex][profileIndex][sourceIndex][EPcGeneral]) {
+    // See if another thread did it while we were waiting for the lock
+    if (ready.load(std::memory_order_relaxed)) {
         glslang::ReleaseGlobalLock();
 
         return;
@@ -471,6 +484,9 @@ void SetupBuiltinSymbolTable(int version, EProfile profile, const SpvVersion& sp
     delete builtInPoolAllocator;
     SetThreadPoolAllocator(&previousAllocator);
 
+    // Publish the tables to the lock-free readers
+    ready.store(true, std::memory_order_release);
+
     glslang::ReleaseGlobalLock();
 }
 
@@ -1376,6 +1392,7 @@ int ShFinalize()
         for (int spvVersion = 0; spvVersion < SpvVersionCount; ++spvVersion) {
             for (int p = 0; p < ProfileCount; ++p) {
                 for (int source = 0; source < SourceCount; ++source) {
+                    SymbolTablesReady[version][spvVersion][p][source].store(false, std::memory_order_relaxed);
                     for (int stage = 0; stage < EShLangCount; ++stage) {
                         delete SharedSymbolTables[version][spvVersion][p][source][stage];
                         SharedSymbolTables[version][spvVersion][p][source][stage] = 0;
@@ -1700,9 +1717,16 @@ public:
 };
 
 TShader::TShader(EShLanguage s)
-    : stage(s), lengths(nullptr), stringNames(nullptr), preamble("")
+    : TShader(s, nullptr)
 {
-    pool = new TPoolAllocator;
+}
+
+TShader::TShader(EShLanguage s, TPoolAllocator* externalPool)
+    : pool(externalPool), ownsPool(externalPool == nullptr),
+      stage(s), lengths(nullptr), stringNames(nullptr), preamble("")
+{
+    if (ownsPool)
+        pool = new TPoolAllocator;
     infoSink = new TInfoSink;
     compiler = new TDeferredCompiler(stage, *infoSink);
     intermediate = new TIntermediate(s);
@@ -1720,7 +1744,8 @@ TShader::~TShader()
     delete infoSink;
     delete compiler;
     delete intermediate;
-    delete pool;
+    if (ownsPool)
+        delete pool;
 }
 
 void TShader::setStrings(const char* const* s, int n)
@@ -1874,13 +1899,19 @@ const char* TShader::getInfoDebugLog()
     return infoSink->debug.c_str();
 }
 
-TProgram::TProgram() :
+TProgram::TProgram() : TProgram(nullptr)
+{
+}
+
+TProgram::TProgram(TPoolAllocator* externalPool) :
+    pool(externalPool), ownsPool(externalPool == nullptr),
 #ifndef GLSLANG_WEB
     reflection(0),
 #endif
     linked(false)
 {
-    pool = new TPoolAllocator;
+    if (ownsPool)
+        pool = new TPoolAllocator;
     infoSink = new TInfoSink;
     for (int s = 0; s < EShLangCount; ++s) {
         intermediate[s] = 0;
@@ -1899,7 +1930,8 @@ TProgram::~TProgram()
         if (newedIntermediate[s])
             delete intermediate[s];
 
-    delete pool;
+    if (ownsPool)
+        delete pool;
 }
 
 //
@@ -407,6 +407,10 @@ enum TResourceType {
 class TShader {
 public:
     explicit TShader(EShLanguage);
+    // Allocate from 'pool' instead of a private pool. The pool is not owned;
+    // the caller is responsible for push()/pop() around the lifetime of the
+    // shader and of any program it gets linked into.
+    TShader(EShLanguage, TPoolAllocator* pool);
     virtual ~TShader();
     void setStrings(const char* const* s, int n);
     void setStringsWithLengths(const char* const* s, const int* l, int n);
@@ -615,6 +619,7 @@ public:
 
 protected:
     TPoolAllocator* pool;
+    bool ownsPool;
     EShLanguage stage;
     TCompiler* compiler;
     TIntermediate* intermediate;
@@ -773,6 +778,8 @@ public:
 class TProgram {
 public:
     TProgram();
+    // Allocate from 'pool' instead of a private pool. The pool is not owned.
+    explicit TProgram(TPoolAllocator* pool);
     virtual ~TProgram();
     void addShader(TShader* shader) { stages[shader->stage].push_back(shader); }
     std::list<TShader*>& getShaders(EShLanguage stage) { return stages[stage]; }
@@ -883,6 +890,7 @@ protected:
     bool linkStage(EShLanguage, EShMessages);
 
     TPoolAllocator* pool;
+    bool ownsPool;
     std::list<TShader*> stages[EShLangCount];
     TIntermediate* intermediate[EShLangCount];
     bool newedIntermediate[EShLangCount];      // track which intermediate were "new" versus reusing a singleton unit in a stage
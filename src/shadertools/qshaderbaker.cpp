@@ -27,13 +27,19 @@
 **
 ****************************************************************************/
 
-#include "qshaderbaker.h"
-#include "qspirvcompiler_p.h"
+#include "qshaderbaker_p.h"
 #include "qspirvshader_p.h"
+#include "qspirvvaryingpruner_p.h"
+#include "qspirvcompact_p.h"
+#include "qspirvglslversions_p.h"
+#include <QtCore/qendian.h>
 #include <QFileInfo>
 #include <QFile>
+#include <QMap>
 #include <QDebug>
 
+#include <algorithm>
+
 QT_BEGIN_NAMESPACE
 
 /*!
@@ -57,8 +63,7 @@ QT_BEGIN_NAMESPACE
     restricted to cases where run time compilation cannot be avoided, such as
     when working with user-provided shader source strings.
 
-    The input format is always assumed to be Vulkan-flavored GLSL at the
-    moment. See the
+    The input format is Vulkan-flavored GLSL in most cases. See the
     \l{https://github.com/KhronosGroup/GLSL/blob/master/extensions/khr/GL_KHR_vulkan_glsl.txt}{GL_KHR_vulkan_glsl
     specification} for an overview, keeping in mind that the Qt Shader Tools
     module is meant to be used in combination with the QRhi classes from Qt
@@ -69,6 +74,11 @@ QT_BEGIN_NAMESPACE
     \l{https://docs.microsoft.com/en-us/windows/desktop/direct3dhlsl/dx-graphics-hlsl}{HLSL}
     as a source format, once HLSL to SPIR-V compilation is deemed suitable.
 
+    Alternatively, the input can be a SPIR-V binary that was produced by some
+    other front end, see setSourceSpirv(). In this case the compilation step
+    is skipped altogether, and the SPIR-V is only reflected and translated to
+    the requested targets.
+
     The reflection metadata is retrievable from the resulting QShader by
     calling QShader::description(). This is essential when having to
     discover what set of vertex inputs and shader resources a shader expects,
@@ -134,33 +144,27 @@ QT_BEGIN_NAMESPACE
     \sa QShader
  */
 
-struct QShaderBakerPrivate
-{
-    bool readFile(const QString &fn);
-
-    QString sourceFileName;
-    QByteArray source;
-    QShader::Stage stage;
-    QVector<QShaderBaker::GeneratedShader> reqVersions;
-    QVector<QShader::Variant> variants;
-    QByteArray preamble;
-    int batchLoc = 7;
-    QSpirvCompiler compiler;
-    QString errorMessage;
-};
-
-bool QShaderBakerPrivate::readFile(const QString &fn)
+bool QShaderBakerPrivate::readFile(const QString &fn, bool binary)
 {
     QFile f(fn);
-    if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    QIODevice::OpenMode mode = QIODevice::ReadOnly;
+    if (!binary)
+        mode |= QIODevice::Text;
+    if (!f.open(mode)) {
         qWarning("QShaderBaker: Failed to open %s", qPrintable(fn));
         return false;
     }
     source = f.readAll();
+    sourceIsSpirv = binary;
     sourceFileName = fn;
     return true;
 }
 
+static inline bool isSpirvFileName(const QString &fn)
+{
+    return QFileInfo(fn).suffix() == QStringLiteral("spv");
+}
+
 /*!
     Constructs a new QShaderBaker.
  */
@@ -192,13 +196,19 @@ QShaderBaker::~QShaderBaker()
     \li \c{.geom} - geometry shader
     \li \c{.comp} - compute shader
     \endlist
+
+    Files with the \c{.spv} extension are treated as SPIR-V binaries, see
+    setSourceSpirv(). For these the stage is deduced from the extension
+    preceding \c{.spv}, for example \c{color.frag.spv} is a fragment shader.
  */
 void QShaderBaker::setSourceFileName(const QString &fileName)
 {
-    if (!d->readFile(fileName))
+    const bool spirv = isSpirvFileName(fileName);
+    if (!d->readFile(fileName, spirv))
         return;
 
-    const QString suffix = QFileInfo(fileName).suffix();
+    const QString suffix = spirv ? QFileInfo(QFileInfo(fileName).completeBaseName()).suffix()
+                                 : QFileInfo(fileName).suffix();
     if (suffix == QStringLiteral("vert")) {
         d->stage = QShader::VertexStage;
     } else if (suffix == QStringLiteral("frag")) {
@@ -221,10 +231,13 @@ void QShaderBaker::setSourceFileName(const QString &fileName)
     Sets the name of the shader source file to \a fileName. This is the file
     that will be read when calling bake(). The shader stage is specified by \a
     stage.
+
+    Files with the \c{.spv} extension are treated as SPIR-V binaries, see
+    setSourceSpirv().
  */
 void QShaderBaker::setSourceFileName(const QString &fileName, QShader::Stage stage)
 {
-    if (d->readFile(fileName))
+    if (d->readFile(fileName, isSpirvFileName(fileName)))
         d->stage = stage;
 }
 
@@ -247,6 +260,33 @@ void QShaderBaker::setSourceString(const QByteArray &sourceString, QShader::Stag
 {
     d->sourceFileName = fileName; // for error messages, include handling, etc.
     d->source = sourceString;
+    d->sourceIsSpirv = false;
+    d->stage = stage;
+}
+
+/*!
+    Sets the input to the SPIR-V binary \a spirv. \a stage specifies the
+    shader stage, while the optional \a fileName contains a filename that is
+    used in the error messages.
+
+    This is useful when the SPIR-V is generated by some other front end, or
+    when an existing set of SPIR-V modules needs to be rebaked for new
+    targets. No GLSL compilation takes place in bake(): \a spirv is reflected
+    and translated as-is, and is also what ends up in the QShader when a
+    QShader::SpirvShader target is requested.
+
+    \a spirv may be in either byte order, and is converted to the native one
+    when needed. It can also be in the compact encoding written by \c{qsb -x spirv.100
+    --compact-spirv}, in which case it is decoded first.
+
+    \note The QShader::BatchableVertexShader variant relies on rewriting the
+    GLSL source, and is therefore never generated for SPIR-V input.
+ */
+void QShaderBaker::setSourceSpirv(const QByteArray &spirv, QShader::Stage stage, const QString &fileName)
+{
+    d->sourceFileName = fileName;
+    d->source = spirv;
+    d->sourceIsSpirv = true;
     d->stage = stage;
 }
 
@@ -300,6 +340,8 @@ void QShaderBaker::setGeneratedShaderVariants(const QVector<QShader::Variant> &v
 
     One use case for preambles is to transparently insert dynamically generated
     \c{#define} statements.
+
+    \note The preamble has no effect when the input is SPIR-V.
  */
 void QShaderBaker::setPreamble(const QByteArray &preamble)
 {
@@ -318,50 +360,273 @@ void QShaderBaker::setBatchableVertexShaderExtraInputLocation(int location)
 }
 
 /*!
-    Runs the compilation and translation process.
+    Sets the page \a size, in bytes, of the memory pool the GLSL compiler
+    allocates from. The default is 8 KB. Values smaller than 4 KB are rounded
+    up.
 
-    \return a QShader instance. To check if the process was successful,
-    call QShader::isValid(). When that indicates \c false, call
-    errorMessage() to retrieve the log.
+    The pool is per thread and is kept across bake() calls, so after the first
+    bake on a given thread most allocations are served from pages that are
+    already in place. Larger pages mean fewer allocations from the system for
+    big shaders, at the expense of more memory kept reserved between bakes.
 
-    This is an expensive operation. When calling this from applications, it can
-    be advisable to do it on a separate thread.
+    Passing 0 restores the default.
 
-    \note QShaderBaker instances are reusable: after calling bake(), the same
-    instance can be used with different inputs again. However, a QShaderBaker
-    instance should only be used on one single thread during its lifetime.
+    \note The setting has no effect when the input is SPIR-V.
  */
-QShader QShaderBaker::bake()
+void QShaderBaker::setCompilerPoolPageSize(int size)
 {
-    d->errorMessage.clear();
+    d->compiler.setPoolPageSize(size);
+}
 
-    if (d->source.isEmpty()) {
-        d->errorMessage = QLatin1String("QShaderBaker: No source specified");
-        return QShader();
+/*!
+    Limits the memory the GLSL compiler may use while compiling a single shader
+    to \a bytes. When the limit is exceeded, bake() fails and errorMessage()
+    reports the amount of memory that was in use.
+
+    The limit is enforced between the parsing, linking, and SPIR-V generation
+    steps, so the actual peak can be somewhat above \a bytes, but is bounded by
+    what one step allocates. This is useful when baking shaders at run time on
+    devices with little memory, where failing predictably is preferable to
+    running out of memory.
+
+    By default there is no limit. Passing 0 removes the limit.
+
+    \note The setting has no effect when the input is SPIR-V.
+
+    \sa setCompilerPoolPageSize()
+ */
+void QShaderBaker::setCompilerMemoryLimit(qint64 bytes)
+{
+    d->compiler.setMemoryLimit(bytes);
+}
+
+/*!
+    Sets the \a resolver providing the files pulled in via \c{#include}. When
+    not set, which is the default, included files are looked up in the file
+    system relative to the including file.
+
+    The resolver is not owned by the QShaderBaker, and must stay valid while
+    baking. Passing null restores the default.
+
+    \note The setting has no effect when the input is SPIR-V.
+
+    \sa QShaderIncludeBundle, includedFiles()
+ */
+void QShaderBaker::setIncludeResolver(const QShaderIncludeResolver *resolver)
+{
+    d->compiler.setIncludeResolver(resolver);
+}
+
+bool QShaderBakerPrivate::compile(QByteArray *spirv, QByteArray *batchableSpirv)
+{
+    if (source.isEmpty()) {
+        errorMessage = QLatin1String("QShaderBaker: No source specified");
+        return false;
     }
 
-    d->compiler.setSourceString(d->source, d->stage, d->sourceFileName);
-    d->compiler.setFlags({});
-    d->compiler.setPreamble(d->preamble);
-    QByteArray spirv = d->compiler.compileToSpirv();
-    if (spirv.isEmpty()) {
-        d->errorMessage = d->compiler.errorMessage();
-        return QShader();
+    if (sourceIsSpirv && QSpirvCompact::isCompact(source)) {
+        source = QSpirvCompact::decode(source);
+        if (source.isEmpty()) {
+            errorMessage = QString::fromLatin1("QShaderBaker: Failed to decode compact SPIR-V in %1")
+                    .arg(sourceFileName.isEmpty() ? QLatin1String("input") : sourceFileName);
+            return false;
+        }
     }
 
-    QByteArray batchableSpirv;
-    if (d->stage == QShader::VertexStage && d->variants.contains(QShader::BatchableVertexShader)) {
-        d->compiler.setFlags(QSpirvCompiler::RewriteToMakeBatchableForSG);
-        d->compiler.setSGBatchingVertexInputLocation(d->batchLoc);
-        batchableSpirv = d->compiler.compileToSpirv();
-        if (batchableSpirv.isEmpty()) {
-            d->errorMessage = d->compiler.errorMessage();
-            return QShader();
+    if (sourceIsSpirv) {
+        static const quint32 spirvMagic = 0x07230203;
+        const quint32 magic = source.size() >= 4 ? qFromUnaligned<quint32>(source.constData()) : 0;
+        if (source.size() < 20 || source.size() % 4
+                || (magic != spirvMagic && magic != qbswap(spirvMagic)))
+        {
+            errorMessage = QString::fromLatin1("QShaderBaker: %1 is not a valid SPIR-V binary")
+                    .arg(sourceFileName.isEmpty() ? QLatin1String("Input") : sourceFileName);
+            return false;
+        }
+        if (magic != spirvMagic) {
+            // SPIR-V may come in either byte order, everything else expects the native one
+            QByteArray swapped(source.size(), Qt::Uninitialized);
+            for (int i = 0; i < source.size(); i += 4)
+                qToUnaligned(qbswap(qFromUnaligned<quint32>(source.constData() + i)), swapped.data() + i);
+            source = swapped;
+        }
+        *spirv = source;
+    } else {
+        compiler.setSourceString(source, stage, sourceFileName);
+        compiler.setFlags({});
+        compiler.setPreamble(preamble);
+        *spirv = compiler.compileToSpirv();
+        for (const QString &fn : compiler.includedFiles()) {
+            if (!includedFiles.contains(fn))
+                includedFiles.append(fn);
+        }
+        for (const QByteArray &macro : compiler.referencedPreambleMacros()) {
+            if (!referencedPreambleMacros.contains(macro))
+                referencedPreambleMacros.append(macro);
+        }
+        if (spirv->isEmpty()) {
+            errorMessage = compiler.errorMessage();
+            return false;
+        }
+    }
+
+    batchableSpirv->clear();
+    if (stage == QShader::VertexStage && variants.contains(QShader::BatchableVertexShader)
+            && !sourceIsSpirv)
+    {
+        compiler.setFlags(QSpirvCompiler::RewriteToMakeBatchableForSG);
+        compiler.setSGBatchingVertexInputLocation(batchLoc);
+        *batchableSpirv = compiler.compileToSpirv();
+        if (batchableSpirv->isEmpty()) {
+            errorMessage = compiler.errorMessage();
+            return false;
+        }
+    }
+
+    specializedIds.clear();
+    if (!specConstants.isEmpty()) {
+        QString msg;
+        *spirv = QSpirvShader::specializedSpirvBinary(*spirv, specConstants, &msg, &specializedIds);
+        if (msg.isEmpty() && !batchableSpirv->isEmpty()) {
+            QSet<int> batchableIds;
+            *batchableSpirv = QSpirvShader::specializedSpirvBinary(*batchableSpirv, specConstants, &msg, &batchableIds);
+            specializedIds += batchableIds;
+        }
+        if (!msg.isEmpty()) {
+            errorMessage = QString::fromLatin1("QShaderBaker: Failed to specialize %1: %2")
+                    .arg(sourceFileName.isEmpty() ? QLatin1String("shader") : sourceFileName, msg);
+            return false;
         }
     }
 
+    return true;
+}
+
+QString QShaderBakerPrivate::unknownSpecConstantsError(const QSet<int> &declaredIds, const QString &where) const
+{
+    QList<int> unknown;
+    for (auto it = specConstants.cbegin(), end = specConstants.cend(); it != end; ++it) {
+        if (!declaredIds.contains(it.key()))
+            unknown.append(it.key());
+    }
+    if (unknown.isEmpty())
+        return QString();
+    std::sort(unknown.begin(), unknown.end());
+    return QString::fromLatin1("QShaderBaker: No specialization constant with constant_id %1 in %2")
+            .arg(unknown.first()).arg(where);
+}
+
+// Generates the GLSL code for a number of versions with as few SPIRV-Cross
+// runs as possible. SPIRV-Cross emits something else than the #version
+// directive only at the thresholds QSpirvGlslVersions finds for the module,
+// so the versions between two thresholds form a group, and only the lowest
+// version of each group is translated. The others get its result with the
+// directive patched.
+class GlslVersionTranslator
+{
+public:
+    GlslVersionTranslator(QSpirvShader *spirvShader, int *translationCount)
+        : spirvShader(spirvShader), translationCount(translationCount)
+    { }
+
+    bool translate(const QVector<QShaderVersion> &versions);
+    QByteArray result(const QShaderVersion &version) const { return results.value(resultKey(version)); }
+    QString errorMessage() const { return errorMsg; }
+
+private:
+    static int resultKey(const QShaderVersion &v)
+    {
+        return v.version() * 2 + (v.flags().testFlag(QShaderVersion::GlslEs) ? 1 : 0);
+    }
+    static QByteArray withVersionDirective(const QByteArray &code, const QShaderVersion &v);
+    int versionClass(const QShaderVersion &v);
+    QByteArray translateOne(const QShaderVersion &v);
+
+    QSpirvShader *spirvShader;
+    int *translationCount;
+    QVector<int> thresholds[2]; // desktop, ES
+    QHash<int, QByteArray> results;
+    QString errorMsg;
+};
+
+QByteArray GlslVersionTranslator::withVersionDirective(const QByteArray &code, const QShaderVersion &v)
+{
+    if (!code.startsWith("#version "))
+        return QByteArray();
+    const int lineEnd = code.indexOf('\n');
+    if (lineEnd < 0)
+        return QByteArray();
+
+    QByteArray directive = QByteArrayLiteral("#version ") + QByteArray::number(v.version());
+    if (v.flags().testFlag(QShaderVersion::GlslEs) && v.version() >= 300)
+        directive += QByteArrayLiteral(" es");
+    return directive + code.mid(lineEnd);
+}
+
+int GlslVersionTranslator::versionClass(const QShaderVersion &v)
+{
+    const bool es = v.flags().testFlag(QShaderVersion::GlslEs);
+    QVector<int> &t(thresholds[es ? 1 : 0]);
+    if (t.isEmpty())
+        t = QSpirvGlslVersions::thresholds(spirvShader->spirvBinary(), es);
+
+    int c = 0;
+    for (int threshold : qAsConst(t)) {
+        if (v.version() >= threshold)
+            ++c;
+    }
+    return es ? 100 + c : c;
+}
+
+QByteArray GlslVersionTranslator::translateOne(const QShaderVersion &v)
+{
+    QSpirvShader::GlslFlags flags;
+    if (v.flags().testFlag(QShaderVersion::GlslEs))
+        flags |= QSpirvShader::GlslEs;
+    ++*translationCount;
+    const QByteArray code = spirvShader->translateToGLSL(v.version(), flags);
+    if (code.isEmpty())
+        errorMsg = spirvShader->translationErrorMessage();
+    else
+        results.insert(resultKey(v), code);
+    return code;
+}
+
+bool GlslVersionTranslator::translate(const QVector<QShaderVersion> &versions)
+{
+    QMap<int, QVector<QShaderVersion>> groups;
+    for (const QShaderVersion &v : versions) {
+        if (!results.contains(resultKey(v)))
+            groups[versionClass(v)].append(v);
+    }
+
+    for (QVector<QShaderVersion> &group : groups) {
+        std::sort(group.begin(), group.end(), [](const QShaderVersion &a, const QShaderVersion &b) {
+            return a.version() < b.version();
+        });
+
+        const QByteArray code = translateOne(group.first());
+        if (code.isEmpty())
+            return false;
+        for (int i = 1; i < group.count(); ++i) {
+            if (results.contains(resultKey(group[i])))
+                continue;
+            const QByteArray patched = withVersionDirective(code, group[i]);
+            if (patched.isEmpty()) {
+                if (translateOne(group[i]).isEmpty())
+                    return false;
+            } else {
+                results.insert(resultKey(group[i]), patched);
+            }
+        }
+    }
+    return true;
+}
+
+QShader QShaderBakerPrivate::translate(const QByteArray &spirv, const QByteArray &batchableSpirv)
+{
     QShader bs;
-    bs.setStage(d->stage);
+    bs.setStage(stage);
 
     QSpirvShader spirvShader;
     spirvShader.setSpirvBinary(spirv);
@@ -374,66 +639,261 @@ QShader QShaderBaker::bake()
         bs.setDescription(spirvShader.shaderDescription());
     }
 
-    for (const GeneratedShader &req: d->reqVersions) {
-        for (const QShader::Variant &v : d->variants) {
-            QByteArray *currentSpirv = &spirv;
+    if (sink) {
+        QVector<QShaderKey> keys;
+        for (const QShaderBaker::GeneratedShader &req: reqVersions) {
+            for (const QShader::Variant &v : variants) {
+                if (v != QShader::BatchableVertexShader || !batchableSpirv.isEmpty())
+                    keys.append(QShaderKey(req.first, req.second, v));
+            }
+        }
+        if (!sink->begin(stage, bs.description(), keys)) {
+            errorMessage = QLatin1String("QShaderBaker: Failed to write output");
+            return QShader();
+        }
+    }
+
+    QVector<QShaderVersion> glslVersions;
+    for (const QShaderBaker::GeneratedShader &req: reqVersions) {
+        if (req.first == QShader::GlslShader)
+            glslVersions.append(req.second);
+    }
+    glslTranslationCount = 0;
+    GlslVersionTranslator glslTranslator(&spirvShader, &glslTranslationCount);
+    GlslVersionTranslator batchableGlslTranslator(&batchableSpirvShader, &glslTranslationCount);
+    bool glslTranslated = false;
+    bool batchableGlslTranslated = false;
+
+    for (const QShaderBaker::GeneratedShader &req: reqVersions) {
+        for (const QShader::Variant &v : variants) {
+            const QByteArray *currentSpirv = &spirv;
             QSpirvShader *currentSpirvShader = &spirvShader;
+            GlslVersionTranslator *currentGlslTranslator = &glslTranslator;
+            bool *currentGlslTranslated = &glslTranslated;
             if (v == QShader::BatchableVertexShader) {
                 if (!batchableSpirv.isEmpty()) {
                     currentSpirv = &batchableSpirv;
                     currentSpirvShader = &batchableSpirvShader;
+                    currentGlslTranslator = &batchableGlslTranslator;
+                    currentGlslTranslated = &batchableGlslTranslated;
                 } else {
                     continue;
                 }
             }
             const QShaderKey key(req.first, req.second, v);
             QShaderCode shader;
+            QShader::NativeResourceBindingMap nativeBindings;
+            bool hasNativeBindings = false;
             shader.setEntryPoint(QByteArrayLiteral("main"));
             switch (req.first) {
             case QShader::SpirvShader:
                 shader.setShader(*currentSpirv);
                 break;
             case QShader::GlslShader:
-            {
-                QSpirvShader::GlslFlags flags;
-                if (req.second.flags().testFlag(QShaderVersion::GlslEs))
-                    flags |= QSpirvShader::GlslEs;
-                shader.setShader(currentSpirvShader->translateToGLSL(req.second.version(), flags));
-                if (shader.shader().isEmpty()) {
-                    d->errorMessage = currentSpirvShader->translationErrorMessage();
-                    return QShader();
+                // all GLSL versions are generated in one go, on first use
+                if (!*currentGlslTranslated) {
+                    if (!currentGlslTranslator->translate(glslVersions)) {
+                        errorMessage = currentGlslTranslator->errorMessage();
+                        return QShader();
+                    }
+                    *currentGlslTranslated = true;
                 }
-            }
+                shader.setShader(currentGlslTranslator->result(req.second));
                 break;
             case QShader::HlslShader:
                 shader.setShader(currentSpirvShader->translateToHLSL(req.second.version()));
                 if (shader.shader().isEmpty()) {
-                    d->errorMessage = currentSpirvShader->translationErrorMessage();
+                    errorMessage = currentSpirvShader->translationErrorMessage();
                     return QShader();
                 }
                 break;
             case QShader::MslShader:
-            {
-                QShader::NativeResourceBindingMap nativeBindings;
                 shader.setShader(currentSpirvShader->translateToMSL(req.second.version(), &nativeBindings));
                 if (shader.shader().isEmpty()) {
-                    d->errorMessage = currentSpirvShader->translationErrorMessage();
+                    errorMessage = currentSpirvShader->translationErrorMessage();
                     return QShader();
                 }
                 shader.setEntryPoint(QByteArrayLiteral("main0"));
-                bs.setResourceBindingMap(key, nativeBindings);
-            }
+                hasNativeBindings = true;
                 break;
             default:
                 Q_UNREACHABLE();
             }
+            if (sink) {
+                if (!sink->addShader(key, shader, hasNativeBindings ? &nativeBindings : nullptr)) {
+                    errorMessage = QLatin1String("QShaderBaker: Failed to write output");
+                    return QShader();
+                }
+                continue;
+            }
             bs.setShader(key, shader);
+            if (hasNativeBindings)
+                bs.setResourceBindingMap(key, nativeBindings);
         }
     }
 
     return bs;
 }
 
+/*!
+    Sets the values of specialization constants to \a values, where the keys
+    are the \c constant_id values from the shader's
+    \c{layout(constant_id = N)} qualifiers.
+
+    The specialization constants listed in \a values are turned into regular
+    constants in the SPIR-V before any translation happens, so all generated
+    shaders, including the SPIR-V one, have the values baked in. Constants not
+    listed keep their default value and remain specializable in the SPIR-V.
+    Listing a \c constant_id that does not exist in the shader is an error.
+    With bakePipeline(), each stage gets the constants it declares, and it is
+    only an error when none of the stages declares a listed \c constant_id.
+    A value that cannot be converted to the type of the constant, such as
+    \c{"foo"} for a bool, is an error as well.
+
+    Combined with setSourceSpirv(), this allows generating any number of
+    specialized shaders from one SPIR-V module without compiling the GLSL
+    source again.
+
+    By default the list is empty and no specialization takes place.
+ */
+void QShaderBaker::setSpecializationConstants(const QHash<int, QVariant> &values)
+{
+    d->specConstants = values;
+}
+
+/*!
+    Runs the compilation and translation process.
+
+    \return a QShader instance. To check if the process was successful,
+    call QShader::isValid(). When that indicates \c false, call
+    errorMessage() to retrieve the log.
+
+    This is an expensive operation. When calling this from applications, it can
+    be advisable to do it on a separate thread.
+
+    \note QShaderBaker instances are reusable: after calling bake(), the same
+    instance can be used with different inputs again. However, a QShaderBaker
+    instance should only be used on one single thread during its lifetime.
+ */
+QShader QShaderBaker::bake()
+{
+    d->errorMessage.clear();
+    d->includedFiles.clear();
+    d->referencedPreambleMacros.clear();
+
+    QByteArray spirv;
+    QByteArray batchableSpirv;
+    if (!d->compile(&spirv, &batchableSpirv))
+        return QShader();
+    if (!d->skipUnknownSpecConstants) {
+        d->errorMessage = d->unknownSpecConstantsError(d->specializedIds, d->sourceFileName.isEmpty()
+                                                       ? QLatin1String("the shader") : d->sourceFileName);
+        if (!d->errorMessage.isEmpty())
+            return QShader();
+    }
+
+    return d->translate(spirv, batchableSpirv);
+}
+
+/*!
+    Bakes all stages of a graphics pipeline in one go. \a fileNames contains
+    the shader source files, one per stage, in pipeline order: vertex, then
+    the optional tessellation control, tessellation evaluation, and geometry
+    stages, and finally fragment. The stages are deduced from the file
+    extensions, like with setSourceFileName(). Compute shaders are not
+    accepted.
+
+    Knowing the whole pipeline allows removing the stage outputs that are
+    never read by the following stage, together with the code computing them,
+    and the stage inputs that are never read in the shader. This happens on
+    the SPIR-V level, so all generated targets benefit from it.
+
+    \return a list of QShader instances, one for each entry in \a fileNames,
+    or an empty list on failure, in which case errorMessage() contains the
+    log. All other settings, such as the generated shaders, variants, and the
+    preamble, apply to all stages. includedFiles() reports the files included
+    by any of the stages.
+
+    \note The outputs of the last stage, as well as built-in variables, are
+    never removed.
+
+    \note The source set via setSourceFileName() and similar functions is
+    replaced when calling this function.
+
+    \sa bake()
+ */
+QVector<QShader> QShaderBaker::bakePipeline(const QStringList &fileNames)
+{
+    d->errorMessage.clear();
+    d->includedFiles.clear();
+    d->referencedPreambleMacros.clear();
+
+    const int stageCount = fileNames.count();
+    QVector<QShader::Stage> stages(stageCount);
+    QVector<QByteArray> spirv(stageCount);
+    QVector<QByteArray> batchableSpirv(stageCount);
+    QSet<int> specializedIds;
+
+    // The stages are compiled one by one, not linked as one glslang
+    // TProgram: the SPIR-V generator works on one stage at a time either way,
+    // and the batchable vertex shader is a rewritten copy of the vertex stage
+    // that has to be paired with the same fragment shader as the original.
+    // The interface between the stages is matched by location afterwards.
+    for (int i = 0; i < stageCount; ++i) {
+        d->source.clear();
+        setSourceFileName(fileNames[i]);
+        if (d->source.isEmpty()) {
+            d->errorMessage = QString::fromLatin1("QShaderBaker: Failed to read %1").arg(fileNames[i]);
+            return {};
+        }
+        if (d->stage == QShader::ComputeStage) {
+            d->errorMessage = QString::fromLatin1("QShaderBaker: %1 is a compute shader, "
+                                                  "which cannot be part of a graphics pipeline")
+                    .arg(fileNames[i]);
+            return {};
+        }
+        if (i > 0 && d->stage <= stages[i - 1]) {
+            d->errorMessage = QString::fromLatin1("QShaderBaker: %1 is out of order in the pipeline")
+                    .arg(fileNames[i]);
+            return {};
+        }
+        stages[i] = d->stage;
+        if (!d->compile(&spirv[i], &batchableSpirv[i]))
+            return {};
+        specializedIds += d->specializedIds;
+    }
+
+    // A constant only needs to exist in one of the stages.
+    d->errorMessage = d->unknownSpecConstantsError(specializedIds, QLatin1String("any stage of the pipeline"));
+    if (!d->errorMessage.isEmpty())
+        return {};
+
+    // Going backwards so that removing inputs of a stage may in turn allow
+    // removing the corresponding outputs, and the code computing those, in
+    // the previous one.
+    for (int i = stageCount - 1; i >= 0; --i) {
+        spirv[i] = QSpirvVaryingPruner::removeUnusedInputs(spirv[i]);
+        if (i < stageCount - 1) {
+            spirv[i] = QSpirvVaryingPruner::removeUnusedOutputs(spirv[i], spirv[i + 1]);
+            if (!batchableSpirv[i].isEmpty())
+                batchableSpirv[i] = QSpirvVaryingPruner::removeUnusedOutputs(batchableSpirv[i], spirv[i + 1]);
+        }
+    }
+
+    QVector<QShader> result;
+    result.reserve(stageCount);
+    for (int i = 0; i < stageCount; ++i) {
+        d->stage = stages[i];
+        d->sourceFileName = fileNames[i];
+        const QShader bs = d->translate(spirv[i], batchableSpirv[i]);
+        if (!d->errorMessage.isEmpty())
+            return {};
+        result.append(bs);
+    }
+
+    return result;
+}
+
 /*!
     \return the error message from the last bake() run, or an empty string if
     there was no error.
@@ -447,4 +907,42 @@ QString QShaderBaker::errorMessage() const
     return d->errorMessage;
 }
 
+/*!
+    \return the canonical paths of the files that were pulled in via
+    \c{#include} during the last bake() or bakePipeline() run. With an include
+    resolver set, the paths are the ones returned by
+    QShaderIncludeResolver::resolve().
+
+    This is useful for tools that need to know when a shader has to be rebaked,
+    for example because a header it depends on has changed. The list is
+    available also when bake() failed, as long as the failure happened after
+    the includes were processed.
+ */
+QStringList QShaderBaker::includedFiles() const
+{
+    return d->includedFiles;
+}
+
+/*!
+    \return the names of the macros defined in the preamble that the shader,
+    or any of the files it includes, refers to, as of the last bake() or
+    bakePipeline() run.
+
+    Changing the definition of any other macro in the preamble does not
+    affect the results. Caches and build tools can therefore take only these
+    macros into account when deciding if a shader needs to be rebaked, instead
+    of the entire preamble. The list may contain macros that turn out not to
+    matter, for example because they are only referred to in a disabled
+    \c{#if} block, but never misses one that does.
+
+    Like includedFiles(), the list is available also when bake() failed, as
+    long as the failure happened after preprocessing.
+
+    \sa setPreamble()
+ */
+QByteArrayList QShaderBaker::referencedPreambleMacros() const
+{
+    return d->referencedPreambleMacros;
+}
+
 QT_END_NAMESPACE
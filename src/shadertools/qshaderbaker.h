@@ -32,11 +32,16 @@
 
 #include <QtShaderTools/qtshadertoolsglobal.h>
 #include <QtGui/private/qshader_p.h>
+#include <QtCore/qstringlist.h>
+#include <QtCore/qbytearraylist.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qvariant.h>
 
 QT_BEGIN_NAMESPACE
 
 struct QShaderBakerPrivate;
 class QIODevice;
+class QShaderIncludeResolver;
 
 class Q_SHADERTOOLS_EXPORT QShaderBaker
 {
@@ -53,20 +58,31 @@ public:
     void setSourceString(const QByteArray &sourceString, QShader::Stage stage,
                          const QString &fileName = QString());
 
+    void setSourceSpirv(const QByteArray &spirv, QShader::Stage stage,
+                        const QString &fileName = QString());
+
     typedef QPair<QShader::Source, QShaderVersion> GeneratedShader;
     void setGeneratedShaders(const QVector<GeneratedShader> &v);
     void setGeneratedShaderVariants(const QVector<QShader::Variant> &v);
 
     void setPreamble(const QByteArray &preamble);
     void setBatchableVertexShaderExtraInputLocation(int location);
+    void setSpecializationConstants(const QHash<int, QVariant> &values);
+    void setCompilerPoolPageSize(int size);
+    void setCompilerMemoryLimit(qint64 bytes);
+    void setIncludeResolver(const QShaderIncludeResolver *resolver);
 
     QShader bake();
+    QVector<QShader> bakePipeline(const QStringList &fileNames);
 
     QString errorMessage() const;
+    QStringList includedFiles() const;
+    QByteArrayList referencedPreambleMacros() const;
 
 private:
     Q_DISABLE_COPY(QShaderBaker)
     QShaderBakerPrivate *d = nullptr;
+    friend struct QShaderBakerPrivate;
 };
 
 QT_END_NAMESPACE
@@ -0,0 +1,105 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Shader Tools module
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QSHADERBAKER_P_H
+#define QSHADERBAKER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists for the convenience
+// of a number of Qt sources files.  This header file may change from
+// version to version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtShaderTools/qshaderbaker.h>
+#include <QtShaderTools/private/qspirvcompiler_p.h>
+#include <QtCore/QSet>
+
+QT_BEGIN_NAMESPACE
+
+// Receives the results of bake() one by one, as soon as they are generated,
+// instead of collecting them all in the returned QShader. This keeps the
+// memory usage of tools writing large packs at the size of a single shader.
+class QShaderBakerSink
+{
+public:
+    virtual ~QShaderBakerSink() = default;
+
+    // Called once, before any shader is generated. keys is the full list of
+    // shaders that will follow.
+    virtual bool begin(QShader::Stage stage, const QShaderDescription &description,
+                       const QVector<QShaderKey> &keys) = 0;
+    // nativeBindings is null when the target has no native resource binding map
+    virtual bool addShader(const QShaderKey &key, const QShaderCode &shader,
+                           const QShader::NativeResourceBindingMap *nativeBindings) = 0;
+};
+
+struct QShaderBakerPrivate
+{
+    static QShaderBakerPrivate *get(QShaderBaker *b) { return b->d; }
+
+    bool readFile(const QString &fn, bool binary);
+    bool compile(QByteArray *spirv, QByteArray *batchableSpirv);
+    QShader translate(const QByteArray &spirv, const QByteArray &batchableSpirv);
+    QString unknownSpecConstantsError(const QSet<int> &declaredIds, const QString &where) const;
+
+    QString sourceFileName;
+    QByteArray source;
+    bool sourceIsSpirv = false;
+    QShader::Stage stage;
+    QVector<QShaderBaker::GeneratedShader> reqVersions;
+    QVector<QShader::Variant> variants;
+    QByteArray preamble;
+    int batchLoc = 7;
+    QHash<int, QVariant> specConstants;
+    // The constant_ids from specConstants that the last compile() found.
+    QSet<int> specializedIds;
+    // Tools baking several files with the same constants check the ids
+    // across all of them instead of failing bake() for each file.
+    bool skipUnknownSpecConstants = false;
+    QSpirvCompiler compiler;
+    QString errorMessage;
+    QStringList includedFiles;
+    QByteArrayList referencedPreambleMacros;
+    // When set, bake() passes the generated shaders to the sink and returns a
+    // QShader with only the stage and description set. Success is then
+    // indicated by an empty errorMessage.
+    QShaderBakerSink *sink = nullptr;
+    // The number of SPIRV-Cross runs for GLSL in the last translate(), for
+    // the autotests.
+    int glslTranslationCount = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif
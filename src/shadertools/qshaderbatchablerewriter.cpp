@@ -28,6 +28,11 @@
 ****************************************************************************/
 
 #include "qshaderbatchablerewriter_p.h"
+#include <QtCore/qalgorithms.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 // This is a slightly modified version of qsgshaderrewriter.cpp from
 // qtdeclarative/src/quick/scenegraph/coreapi. Here we insert an extra vertex
@@ -37,30 +42,6 @@ QT_BEGIN_NAMESPACE
 
 namespace QShaderBatchableRewriter {
 
-struct Tokenizer {
-
-    enum Token {
-        Token_Void,
-        Token_OpenBrace,
-        Token_CloseBrace,
-        Token_SemiColon,
-        Token_Identifier,
-        Token_Macro,
-        Token_Unspecified,
-
-        Token_EOF
-    };
-
-    static const char *NAMES[];
-
-    void initialize(const QByteArray &input);
-    Token next();
-
-    const char *stream;
-    const char *pos;
-    const char *identifier;
-};
-
 const char *Tokenizer::NAMES[] = {
     "Void",
     "OpenBrace",
@@ -72,82 +53,208 @@ const char *Tokenizer::NAMES[] = {
     "EOF"
 };
 
-void Tokenizer::initialize(const QByteArray &input)
+// The scanning helpers below return the first position in [p, end) that
+// does not belong to the run being skipped. A 0 byte always ends a run, to
+// match the behavior of walking a null-terminated string. With SSE2 16
+// bytes are classified at once; the scalar loop handles the tail, and is
+// also the fallback on other architectures.
+
+static inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline bool isIdentifierStart(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static inline bool isIdentifierChar(char c)
+{
+    return isIdentifierStart(c) || (c >= '0' && c <= '9');
+}
+
+#ifdef __SSE2__
+static inline const char *findSse2(const char *p, const char *end, char c1, char c2)
+{
+    const __m128i v1 = _mm_set1_epi8(c1);
+    const __m128i v2 = _mm_set1_epi8(c2);
+    const __m128i zero = _mm_setzero_si128();
+    while (end - p >= 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const __m128i match = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, v1), _mm_cmpeq_epi8(chunk, v2)),
+                                           _mm_cmpeq_epi8(chunk, zero));
+        const uint mask = uint(_mm_movemask_epi8(match));
+        if (mask)
+            return p + qCountTrailingZeroBits(mask);
+        p += 16;
+    }
+    return p;
+}
+
+static inline const char *skipSpaceSse2(const char *p, const char *end)
+{
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)),
+                                        _mm_or_si128(_mm_cmpeq_epi8(chunk, cr), _mm_cmpeq_epi8(chunk, lf)));
+        const uint mask = ~uint(_mm_movemask_epi8(ws)) & 0xFFFF;
+        if (mask)
+            return p + qCountTrailingZeroBits(mask);
+        p += 16;
+    }
+    return p;
+}
+
+static inline const char *skipIdentifierSse2(const char *p, const char *end)
+{
+    // Unsigned range checks done with signed compares: x - lo + 128 < -128 + n
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+    const __m128i alphaBias = _mm_set1_epi8(char(128 - 'a'));
+    const __m128i alphaLimit = _mm_set1_epi8(char(-128 + 26));
+    const __m128i digitBias = _mm_set1_epi8(char(128 - '0'));
+    const __m128i digitLimit = _mm_set1_epi8(char(-128 + 10));
+    const __m128i underscore = _mm_set1_epi8('_');
+    while (end - p >= 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const __m128i lower = _mm_or_si128(chunk, caseBit);
+        const __m128i alpha = _mm_cmplt_epi8(_mm_add_epi8(lower, alphaBias), alphaLimit);
+        const __m128i digit = _mm_cmplt_epi8(_mm_add_epi8(chunk, digitBias), digitLimit);
+        const __m128i ident = _mm_or_si128(_mm_or_si128(alpha, digit), _mm_cmpeq_epi8(chunk, underscore));
+        const uint mask = ~uint(_mm_movemask_epi8(ident)) & 0xFFFF;
+        if (mask)
+            return p + qCountTrailingZeroBits(mask);
+        p += 16;
+    }
+    return p;
+}
+#endif
+
+static inline const char *find(const char *p, const char *end, char c1, char c2, bool simd)
+{
+#ifdef __SSE2__
+    if (simd)
+        p = findSse2(p, end, c1, c2);
+#else
+    Q_UNUSED(simd);
+#endif
+    while (p < end && *p != c1 && *p != c2 && *p != 0)
+        ++p;
+    return p;
+}
+
+static inline const char *skipSpace(const char *p, const char *end, bool simd)
+{
+#ifdef __SSE2__
+    if (simd)
+        p = skipSpaceSse2(p, end);
+#else
+    Q_UNUSED(simd);
+#endif
+    while (p < end && isSpace(*p))
+        ++p;
+    return p;
+}
+
+static inline const char *skipIdentifier(const char *p, const char *end, bool simd)
+{
+#ifdef __SSE2__
+    if (simd)
+        p = skipIdentifierSse2(p, end);
+#else
+    Q_UNUSED(simd);
+#endif
+    while (p < end && isIdentifierChar(*p))
+        ++p;
+    return p;
+}
+
+void Tokenizer::initialize(const QByteArray &input, bool allowSimd)
 {
     stream = input.constData();
     pos = input;
+    end = input.constData() + input.size();
     identifier = input;
+#ifdef __SSE2__
+    simd = allowSimd;
+#else
+    Q_UNUSED(allowSimd);
+    simd = false;
+#endif
 }
 
 Tokenizer::Token Tokenizer::next()
 {
-    while (*pos != 0) {
+    while (pos < end && *pos != 0) {
         char c = *pos++;
         switch (c) {
         case '/':
-
-            if (*pos == '/') {
+            if (pos < end && *pos == '/') {
                 // '//' comment
-                ++pos;
-                while (*pos != 0 && *pos != '\n') ++pos;
-                if (*pos != 0) ++pos; // skip the newline
+                pos = find(pos + 1, end, '\n', '\n', simd);
+                if (pos < end && *pos == '\n')
+                    ++pos; // skip the newline
 
-            } else if (*pos == '*') {
-                // /* */ comment
+            } else if (pos < end && *pos == '*') {
+                // /* */ comment, may contain anything, including braces
                 ++pos;
-                while (*pos != 0 && *pos != '*' && pos[1] != '/') ++pos;
-                if (*pos != 0) pos += 2;
+                for (;;) {
+                    pos = find(pos, end, '*', '*', simd);
+                    if (pos == end || *pos == 0)
+                        break;
+                    ++pos;
+                    if (pos < end && *pos == '/') {
+                        ++pos;
+                        break;
+                    }
+                }
             }
             break;
 
-        case '#': {
-            while (*pos != 0) {
+        case '#':
+            while (pos < end && *pos != 0) {
+                pos = find(pos, end, '\n', '\\', simd);
+                if (pos == end || *pos == 0)
+                    break;
                 if (*pos == '\n') {
                     ++pos;
                     break;
-                } else if (*pos == '\\') {
+                }
+                // line continuation
+                ++pos;
+                while (pos < end && (*pos == ' ' || *pos == '\t'))
                     ++pos;
-                    while (*pos != 0 && (*pos == ' ' || *pos == '\t'))
-                        ++pos;
-                    if (*pos != 0 && (*pos == '\n' || (*pos == '\r' && pos[1] == '\n')))
-                        pos+=2;
-                } else {
+                if (pos < end && *pos == '\n')
                     ++pos;
-                }
+                else if (end - pos >= 2 && *pos == '\r' && pos[1] == '\n')
+                    pos += 2;
             }
             break;
-        }
-
-        case 'v': {
-            if (*pos == 'o' && pos[1] == 'i' && pos[2] == 'd') {
-                pos += 3;
-                return Token_Void;
-            }
-            Q_FALLTHROUGH();
-        }
 
         case ';': return Token_SemiColon;
-        case 0: return Token_EOF;
         case '{': return Token_OpenBrace;
         case '}': return Token_CloseBrace;
 
         case ' ':
+        case '\t':
         case '\n':
-        case '\r': break;
+        case '\r':
+            pos = skipSpace(pos, end, simd);
+            break;
+
         default:
-            // Identifier...
-            if ((c >= 'a' && c <= 'z' ) || (c >= 'A' && c <= 'Z' ) || c == '_') {
+            if (isIdentifierStart(c)) {
                 identifier = pos - 1;
-                while (*pos != 0 && ((*pos >= 'a' && *pos <= 'z')
-                                     || (*pos >= 'A' && *pos <= 'Z')
-                                     || *pos == '_'
-                                     || (*pos >= '0' && *pos <= '9'))) {
-                    ++pos;
-                }
+                pos = skipIdentifier(pos, end, simd);
+                if (pos - identifier == 4 && qstrncmp(identifier, "void", 4) == 0)
+                    return Token_Void;
                 return Token_Identifier;
-            } else {
-                return Token_Unspecified;
             }
+            return Token_Unspecified;
         }
     }
 
@@ -166,7 +273,7 @@ QByteArray addZAdjustment(const QByteArray &input, int vertexInputLocation)
     const char* voidPos = input.constData();
     while (t != Tokenizer::Token_EOF) {
         if (lt == Tokenizer::Token_Void && t == Tokenizer::Token_Identifier) {
-            if (qstrncmp("main", tok.identifier, 4) == 0)
+            if (tok.pos - tok.identifier == 4 && qstrncmp("main", tok.identifier, 4) == 0)
                 break;
         }
         voidPos = tok.pos - 4;
@@ -195,7 +302,7 @@ QByteArray addZAdjustment(const QByteArray &input, int vertexInputLocation)
             if (braceDepth == 0) {
                 result += QByteArray::fromRawData(voidPos, tok.pos - 1 - voidPos);
                 result += QByteArrayLiteral("    gl_Position.z = _qt_order * gl_Position.w;\n");
-                result += QByteArray(tok.pos - 1);
+                result += QByteArray(tok.pos - 1, int(tok.end - tok.pos + 1));
                 return result;
             }
             break;
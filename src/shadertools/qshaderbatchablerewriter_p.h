@@ -41,12 +41,43 @@
 // We mean it.
 //
 
+#include <QtShaderTools/private/qtshadertoolsglobal_p.h>
 #include <QtCore/QByteArray>
 
 QT_BEGIN_NAMESPACE
 
 namespace QShaderBatchableRewriter {
+
+struct Q_SHADERTOOLS_PRIVATE_EXPORT Tokenizer {
+
+    enum Token {
+        Token_Void,
+        Token_OpenBrace,
+        Token_CloseBrace,
+        Token_SemiColon,
+        Token_Identifier,
+        Token_Macro,
+        Token_Unspecified,
+
+        Token_EOF
+    };
+
+    static const char *NAMES[];
+
+    // allowSimd is there for testing the scalar code path on machines that
+    // would otherwise use the vectorized one
+    void initialize(const QByteArray &input, bool allowSimd = true);
+    Token next();
+
+    const char *stream;
+    const char *pos;
+    const char *end;
+    const char *identifier;
+    bool simd;
+};
+
 QByteArray addZAdjustment(const QByteArray &input, int vertexInputLocation);
+
 }
 
 QT_END_NAMESPACE
@@ -0,0 +1,430 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Shader Tools module
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qshaderincluderesolver.h"
+#include <QtCore/qfile.h>
+#include <QtCore/qdir.h>
+#include <QtCore/qfileinfo.h>
+#include <QtCore/qdiriterator.h>
+#include <QtCore/qresource.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qmap.h>
+#include <QtCore/qendian.h>
+#include <QtCore/qscopedpointer.h>
+#include <QDebug>
+
+#include <algorithm>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QShaderIncludeResolver
+    \inmodule QtShaderTools
+
+    \brief Provides the files pulled in via \c{#include} when compiling shaders.
+
+    By default QShaderBaker looks up included files in the file system,
+    relative to the file that includes them. Setting a resolver with
+    QShaderBaker::setIncludeResolver() replaces this lookup, which is useful
+    when the headers are not available as individual files, or when the cost
+    of accessing the file system for each include matters, for example when
+    baking shaders at run time on embedded devices.
+
+    Resolvers may be used from multiple threads at the same time, when
+    multiple QShaderBaker instances share one. The functions are therefore
+    const and must not modify the resolver.
+
+    \sa QShaderIncludeBundle
+ */
+
+/*!
+    Destructor.
+ */
+QShaderIncludeResolver::~QShaderIncludeResolver()
+{
+}
+
+/*!
+    \fn QString QShaderIncludeResolver::resolve(const QString &headerName, const QString &includerName) const
+
+    \return the path identifying the file included as \a headerName from the
+    file \a includerName, or an empty string when there is no such file.
+
+    \a includerName is the name of the shader source file or the path returned
+    for a previously resolved include. The returned path is what
+    QShaderBaker::includedFiles() reports, and what contents() is called with.
+ */
+
+/*!
+    \fn QByteArray QShaderIncludeResolver::contents(const QString &path) const
+
+    \return the contents of the file \a path, as returned by resolve().
+
+    The data is only read during the bake, so it can reference memory owned by
+    the resolver, as created by QByteArray::fromRawData(), instead of being a
+    copy.
+ */
+
+/*!
+    \class QShaderIncludeBundle
+    \inmodule QtShaderTools
+
+    \brief A QShaderIncludeResolver serving headers from memory.
+
+    The files can be added one by one with addFile(), or all at once from a
+    directory, including a resource directory, with addDirectory(). Files in
+    resources that are stored uncompressed are not copied, their data is
+    accessed in place via QResource::data().
+
+    Alternatively, a bundle created by serialize() can be loaded with load()
+    or loadData(). The bundle contains an index sorted by path, so looking up
+    a file does not involve building any data structures first, and the
+    contents are accessed without copying from the memory mapped file or
+    resource.
+
+    Paths are normalized with QDir::cleanPath(), and the \c{qrc:} scheme is
+    treated the same as the \c{:} prefix. A relative header name is looked up
+    relative to the directory of the including file, while a header name
+    starting with \c{/} or \c{:} is looked up as is.
+
+    \note The bundle must stay alive, and unchanged, while bakes using it are
+    in progress.
+ */
+
+// Bundle layout, all integers are 32-bit little endian:
+//   "QSIB", version, count
+//   count x (path offset, path size, data offset, data size), sorted by path
+//   the paths (UTF-8) and the data
+// Offsets are relative to the start of the bundle.
+static const char BUNDLE_MAGIC[4] = { 'Q', 'S', 'I', 'B' };
+static const quint32 BUNDLE_VERSION = 1;
+static const int BUNDLE_HEADER_SIZE = 12;
+static const int BUNDLE_ENTRY_SIZE = 16;
+
+struct QShaderIncludeBundlePrivate
+{
+    const uchar *entry(int i) const
+    {
+        return reinterpret_cast<const uchar *>(bundle.constData()) + BUNDLE_HEADER_SIZE + i * BUNDLE_ENTRY_SIZE;
+    }
+    QByteArray entryPath(int i) const
+    {
+        const uchar *e = entry(i);
+        return QByteArray::fromRawData(bundle.constData() + qFromLittleEndian<quint32>(e),
+                                       int(qFromLittleEndian<quint32>(e + 4)));
+    }
+    QByteArray entryData(int i) const
+    {
+        const uchar *e = entry(i);
+        return QByteArray::fromRawData(bundle.constData() + qFromLittleEndian<quint32>(e + 8),
+                                       int(qFromLittleEndian<quint32>(e + 12)));
+    }
+    int find(const QString &path) const;
+
+    QHash<QString, QByteArray> files;
+    QByteArray bundle;
+    int bundleCount = 0;
+    QScopedPointer<QFile> mappedFile;
+};
+
+static QString normalizedPath(const QString &path)
+{
+    if (path.startsWith(QLatin1String("qrc:")))
+        return QDir::cleanPath(path.mid(3));
+    return QDir::cleanPath(path);
+}
+
+// Binary search in the index as stored in the bundle, so nothing needs to be
+// built when loading.
+int QShaderIncludeBundlePrivate::find(const QString &path) const
+{
+    if (!bundleCount)
+        return -1;
+
+    const QByteArray key = path.toUtf8();
+    int lo = 0;
+    int hi = bundleCount;
+    while (lo < hi) {
+        const int mid = (lo + hi) / 2;
+        if (entryPath(mid) < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo < bundleCount && entryPath(lo) == key ? lo : -1;
+}
+
+/*!
+    Constructs an empty bundle.
+ */
+QShaderIncludeBundle::QShaderIncludeBundle()
+    : d(new QShaderIncludeBundlePrivate)
+{
+}
+
+/*!
+    Destructor.
+ */
+QShaderIncludeBundle::~QShaderIncludeBundle()
+{
+    delete d;
+}
+
+/*!
+    Adds the file \a path with the given \a contents. An existing file with the
+    same path is replaced.
+
+    As QByteArray is implicitly shared, the data is not copied.
+ */
+void QShaderIncludeBundle::addFile(const QString &path, const QByteArray &contents)
+{
+    d->files.insert(normalizedPath(path), contents);
+}
+
+/*!
+    Adds all files in the directory \a path and its subdirectories. \a path can
+    be a resource directory, such as \c{:/shaders}.
+
+    Uncompressed resources are referenced in place. Other files are read into
+    memory.
+
+    \return \c false if \a path is not a directory or a file could not be read.
+ */
+bool QShaderIncludeBundle::addDirectory(const QString &path)
+{
+    const QString dir = normalizedPath(path);
+    if (!QFileInfo(dir).isDir()) {
+        qWarning("QShaderIncludeBundle: %s is not a directory", qPrintable(path));
+        return false;
+    }
+
+    QDirIterator it(dir, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QString fn = it.next();
+        if (fn.startsWith(QLatin1Char(':'))) {
+            QResource r(fn);
+            if (r.isValid() && r.compressionAlgorithm() == QResource::NoCompression) {
+                d->files.insert(normalizedPath(fn), QByteArray::fromRawData(reinterpret_cast<const char *>(r.data()),
+                                                                            int(r.size())));
+                continue;
+            }
+        }
+        QFile f(fn);
+        if (!f.open(QIODevice::ReadOnly)) {
+            qWarning("QShaderIncludeBundle: Failed to read %s", qPrintable(fn));
+            return false;
+        }
+        d->files.insert(normalizedPath(fn), f.readAll());
+    }
+
+    return true;
+}
+
+/*!
+    Loads the bundle file \a fileName created by serialize(), replacing the
+    previously loaded bundle, if any. Files added with addFile() or
+    addDirectory() are kept, and take precedence over the ones in the bundle.
+
+    Regular files are memory mapped. For resources the data is accessed in
+    place when stored uncompressed.
+
+    \return \c false if the file cannot be read or is not a valid bundle.
+ */
+bool QShaderIncludeBundle::load(const QString &fileName)
+{
+    const QString fn = normalizedPath(fileName);
+    if (fn.startsWith(QLatin1Char(':'))) {
+        QResource r(fn);
+        if (r.isValid() && r.compressionAlgorithm() == QResource::NoCompression) {
+            d->mappedFile.reset();
+            return loadData(QByteArray::fromRawData(reinterpret_cast<const char *>(r.data()), int(r.size())));
+        }
+    }
+
+    QScopedPointer<QFile> f(new QFile(fn));
+    if (!f->open(QIODevice::ReadOnly)) {
+        qWarning("QShaderIncludeBundle: Failed to open %s", qPrintable(fileName));
+        return false;
+    }
+
+    const qint64 size = f->size();
+    if (uchar *p = f->map(0, size)) {
+        if (!loadData(QByteArray::fromRawData(reinterpret_cast<const char *>(p), int(size))))
+            return false;
+        d->mappedFile.reset(f.take()); // after loadData(), which drops the previous mapping
+        return true;
+    }
+
+    // not mappable (compressed resource, for example)
+    d->mappedFile.reset();
+    return loadData(f->readAll());
+}
+
+/*!
+    Loads the bundle \a data created by serialize(), replacing the previously
+    loaded bundle, if any. The data is referenced, not copied, so \a data can
+    be created with QByteArray::fromRawData() as long as the memory stays
+    valid.
+
+    \return \c false if \a data is not a valid bundle.
+ */
+bool QShaderIncludeBundle::loadData(const QByteArray &data)
+{
+    d->bundle.clear();
+    d->bundleCount = 0;
+
+    const uchar *p = reinterpret_cast<const uchar *>(data.constData());
+    const quint32 size = quint32(data.size());
+    if (size < quint32(BUNDLE_HEADER_SIZE) || memcmp(p, BUNDLE_MAGIC, 4)
+            || qFromLittleEndian<quint32>(p + 4) != BUNDLE_VERSION)
+    {
+        qWarning("QShaderIncludeBundle: Not a valid include bundle");
+        return false;
+    }
+
+    const quint32 count = qFromLittleEndian<quint32>(p + 8);
+    if (count > (size - BUNDLE_HEADER_SIZE) / BUNDLE_ENTRY_SIZE) {
+        qWarning("QShaderIncludeBundle: Truncated include bundle");
+        return false;
+    }
+    for (quint32 i = 0; i < count; ++i) {
+        const uchar *e = p + BUNDLE_HEADER_SIZE + i * BUNDLE_ENTRY_SIZE;
+        for (int field = 0; field < 2; ++field) {
+            const quint32 offset = qFromLittleEndian<quint32>(e + field * 8);
+            const quint32 length = qFromLittleEndian<quint32>(e + field * 8 + 4);
+            if (offset > size || length > size - offset) {
+                qWarning("QShaderIncludeBundle: Corrupt include bundle");
+                return false;
+            }
+        }
+    }
+
+    d->bundle = data;
+    d->bundleCount = int(count);
+    return true;
+}
+
+/*!
+    \return a bundle with all the files, to be loaded later with load() or
+    loadData().
+ */
+QByteArray QShaderIncludeBundle::serialize() const
+{
+    QMap<QByteArray, QByteArray> sorted;
+    for (int i = 0; i < d->bundleCount; ++i)
+        sorted.insert(QByteArray(d->entryPath(i).constData(), d->entryPath(i).size()), d->entryData(i));
+    for (auto it = d->files.cbegin(), end = d->files.cend(); it != end; ++it)
+        sorted.insert(it.key().toUtf8(), it.value());
+
+    const int count = sorted.count();
+    QByteArray buf(BUNDLE_HEADER_SIZE + count * BUNDLE_ENTRY_SIZE, Qt::Uninitialized);
+    uchar *p = reinterpret_cast<uchar *>(buf.data());
+    memcpy(p, BUNDLE_MAGIC, 4);
+    qToLittleEndian<quint32>(BUNDLE_VERSION, p + 4);
+    qToLittleEndian<quint32>(quint32(count), p + 8);
+
+    QByteArray blobs;
+    int i = 0;
+    for (auto it = sorted.cbegin(), end = sorted.cend(); it != end; ++it, ++i) {
+        const quint32 pathOffset = quint32(buf.size() + blobs.size());
+        blobs += it.key();
+        const quint32 dataOffset = quint32(buf.size() + blobs.size());
+        blobs += it.value();
+        uchar *e = reinterpret_cast<uchar *>(buf.data()) + BUNDLE_HEADER_SIZE + i * BUNDLE_ENTRY_SIZE;
+        qToLittleEndian<quint32>(pathOffset, e);
+        qToLittleEndian<quint32>(quint32(it.key().size()), e + 4);
+        qToLittleEndian<quint32>(dataOffset, e + 8);
+        qToLittleEndian<quint32>(quint32(it.value().size()), e + 12);
+    }
+
+    return buf + blobs;
+}
+
+/*!
+    \return the paths of all files, sorted.
+ */
+QStringList QShaderIncludeBundle::files() const
+{
+    QStringList result = d->files.keys();
+    for (int i = 0; i < d->bundleCount; ++i) {
+        const QString path = QString::fromUtf8(d->entryPath(i));
+        if (!d->files.contains(path))
+            result.append(path);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+/*!
+    Removes all files, and unloads the bundle.
+ */
+void QShaderIncludeBundle::clear()
+{
+    d->files.clear();
+    d->bundle.clear();
+    d->bundleCount = 0;
+    d->mappedFile.reset();
+}
+
+/*!
+    \reimp
+ */
+QString QShaderIncludeBundle::resolve(const QString &headerName, const QString &includerName) const
+{
+    QString path;
+    if (headerName.startsWith(QLatin1Char('/')) || headerName.startsWith(QLatin1Char(':'))
+            || headerName.startsWith(QLatin1String("qrc:")))
+    {
+        path = normalizedPath(headerName);
+    } else {
+        const int sep = includerName.lastIndexOf(QLatin1Char('/'));
+        path = sep >= 0 ? normalizedPath(includerName.left(sep + 1) + headerName)
+                        : normalizedPath(headerName);
+    }
+
+    if (d->files.contains(path) || d->find(path) >= 0)
+        return path;
+
+    return QString();
+}
+
+/*!
+    \reimp
+ */
+QByteArray QShaderIncludeBundle::contents(const QString &path) const
+{
+    auto it = d->files.constFind(path);
+    if (it != d->files.cend())
+        return *it;
+
+    const int i = d->find(path);
+    return i >= 0 ? d->entryData(i) : QByteArray();
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,76 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Shader Tools module
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QSHADERINCLUDERESOLVER_H
+#define QSHADERINCLUDERESOLVER_H
+
+#include <QtShaderTools/qtshadertoolsglobal.h>
+#include <QtCore/qstring.h>
+#include <QtCore/qstringlist.h>
+#include <QtCore/qbytearray.h>
+
+QT_BEGIN_NAMESPACE
+
+class Q_SHADERTOOLS_EXPORT QShaderIncludeResolver
+{
+public:
+    virtual ~QShaderIncludeResolver();
+
+    virtual QString resolve(const QString &headerName, const QString &includerName) const = 0;
+    virtual QByteArray contents(const QString &path) const = 0;
+};
+
+struct QShaderIncludeBundlePrivate;
+
+class Q_SHADERTOOLS_EXPORT QShaderIncludeBundle : public QShaderIncludeResolver
+{
+public:
+    QShaderIncludeBundle();
+    ~QShaderIncludeBundle();
+
+    void addFile(const QString &path, const QByteArray &contents);
+    bool addDirectory(const QString &path);
+    bool load(const QString &fileName);
+    bool loadData(const QByteArray &data);
+    QByteArray serialize() const;
+
+    QStringList files() const;
+    void clear();
+
+    QString resolve(const QString &headerName, const QString &includerName) const override;
+    QByteArray contents(const QString &path) const override;
+
+private:
+    Q_DISABLE_COPY(QShaderIncludeBundle)
+    QShaderIncludeBundlePrivate *d = nullptr;
+};
+
+QT_END_NAMESPACE
+
+#endif
@@ -0,0 +1,208 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Shader Tools module
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qshaderpackwriter_p.h"
+#include <QtCore/QIODevice>
+#include <QtCore/QDataStream>
+#include <QtCore/QVector>
+#include <QtCore/QPair>
+
+#include <zlib.h>
+
+// The output is qCompress() compatible, meaning a 4 byte big endian size of
+// the uncompressed data, followed by a zlib stream. The size is only known
+// at the end, so the device must be seekable.
+//
+// The counts in the format are written as int, like QShader does, never as
+// the size type of a container.
+
+QT_BEGIN_NAMESPACE
+
+struct QShaderPackWriterPrivate
+{
+    bool deflateData(const QByteArray &data, int flush = Z_NO_FLUSH);
+
+    QIODevice *dev;
+    int level;
+    z_stream zs;
+    bool zsValid = false;
+    qint64 startPos = 0;
+    quint32 uncompressedSize = 0;
+    int remainingShaders = 0;
+    QVector<QPair<QShaderKey, QShader::NativeResourceBindingMap>> bindings;
+};
+
+QShaderPackWriter::QShaderPackWriter(QIODevice *device, int compressionLevel)
+    : d(new QShaderPackWriterPrivate)
+{
+    d->dev = device;
+    d->level = compressionLevel;
+    memset(&d->zs, 0, sizeof(d->zs));
+}
+
+QShaderPackWriter::~QShaderPackWriter()
+{
+    if (d->zsValid)
+        deflateEnd(&d->zs);
+    delete d;
+}
+
+static void writeShaderKey(QDataStream *ds, const QShaderKey &k)
+{
+    *ds << int(k.source());
+    *ds << int(k.sourceVersion().version());
+    *ds << int(k.sourceVersion().flags());
+    *ds << int(k.sourceVariant());
+}
+
+bool QShaderPackWriter::begin(QShader::Stage stage, const QShaderDescription &description, int shaderCount)
+{
+    // Let QShader serialize the header and the description, these are small.
+    // What is left at the end are the counts of the (empty) lists of shaders
+    // and binding maps, which are replaced with the real data.
+    QShader header;
+    header.setStage(stage);
+    header.setDescription(description);
+    QByteArray prefix = qUncompress(header.serialized());
+    QByteArray emptyLists;
+    {
+        QDataStream ds(&emptyLists, QIODevice::WriteOnly);
+        ds.setVersion(QDataStream::Qt_5_10);
+        ds << int(0) << int(0);
+    }
+    if (!prefix.endsWith(emptyLists)) {
+        qWarning("Failed to serialize shader pack header");
+        return false;
+    }
+    prefix.chop(emptyLists.size());
+
+    if (deflateInit(&d->zs, d->level) != Z_OK) {
+        qWarning("Failed to initialize zlib");
+        return false;
+    }
+    d->zsValid = true;
+
+    d->startPos = d->dev->pos();
+    const char sizePlaceholder[4] = { 0, 0, 0, 0 };
+    if (d->dev->write(sizePlaceholder, 4) != 4)
+        return false;
+
+    QByteArray buf;
+    QDataStream ds(&buf, QIODevice::WriteOnly);
+    ds.setVersion(QDataStream::Qt_5_10);
+    ds << int(shaderCount);
+    d->remainingShaders = shaderCount;
+    d->bindings.clear();
+    return d->deflateData(prefix) && d->deflateData(buf);
+}
+
+bool QShaderPackWriter::addShader(const QShaderKey &key, const QShaderCode &shader)
+{
+    if (d->remainingShaders <= 0) {
+        qWarning("Too many shaders written to shader pack");
+        return false;
+    }
+    --d->remainingShaders;
+
+    QByteArray buf;
+    QDataStream ds(&buf, QIODevice::WriteOnly);
+    ds.setVersion(QDataStream::Qt_5_10);
+    writeShaderKey(&ds, key);
+    ds << shader.shader();
+    ds << shader.entryPoint();
+    return d->deflateData(buf);
+}
+
+void QShaderPackWriter::addResourceBindingMap(const QShaderKey &key, const QShader::NativeResourceBindingMap &map)
+{
+    // only written at the end, these are small
+    d->bindings.append(qMakePair(key, map));
+}
+
+bool QShaderPackWriter::finish()
+{
+    if (d->remainingShaders != 0) {
+        qWarning("Shader pack is missing %d shaders", d->remainingShaders);
+        return false;
+    }
+
+    QByteArray buf;
+    QDataStream ds(&buf, QIODevice::WriteOnly);
+    ds.setVersion(QDataStream::Qt_5_10);
+    ds << int(d->bindings.count());
+    for (const auto &b : qAsConst(d->bindings)) {
+        writeShaderKey(&ds, b.first);
+        ds << int(b.second.count());
+        for (auto mapIt = b.second.cbegin(), mapItEnd = b.second.cend(); mapIt != mapItEnd; ++mapIt) {
+            ds << int(mapIt.key());
+            ds << int(mapIt.value().first);
+            ds << int(mapIt.value().second);
+        }
+    }
+    if (!d->deflateData(buf, Z_FINISH))
+        return false;
+
+    const qint64 endPos = d->dev->pos();
+    const char size[4] = {
+        char((d->uncompressedSize >> 24) & 0xFF),
+        char((d->uncompressedSize >> 16) & 0xFF),
+        char((d->uncompressedSize >> 8) & 0xFF),
+        char(d->uncompressedSize & 0xFF)
+    };
+    if (!d->dev->seek(d->startPos) || d->dev->write(size, 4) != 4 || !d->dev->seek(endPos)) {
+        qWarning("Failed to write shader pack size");
+        return false;
+    }
+    return true;
+}
+
+bool QShaderPackWriterPrivate::deflateData(const QByteArray &data, int flush)
+{
+    uncompressedSize += quint32(data.size());
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+    zs.avail_in = uInt(data.size());
+    char out[16384];
+    do {
+        zs.next_out = reinterpret_cast<Bytef *>(out);
+        zs.avail_out = sizeof(out);
+        const int result = deflate(&zs, flush);
+        if (result == Z_STREAM_ERROR) {
+            qWarning("Failed to compress shader pack");
+            return false;
+        }
+        const qint64 produced = qint64(sizeof(out) - zs.avail_out);
+        if (produced && dev->write(out, produced) != produced) {
+            qWarning("Failed to write shader pack: %s", qPrintable(dev->errorString()));
+            return false;
+        }
+    } while (zs.avail_out == 0);
+    return true;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,73 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Shader Tools module
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QSHADERPACKWRITER_P_H
+#define QSHADERPACKWRITER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists for the convenience
+// of a number of Qt sources files.  This header file may change from
+// version to version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtShaderTools/private/qtshadertoolsglobal_p.h>
+#include <QtGui/private/qshader_p.h>
+
+QT_BEGIN_NAMESPACE
+
+class QIODevice;
+struct QShaderPackWriterPrivate;
+
+// Writes a shader pack in the format of QShader::serialized(), but shader by
+// shader, so that there is never more than one shader held in memory.
+class Q_SHADERTOOLS_PRIVATE_EXPORT QShaderPackWriter
+{
+public:
+    // compressionLevel is the zlib level, -1 for the zlib default
+    explicit QShaderPackWriter(QIODevice *device, int compressionLevel = -1);
+    ~QShaderPackWriter();
+
+    bool begin(QShader::Stage stage, const QShaderDescription &description, int shaderCount);
+    bool addShader(const QShaderKey &key, const QShaderCode &shader);
+    void addResourceBindingMap(const QShaderKey &key, const QShader::NativeResourceBindingMap &map);
+    bool finish();
+
+private:
+    Q_DISABLE_COPY(QShaderPackWriter)
+    QShaderPackWriterPrivate *d;
+};
+
+QT_END_NAMESPACE
+
+#endif
@@ -0,0 +1,348 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Shader Tools module
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qspirvcompact_p.h"
+#include "qspirvshaderremap_p.h"
+#include <QtCore/QVector>
+#include <QtCore/QSet>
+
+#define SPV_ENABLE_UTILITY_CODE
+#include <spirv.h>
+
+// A compact, lossless encoding for SPIR-V modules, in the spirit of SMOL-V.
+//
+// SPIR-V is a stream of 32-bit words where most of the values are small
+// (opcodes, word counts, type ids) or close to each other (result ids are
+// mostly allocated sequentially, operands tend to refer to recent results).
+// Generic compressors see little of this structure. Here every instruction
+// is written as a varint opcode and a varint operand count, result ids are
+// stored as the difference from the previous result id, and for the common
+// instructions that take only ids as operands, those are stored relative to
+// the current result id. Strings and floating point constants are stored
+// as-is. The result is both smaller on its own and compresses better with
+// zlib than the raw binary.
+//
+// Layout: "QSPC", format version byte, varint original word count, varint
+// header words 1-4 (version, generator, bound, schema), instructions.
+
+QT_BEGIN_NAMESPACE
+
+namespace QSpirvCompact {
+
+static const char compactMagic[4] = { 'Q', 'S', 'P', 'C' };
+static const quint8 compactFormatVersion = 1;
+
+enum OperandCoding {
+    PlainOperands,
+    IdOperands,
+    StringOperands,
+    ConstantOperands
+};
+
+static OperandCoding operandCoding(quint32 op)
+{
+    if (op >= SpvOpConvertFToU && op <= SpvOpBitcast)
+        return IdOperands;
+    if (op >= SpvOpSNegate && op <= SpvOpSMulExtended)
+        return IdOperands;
+    if (op >= SpvOpAny && op <= SpvOpFUnordGreaterThanEqual)
+        return IdOperands;
+    if (op >= SpvOpShiftRightLogical && op <= SpvOpBitCount)
+        return IdOperands;
+    if (op >= SpvOpDPdx && op <= SpvOpFwidthCoarse)
+        return IdOperands;
+
+    switch (op) {
+    case SpvOpLoad:
+    case SpvOpStore:
+    case SpvOpAccessChain:
+    case SpvOpInBoundsAccessChain:
+    case SpvOpCompositeConstruct:
+    case SpvOpFunctionCall:
+    case SpvOpSelect:
+    case SpvOpPhi:
+    case SpvOpBranch:
+    case SpvOpBranchConditional:
+    case SpvOpReturnValue:
+        return IdOperands;
+    case SpvOpSourceContinued:
+    case SpvOpSource:
+    case SpvOpSourceExtension:
+    case SpvOpName:
+    case SpvOpMemberName:
+    case SpvOpString:
+    case SpvOpExtension:
+    case SpvOpExtInstImport:
+    case SpvOpEntryPoint:
+    case SpvOpModuleProcessed:
+        return StringOperands;
+    case SpvOpConstant:
+    case SpvOpSpecConstant:
+        return ConstantOperands;
+    default:
+        return PlainOperands;
+    }
+}
+
+static inline quint32 zigZag(qint32 v)
+{
+    return (quint32(v) << 1) ^ quint32(v >> 31);
+}
+
+static inline qint32 unZigZag(quint32 v)
+{
+    return qint32(v >> 1) ^ -qint32(v & 1);
+}
+
+static inline void writeVarint(QByteArray *out, quint32 v)
+{
+    while (v >= 0x80) {
+        out->append(char((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out->append(char(v));
+}
+
+static inline void writeRaw(QByteArray *out, quint32 v)
+{
+    out->append(reinterpret_cast<const char *>(&v), 4);
+}
+
+bool isCompact(const QByteArray &data)
+{
+    return data.size() >= 5 && !memcmp(data.constData(), compactMagic, 4);
+}
+
+QByteArray encode(const QByteArray &spirv, EncodeFlags flags)
+{
+    QByteArray ir = spirv;
+    if (flags.testFlag(Canonicalize)) {
+        QSpirvShaderRemapper remapper;
+        ir = remapper.remap(spirv, QSpirvShader::RemapFlags());
+        if (ir.isEmpty()) {
+            qWarning("QSpirvCompact: Failed to canonicalize: %s", qPrintable(remapper.errorMessage()));
+            return QByteArray();
+        }
+    }
+
+    if (ir.size() < 20 || ir.size() % 4) {
+        qWarning("QSpirvCompact: Invalid SPIR-V binary");
+        return QByteArray();
+    }
+
+    const quint32 *words = reinterpret_cast<const quint32 *>(ir.constData());
+    const int wordCount = ir.size() / 4;
+    if (words[0] != SpvMagicNumber) {
+        qWarning("QSpirvCompact: Invalid SPIR-V binary");
+        return QByteArray();
+    }
+
+    QByteArray out;
+    out.reserve(ir.size() / 2);
+    out.append(compactMagic, 4);
+    out.append(char(compactFormatVersion));
+    writeVarint(&out, quint32(wordCount));
+    for (int i = 1; i < 5; ++i)
+        writeVarint(&out, words[i]);
+
+    QSet<quint32> floatTypes;
+    quint32 lastResult = 0;
+    int pos = 5;
+    while (pos < wordCount) {
+        const quint32 op = words[pos] & 0xFFFF;
+        const int count = int(words[pos] >> 16);
+        if (count == 0 || pos + count > wordCount) {
+            qWarning("QSpirvCompact: Invalid SPIR-V binary");
+            return QByteArray();
+        }
+        writeVarint(&out, op);
+        writeVarint(&out, quint32(count - 1));
+
+        const quint32 *operands = words + pos + 1;
+        const int operandCount = count - 1;
+        const OperandCoding coding = operandCoding(op);
+        int i = 0;
+        if (coding == StringOperands) {
+            for (; i < operandCount; ++i)
+                writeRaw(&out, operands[i]);
+        } else {
+            bool hasResult = false;
+            bool hasResultType = false;
+            SpvHasResultAndType(SpvOp(op), &hasResult, &hasResultType);
+            quint32 resultType = 0;
+            if (hasResultType && i < operandCount) {
+                resultType = operands[i++];
+                writeVarint(&out, resultType);
+            }
+            if (hasResult && i < operandCount) {
+                const quint32 result = operands[i++];
+                writeVarint(&out, zigZag(qint32(result - lastResult)));
+                lastResult = result;
+                if (op == SpvOpTypeFloat)
+                    floatTypes.insert(result);
+            }
+            const bool rawValues = coding == ConstantOperands && floatTypes.contains(resultType);
+            for (; i < operandCount; ++i) {
+                if (coding == IdOperands)
+                    writeVarint(&out, zigZag(qint32(lastResult - operands[i])));
+                else if (rawValues)
+                    writeRaw(&out, operands[i]);
+                else
+                    writeVarint(&out, operands[i]);
+            }
+        }
+        pos += count;
+    }
+
+    return out;
+}
+
+class Reader
+{
+public:
+    Reader(const QByteArray &data, int pos)
+        : p(reinterpret_cast<const uchar *>(data.constData()) + pos),
+          end(reinterpret_cast<const uchar *>(data.constData()) + data.size())
+    { }
+
+    bool atEnd() const { return p == end; }
+    bool ok() const { return !failed; }
+
+    quint32 varint()
+    {
+        quint32 v = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (p == end) {
+                failed = true;
+                return 0;
+            }
+            const uchar c = *p++;
+            v |= quint32(c & 0x7F) << shift;
+            if (!(c & 0x80))
+                return v;
+        }
+        failed = true;
+        return 0;
+    }
+
+    quint32 raw()
+    {
+        if (end - p < 4) {
+            failed = true;
+            p = end;
+            return 0;
+        }
+        quint32 v;
+        memcpy(&v, p, 4);
+        p += 4;
+        return v;
+    }
+
+private:
+    const uchar *p;
+    const uchar *end;
+    bool failed = false;
+};
+
+QByteArray decode(const QByteArray &data)
+{
+    if (!isCompact(data) || quint8(data[4]) != compactFormatVersion) {
+        qWarning("QSpirvCompact: Not a compact SPIR-V module, or unsupported version");
+        return QByteArray();
+    }
+
+    Reader r(data, 5);
+    const quint32 wordCount = r.varint();
+    if (!r.ok() || wordCount < 5 || wordCount > quint32(INT_MAX / 4)) {
+        qWarning("QSpirvCompact: Corrupt data");
+        return QByteArray();
+    }
+
+    QByteArray result(int(wordCount * 4), Qt::Uninitialized);
+    quint32 *words = reinterpret_cast<quint32 *>(result.data());
+    words[0] = SpvMagicNumber;
+    for (int i = 1; i < 5; ++i)
+        words[i] = r.varint();
+
+    QSet<quint32> floatTypes;
+    quint32 lastResult = 0;
+    quint32 pos = 5;
+    while (r.ok() && !r.atEnd()) {
+        const quint32 op = r.varint();
+        const quint32 operandCount = r.varint();
+        if (!r.ok() || op > 0xFFFF || operandCount >= 0xFFFF || pos + 1 + operandCount > wordCount)
+            break;
+        words[pos++] = ((operandCount + 1) << 16) | op;
+
+        const OperandCoding coding = operandCoding(op);
+        quint32 i = 0;
+        if (coding == StringOperands) {
+            for (; i < operandCount; ++i)
+                words[pos++] = r.raw();
+        } else {
+            bool hasResult = false;
+            bool hasResultType = false;
+            SpvHasResultAndType(SpvOp(op), &hasResult, &hasResultType);
+            quint32 resultType = 0;
+            if (hasResultType && i < operandCount) {
+                resultType = r.varint();
+                words[pos++] = resultType;
+                ++i;
+            }
+            if (hasResult && i < operandCount) {
+                const quint32 result = lastResult + quint32(unZigZag(r.varint()));
+                words[pos++] = result;
+                lastResult = result;
+                if (op == SpvOpTypeFloat)
+                    floatTypes.insert(result);
+                ++i;
+            }
+            const bool rawValues = coding == ConstantOperands && floatTypes.contains(resultType);
+            for (; i < operandCount; ++i) {
+                if (coding == IdOperands)
+                    words[pos++] = lastResult - quint32(unZigZag(r.varint()));
+                else if (rawValues)
+                    words[pos++] = r.raw();
+                else
+                    words[pos++] = r.varint();
+            }
+        }
+    }
+
+    if (!r.ok() || !r.atEnd() || pos != wordCount) {
+        qWarning("QSpirvCompact: Corrupt data");
+        return QByteArray();
+    }
+
+    return result;
+}
+
+} // namespace
+
+QT_END_NAMESPACE
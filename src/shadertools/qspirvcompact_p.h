@@ -0,0 +1,66 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Shader Tools module
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QSPIRVCOMPACT_P_H
+#define QSPIRVCOMPACT_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists for the convenience
+// of a number of Qt sources files.  This header file may change from
+// version to version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtShaderTools/private/qtshadertoolsglobal_p.h>
+#include <QtCore/QByteArray>
+
+QT_BEGIN_NAMESPACE
+
+namespace QSpirvCompact {
+
+enum EncodeFlag {
+    Canonicalize = 0x01
+};
+Q_DECLARE_FLAGS(EncodeFlags, EncodeFlag)
+
+Q_SHADERTOOLS_PRIVATE_EXPORT bool isCompact(const QByteArray &data);
+Q_SHADERTOOLS_PRIVATE_EXPORT QByteArray encode(const QByteArray &spirv, EncodeFlags flags = EncodeFlags());
+Q_SHADERTOOLS_PRIVATE_EXPORT QByteArray decode(const QByteArray &data);
+
+}
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(QSpirvCompact::EncodeFlags)
+
+QT_END_NAMESPACE
+
+#endif
@@ -29,12 +29,22 @@
 
 #include "qspirvcompiler_p.h"
 #include "qshaderbatchablerewriter_p.h"
+#include "qshaderincluderesolver.h"
 #include <QFile>
 #include <QFileInfo>
+#include <QThreadStorage>
+#include <QHash>
+#include <QSet>
+#include <QCryptographicHash>
 
 #include <glslang/Public/ShaderLang.h>
+#include <glslang/Include/PoolAlloc.h>
 #include <SPIRV/GlslangToSpv.h>
 
+#include <cctype>
+#include <cstring>
+#include <algorithm>
+
 QT_BEGIN_NAMESPACE
 
 static const TBuiltInResource resourceLimits =
@@ -148,7 +158,9 @@ static const TBuiltInResource resourceLimits =
 struct QSpirvCompilerPrivate
 {
     bool readFile(const QString &fn);
-    bool compile();
+    bool compile(bool preprocessOnly = false);
+    bool compileWithPool(const QByteArray &actualSource, glslang::TPoolAllocator *pool, bool preprocessOnly);
+    bool checkMemoryLimit(glslang::TPoolAllocator *pool);
 
     QString sourceFileName;
     QByteArray source;
@@ -157,8 +169,15 @@ struct QSpirvCompilerPrivate
     QSpirvCompiler::Flags flags;
     QByteArray preamble;
     int batchAttrLoc = 7;
+    int poolPageSize = 0;
+    qint64 memoryLimit = 0;
+    qint64 peakMemoryUsage = 0;
+    const QShaderIncludeResolver *includeResolver = nullptr;
     QByteArray spirv;
+    QByteArray normalizedHash;
     QString log;
+    QStringList includedFiles;
+    QByteArrayList referencedMacros;
 };
 
 bool QSpirvCompilerPrivate::readFile(const QString &fn)
@@ -175,15 +194,264 @@ bool QSpirvCompilerPrivate::readFile(const QString &fn)
     return true;
 }
 
+// Replaces comments with spaces, keeping the line breaks, so that what remains
+// can be looked at line by line.
+static QByteArray stripComments(const QByteArray &src)
+{
+    QByteArray result = src;
+    char *p = result.data();
+    const int size = result.size();
+    for (int i = 0; i < size; ++i) {
+        if (p[i] != '/' || i + 1 >= size)
+            continue;
+        if (p[i + 1] == '/') {
+            while (i < size && p[i] != '\n')
+                p[i++] = ' ';
+        } else if (p[i + 1] == '*') {
+            p[i++] = ' ';
+            p[i++] = ' ';
+            while (i < size && !(p[i] == '*' && i + 1 < size && p[i + 1] == '/')) {
+                if (p[i] != '\n')
+                    p[i] = ' ';
+                ++i;
+            }
+            if (i < size) {
+                p[i++] = ' ';
+                p[i] = ' ';
+            }
+        }
+    }
+    return result;
+}
+
+static inline QByteArray firstToken(const QByteArray &s)
+{
+    int end = 0;
+    while (end < s.size() && (isalnum(uchar(s[end])) || s[end] == '_'))
+        ++end;
+    return s.left(end);
+}
+
+// Splits a preprocessor directive line into the directive and the rest.
+static bool parseDirective(const QByteArray &line, QByteArray *directive, QByteArray *rest)
+{
+    if (!line.startsWith('#'))
+        return false;
+    const QByteArray d = line.mid(1).trimmed();
+    *directive = firstToken(d);
+    *rest = d.mid(directive->size()).trimmed();
+    return true;
+}
+
+// Tells if src is protected against multiple inclusion, either by #pragma once
+// outside of any conditional block or by the classic #ifndef X / #define X /
+// ... / #endif pattern covering the whole file. For the latter the guard
+// macro is returned in guardMacro, #pragma once leaves it empty.
+static bool isIncludeGuarded(const QByteArray &src, QByteArray *guardMacro)
+{
+    const QByteArray text = stripComments(src);
+    if (text.contains("\\\n") || text.contains("\\\r\n"))
+        return false; // line continuations, do not bother
+
+    enum { BeforeGuard, ExpectDefine, InGuard, AfterGuard, NotGuarded } state = BeforeGuard;
+    bool once = false;
+    int depth = 0; // #if nesting, tracked in every state
+    QByteArray macro;
+    for (const QByteArray &rawLine : text.split('\n')) {
+        const QByteArray line = rawLine.trimmed();
+        if (line.isEmpty())
+            continue;
+        QByteArray directive, rest;
+        const bool isDirective = parseDirective(line, &directive, &rest);
+        if (isDirective && directive == "pragma" && rest == "once") {
+            if (depth == 0)
+                once = true;
+            continue;
+        }
+        if (isDirective) {
+            if (directive == "if" || directive == "ifdef" || directive == "ifndef") {
+                ++depth;
+            } else if (directive == "endif") {
+                if (--depth < 0)
+                    return false; // unbalanced, leave it to the preprocessor
+            }
+        }
+        switch (state) {
+        case BeforeGuard:
+            if (isDirective && directive == "ifndef") {
+                macro = firstToken(rest);
+            } else if (isDirective && directive == "if") {
+                const QByteArray cond = rest.simplified().replace(' ', "");
+                if (cond.startsWith("!defined(")) {
+                    const QByteArray name = firstToken(cond.mid(9));
+                    if (cond.size() == name.size() + 10 && cond.endsWith(')'))
+                        macro = name;
+                }
+            }
+            state = macro.isEmpty() ? NotGuarded : ExpectDefine;
+            break;
+        case ExpectDefine:
+            state = isDirective && directive == "define" && firstToken(rest) == macro ? InGuard : NotGuarded;
+            break;
+        case InGuard:
+            if (!isDirective)
+                break;
+            if (directive == "endif" && depth == 0)
+                state = AfterGuard;
+            else if (depth == 1 && (directive == "else" || directive == "elif"))
+                state = NotGuarded;
+            break;
+        case AfterGuard:
+            state = NotGuarded;
+            break;
+        case NotGuarded:
+            break;
+        }
+    }
+
+    if (depth != 0)
+        return false;
+    if (state == AfterGuard) {
+        *guardMacro = macro;
+        return true;
+    }
+    if (once) {
+        guardMacro->clear();
+        return true;
+    }
+    return false;
+}
+
+// Records the macros src may #undef. An include guard can only be relied on
+// when its macro is never undefined.
+static void collectUndefs(const QByteArray &src, QSet<QByteArray> *undefs)
+{
+    if (!src.contains("undef"))
+        return;
+
+    const QByteArray text = stripComments(src);
+    for (const QByteArray &rawLine : text.split('\n')) {
+        QByteArray directive, rest;
+        if (parseDirective(rawLine.trimmed(), &directive, &rest) && directive == "undef")
+            undefs->insert(firstToken(rest));
+    }
+}
+
+// Finds out which of the macros defined in the preamble a shader refers to,
+// by looking at the identifiers in everything the preprocessor gets to see:
+// the source, the headers it includes, and the replacement lists of the
+// macros referred to. A macro that is never named cannot affect the result,
+// so this is enough to tell, without hooking into glslang's preprocessor. It
+// errs on the safe side for names in comments and inactive #if blocks.
+class MacroUsage
+{
+public:
+    explicit MacroUsage(const QByteArray &preamble);
+
+    void scan(const QByteArray &text) { scan(text, &referenced); }
+    QByteArrayList referencedMacros();
+
+private:
+    void scan(const QByteArray &text, QSet<QByteArray> *result);
+
+    QHash<QByteArray, QByteArray> macros; // name -> replacement list, including parameters
+    QSet<QByteArray> referenced;
+    bool all = false;
+};
+
+MacroUsage::MacroUsage(const QByteArray &preamble)
+{
+    if (preamble.isEmpty())
+        return;
+
+    // The preamble is typically just #defines, anything else in it may refer
+    // to the macros as well.
+    QByteArray rest;
+    const QByteArray text = stripComments(preamble);
+    for (const QByteArray &rawLine : text.split('\n')) {
+        QByteArray directive, args;
+        if (parseDirective(rawLine.trimmed(), &directive, &args) && directive == "define") {
+            const QByteArray name = firstToken(args);
+            if (!name.isEmpty())
+                macros.insert(name, args.mid(name.size()));
+        } else {
+            rest += rawLine;
+            rest += '\n';
+        }
+    }
+    scan(rest);
+}
+
+void MacroUsage::scan(const QByteArray &text, QSet<QByteArray> *result)
+{
+    if (macros.isEmpty() || all)
+        return;
+
+    if (text.contains("##")) {
+        // names may be put together by token pasting
+        all = true;
+        return;
+    }
+
+    const char *p = text.constData();
+    const int size = text.size();
+    int i = 0;
+    while (i < size) {
+        const char c = p[i];
+        if (isalpha(uchar(c)) || c == '_') {
+            const int start = i;
+            while (i < size && (isalnum(uchar(p[i])) || p[i] == '_'))
+                ++i;
+            const QByteArray name = QByteArray::fromRawData(p + start, i - start);
+            if (macros.contains(name) && !result->contains(name))
+                result->insert(QByteArray(p + start, i - start));
+        } else if (isdigit(uchar(c))) {
+            // skip number literals, such as 1e5 or 0xffu, as a whole
+            while (i < size && (isalnum(uchar(p[i])) || p[i] == '_' || p[i] == '.'))
+                ++i;
+        } else {
+            ++i;
+        }
+    }
+}
+
+QByteArrayList MacroUsage::referencedMacros()
+{
+    if (all)
+        return macros.keys();
+
+    // what the referenced macros expand to counts as well
+    QByteArrayList pending = referenced.values();
+    while (!pending.isEmpty()) {
+        QSet<QByteArray> found;
+        scan(macros.value(pending.takeLast()), &found);
+        if (all)
+            return macros.keys();
+        for (const QByteArray &name : qAsConst(found)) {
+            if (!referenced.contains(name)) {
+                referenced.insert(name);
+                pending.append(name);
+            }
+        }
+    }
+    return referenced.values();
+}
+
 class Includer : public glslang::TShader::Includer
 {
 public:
+    Includer(QStringList *includedFiles, const QShaderIncludeResolver *resolver, MacroUsage *macroUsage)
+        : includedFiles(includedFiles),
+          resolver(resolver),
+          macroUsage(macroUsage)
+    { }
+
     IncludeResult *includeLocal(const char *headerName,
                                 const char *includerName,
                                 size_t inclusionDepth) override
     {
         Q_UNUSED(inclusionDepth);
-        return readFile(headerName, includerName);
+        return include(headerName, includerName);
     }
 
     IncludeResult *includeSystem(const char *headerName,
@@ -191,7 +459,7 @@ public:
                                  size_t inclusionDepth) override
     {
         Q_UNUSED(inclusionDepth);
-        return readFile(headerName, includerName);
+        return include(headerName, includerName);
     }
 
     void releaseInclude(IncludeResult *result) override
@@ -202,36 +470,87 @@ public:
         }
     }
 
+    void addSource(const QByteArray &src) { collectUndefs(src, &undefs); }
+
 private:
-    IncludeResult *readFile(const char *headerName, const char *includerName);
+    IncludeResult *include(const char *headerName, const char *includerName);
+    QString resolve(const char *headerName, const char *includerName);
+    bool read(const QString &path, QByteArray *contents);
+
+    QStringList *includedFiles;
+    const QShaderIncludeResolver *resolver;
+    MacroUsage *macroUsage;
+    QHash<QString, QByteArray> guarded; // path -> guard macro, empty for #pragma once
+    QSet<QByteArray> undefs;
 };
 
-glslang::TShader::Includer::IncludeResult *Includer::readFile(const char *headerName, const char *includerName)
+glslang::TShader::Includer::IncludeResult *Includer::include(const char *headerName, const char *includerName)
 {
-    // Just treat the included name as relative to the includer:
-    //   Take the path from the includer, append the included name, remove redundancies.
-    // This should work also for qrc (source filenames with qrc:/ or :/ prefix).
-
-    QString includer = QString::fromUtf8(includerName);
-    if (includer.isEmpty())
-        includer = QLatin1String(".");
-    QString included = QFileInfo(includer).canonicalPath() + QLatin1Char('/') + QString::fromUtf8(headerName);
-    included = QFileInfo(included).canonicalFilePath();
+    const QString included = resolve(headerName, includerName);
     if (included.isEmpty()) {
         qWarning("QSpirvCompiler: Failed to find include file %s", headerName);
         return nullptr;
     }
-    QFile f(included);
-    if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
+
+    if (!includedFiles->contains(included))
+        includedFiles->append(included);
+
+    // A guarded header included again would be read and tokenized by the
+    // preprocessor only to skip all of it. Give it nothing instead. The same
+    // file reached via different relative paths resolves to the same path.
+    auto it = guarded.constFind(included);
+    if (it != guarded.cend() && (it->isEmpty() || !undefs.contains(*it)))
+        return new IncludeResult(included.toStdString(), nullptr, 0, nullptr);
+
+    QByteArray *data = new QByteArray;
+    if (!read(included, data)) {
         qWarning("QSpirvCompiler: Failed to read include file %s", qPrintable(included));
+        delete data;
         return nullptr;
     }
 
-    QByteArray *data = new QByteArray;
-    *data = f.readAll();
+    collectUndefs(*data, &undefs);
+    macroUsage->scan(*data);
+    QByteArray guardMacro;
+    if (isIncludeGuarded(*data, &guardMacro))
+        guarded.insert(included, guardMacro);
+
     return new IncludeResult(included.toStdString(), data->constData(), data->size(), data);
 }
 
+QString Includer::resolve(const char *headerName, const char *includerName)
+{
+    if (resolver)
+        return resolver->resolve(QString::fromUtf8(headerName), QString::fromUtf8(includerName));
+
+    // Just treat the included name as relative to the includer:
+    //   Take the path from the includer, append the included name, remove redundancies.
+    // This should work also for qrc (source filenames with qrc:/ or :/ prefix).
+
+    QString includer = QString::fromUtf8(includerName);
+    if (includer.isEmpty())
+        includer = QLatin1String(".");
+    const QString included = QFileInfo(includer).canonicalPath() + QLatin1Char('/') + QString::fromUtf8(headerName);
+    return QFileInfo(included).canonicalFilePath();
+}
+
+bool Includer::read(const QString &path, QByteArray *contents)
+{
+    if (resolver) {
+        // may well be raw data referencing the resolver's storage, glslang
+        // only needs it until releaseInclude()
+        *contents = resolver->contents(path);
+        return true;
+    }
+
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+
+    *contents = f.readAll();
+    return true;
+}
+
 class GlobalInit
 {
 public:
@@ -239,22 +558,132 @@ public:
     ~GlobalInit() { glslang::FinalizeProcess(); }
 };
 
-bool QSpirvCompilerPrivate::compile()
+// glslang's default growth increment
+static const int DEFAULT_POOL_PAGE_SIZE = 8 * 1024;
+
+// One pool per thread, kept alive across compilations so that the pages
+// released at the end of a compile are reused by the next one instead of
+// going back to the OS.
+static QThreadStorage<glslang::TPoolAllocator *> threadPools;
+
+static glslang::TPoolAllocator *threadPool(int pageSize)
+{
+    if (pageSize <= 0)
+        pageSize = DEFAULT_POOL_PAGE_SIZE;
+
+    glslang::TPoolAllocator *pool = threadPools.localData();
+    if (!pool || pool->getPageSize() != size_t(qMax(pageSize, 4096))) {
+        // not in use by anyone at this point, everything was popped at the
+        // end of the previous compile on this thread
+        pool = new glslang::TPoolAllocator(pageSize);
+        threadPools.setLocalData(pool); // deletes the old one
+    }
+    return pool;
+}
+
+bool QSpirvCompilerPrivate::compile(bool preprocessOnly)
 {
     log.clear();
+    includedFiles.clear();
+    referencedMacros.clear();
+    peakMemoryUsage = 0;
 
-    const bool useBatchable = (stage == EShLangVertex && flags.testFlag(QSpirvCompiler::RewriteToMakeBatchableForSG));
+    // the batchable variant is derived from the same source
+    const bool useBatchable = !preprocessOnly
+            && (stage == EShLangVertex && flags.testFlag(QSpirvCompiler::RewriteToMakeBatchableForSG));
     const QByteArray *actualSource = useBatchable ? &batchableSource : &source;
     if (actualSource->isEmpty())
         return false;
 
     static GlobalInit globalInit;
 
-    glslang::TShader shader(stage);
+    glslang::TPoolAllocator *pool = threadPool(poolPageSize);
+    pool->setMemoryLimit(size_t(qMax<qint64>(0, memoryLimit)));
+    pool->resetPeak();
+
+    // Everything glslang allocates for this compile, including the trees
+    // owned by the TShader and TProgram, is released by the popAll(). Note
+    // that TShader::parse() pushes without a matching pop, so a plain pop()
+    // would not be enough. The pages go to the pool's free list.
+    pool->push();
+    const bool ok = compileWithPool(*actualSource, pool, preprocessOnly);
+    peakMemoryUsage = qint64(pool->getPeakBytes());
+    pool->popAll();
+
+    return ok;
+}
+
+bool QSpirvCompilerPrivate::checkMemoryLimit(glslang::TPoolAllocator *pool)
+{
+    // glslang has no way to abort in the middle of a parse, so the limit is
+    // checked between the stages: once over the limit, nothing more gets
+    // allocated for this compile.
+    if (!pool->isMemoryLimitExceeded())
+        return true;
+
+    log = QString::fromLatin1("Memory limit of %1 bytes exceeded (%2 bytes used)")
+            .arg(memoryLimit).arg(qint64(pool->getPeakBytes()));
+    qWarning("QSpirvCompiler: %s", qPrintable(log));
+    return false;
+}
+
+// Hashes the preprocessed source as a stream of tokens, so that changes in
+// whitespace and comments, and in what the preprocessor dropped, have no
+// effect. Whitespace only matters when separating two runs of punctuation
+// ("a + +b" is not "a ++b"), otherwise every run of word characters and every
+// run of punctuation is a token. This may split a token in two or merge two
+// tokens into one, but never makes different token streams hash the same.
+// Preprocessor directives (#version, #extension, #pragma) keep their own line,
+// #line directives, which only track the original locations, are dropped.
+static QByteArray normalizedTokenHash(EShLanguage stage, const std::string &text)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(QByteArray::number(int(stage)) + '\n');
+
+    const char *p = text.data();
+    const int size = int(text.size());
+    int lineStart = 0;
+    while (lineStart < size) {
+        int lineEnd = lineStart;
+        while (lineEnd < size && p[lineEnd] != '\n')
+            ++lineEnd;
+        int i = lineStart;
+        while (i < lineEnd && isspace(uchar(p[i])))
+            ++i;
+        const bool directive = i < lineEnd && p[i] == '#';
+        const bool lineDirective = directive && lineEnd - i > 5 && !strncmp(p + i, "#line", 5) && isspace(uchar(p[i + 5]));
+        if (i < lineEnd && !lineDirective) {
+            if (directive)
+                hash.addData("\n", 1);
+            while (i < lineEnd) {
+                if (isspace(uchar(p[i]))) {
+                    ++i;
+                    continue;
+                }
+                const auto isWordChar = [](char c) { return isalnum(uchar(c)) || c == '_' || c == '.'; };
+                const bool word = isWordChar(p[i]);
+                const int start = i;
+                while (i < lineEnd && !isspace(uchar(p[i])) && isWordChar(p[i]) == word)
+                    ++i;
+                hash.addData(p + start, i - start);
+                hash.addData(" ", 1);
+            }
+            if (directive)
+                hash.addData("\n", 1);
+        }
+        lineStart = lineEnd + 1;
+    }
+
+    return hash.result();
+}
+
+bool QSpirvCompilerPrivate::compileWithPool(const QByteArray &actualSource, glslang::TPoolAllocator *pool, bool preprocessOnly)
+{
+    glslang::TShader shader(stage, pool);
     const QByteArray fn = sourceFileName.toUtf8();
     const char *fnStr = fn.constData();
-    const char *srcStr = actualSource->constData();
-    const int size = actualSource->size();
+    const char *srcStr = actualSource.constData();
+    const int size = actualSource.size();
     shader.setStringsWithLengthsAndNames(&srcStr, &size, &fnStr, 1);
     if (!preamble.isEmpty()) {
         // Line numbers in errors and #version are not affected by having a
@@ -266,16 +695,46 @@ bool QSpirvCompilerPrivate::compile()
     shader.setEnvClient(glslang::EShClientVulkan, glslang::EShTargetVulkan_1_0);
     shader.setEnvTarget(glslang::EshTargetSpv, glslang::EShTargetSpv_1_0);
 
-    Includer includer;
-    if (!shader.parse(&resourceLimits, 100, false, EShMsgDefault, includer)) {
+    MacroUsage macroUsage(preamble);
+    macroUsage.scan(actualSource);
+    Includer includer(&includedFiles, includeResolver, &macroUsage);
+    includer.addSource(preamble);
+    includer.addSource(actualSource);
+
+    if (preprocessOnly) {
+        std::string output;
+        const bool preprocessed = shader.preprocess(&resourceLimits, 100, ENoProfile, false, false,
+                                                    EShMsgDefault, &output, includer);
+        referencedMacros = macroUsage.referencedMacros();
+        std::sort(referencedMacros.begin(), referencedMacros.end());
+        if (!checkMemoryLimit(pool))
+            return false;
+        if (!preprocessed) {
+            qWarning("QSpirvCompiler: Failed to preprocess shader");
+            log = QString::fromUtf8(shader.getInfoLog()).trimmed();
+            return false;
+        }
+        normalizedHash = normalizedTokenHash(stage, output);
+        return true;
+    }
+
+    const bool parsed = shader.parse(&resourceLimits, 100, false, EShMsgDefault, includer);
+    referencedMacros = macroUsage.referencedMacros();
+    std::sort(referencedMacros.begin(), referencedMacros.end());
+    if (!checkMemoryLimit(pool))
+        return false;
+    if (!parsed) {
         qWarning("QSpirvCompiler: Failed to parse shader");
         log = QString::fromUtf8(shader.getInfoLog()).trimmed();
         return false;
     }
 
-    glslang::TProgram program;
+    glslang::TProgram program(pool);
     program.addShader(&shader);
-    if (!program.link(EShMsgDefault)) {
+    const bool linked = program.link(EShMsgDefault);
+    if (!checkMemoryLimit(pool))
+        return false;
+    if (!linked) {
         qWarning("QSpirvCompiler: Link failed");
         log = QString::fromUtf8(shader.getInfoLog()).trimmed();
         return false;
@@ -283,6 +742,8 @@ bool QSpirvCompilerPrivate::compile()
 
     std::vector<unsigned int> spv;
     glslang::GlslangToSpv(*program.getIntermediate(stage), spv);
+    if (!checkMemoryLimit(pool))
+        return false;
     if (!spv.size()) {
         qWarning("Failed to generate SPIR-V");
         return false;
@@ -384,6 +845,21 @@ void QSpirvCompiler::setSGBatchingVertexInputLocation(int location)
     d->batchAttrLoc = location;
 }
 
+void QSpirvCompiler::setPoolPageSize(int size)
+{
+    d->poolPageSize = size;
+}
+
+void QSpirvCompiler::setMemoryLimit(qint64 bytes)
+{
+    d->memoryLimit = bytes;
+}
+
+void QSpirvCompiler::setIncludeResolver(const QShaderIncludeResolver *resolver)
+{
+    d->includeResolver = resolver;
+}
+
 QByteArray QSpirvCompiler::compileToSpirv()
 {
     if (d->stage == EShLangVertex && d->flags.testFlag(RewriteToMakeBatchableForSG) && d->batchableSource.isEmpty())
@@ -392,9 +868,36 @@ QByteArray QSpirvCompiler::compileToSpirv()
     return d->compile() ? d->spirv : QByteArray();
 }
 
+// Runs the preprocessor only, and returns a hash of the resulting token
+// stream, or an empty QByteArray when preprocessing fails. Sources that only
+// differ in whitespace, comments, or the parts the preprocessor drops, such
+// as inactive #if blocks, give the same hash, so this is a cheap way to tell
+// if a shader needs to be compiled again. The batchable flag is ignored: that
+// variant is derived from the same source. includedFiles() and
+// referencedPreambleMacros() are updated as with compileToSpirv().
+QByteArray QSpirvCompiler::normalizedSourceHash()
+{
+    return d->compile(true) ? d->normalizedHash : QByteArray();
+}
+
 QString QSpirvCompiler::errorMessage() const
 {
     return d->log;
 }
 
+QStringList QSpirvCompiler::includedFiles() const
+{
+    return d->includedFiles;
+}
+
+QByteArrayList QSpirvCompiler::referencedPreambleMacros() const
+{
+    return d->referencedMacros;
+}
+
+qint64 QSpirvCompiler::peakMemoryUsage() const
+{
+    return d->peakMemoryUsage;
+}
+
 QT_END_NAMESPACE
@@ -44,11 +44,14 @@
 #include <QtShaderTools/private/qtshadertoolsglobal_p.h>
 #include <QtGui/private/qshader_p.h>
 #include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QByteArrayList>
 
 QT_BEGIN_NAMESPACE
 
 struct QSpirvCompilerPrivate;
 class QIODevice;
+class QShaderIncludeResolver;
 
 class Q_SHADERTOOLS_PRIVATE_EXPORT QSpirvCompiler
 {
@@ -68,9 +71,16 @@ public:
     void setFlags(Flags flags);
     void setPreamble(const QByteArray &preamble);
     void setSGBatchingVertexInputLocation(int location);
+    void setPoolPageSize(int size);
+    void setMemoryLimit(qint64 bytes);
+    void setIncludeResolver(const QShaderIncludeResolver *resolver);
 
     QByteArray compileToSpirv();
+    QByteArray normalizedSourceHash();
     QString errorMessage() const;
+    QStringList includedFiles() const;
+    QByteArrayList referencedPreambleMacros() const;
+    qint64 peakMemoryUsage() const;
 
 private:
     Q_DISABLE_COPY(QSpirvCompiler)
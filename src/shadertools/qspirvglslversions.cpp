@@ -0,0 +1,449 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Shader Tools module
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#include "qspirvglslversions_p.h"
+#include <QtCore/QHash>
+#include <QtCore/QSet>
+
+#define SPV_ENABLE_UTILITY_CODE
+#include <spirv.h>
+#include <GLSL.std.450.h>
+
+// Finds the GLSL versions at which SPIRV-Cross starts to emit something else
+// than the #version directive for a given module. Between two consecutive
+// thresholds, the code for all versions is the same apart from the first
+// line, so one translation per range is enough.
+//
+// SPIRV-Cross checks the version in many places, most of them for features
+// that simple vertex and fragment shaders never use. For modules built only
+// from the types, instructions and built-ins listed here, the thresholds are
+// derived from what the module has: input and output syntax and texture
+// function names (130, ES 300), explicit locations for vertex inputs and
+// fragment outputs (330), explicit locations for the other inputs and
+// outputs (410, ES 310), and binding qualifiers for samplers, since the
+// 420pack extension is never enabled (420, ES 310). For anything else, all
+// the versions SPIRV-Cross is known to check are thresholds.
+
+QT_BEGIN_NAMESPACE
+
+namespace QSpirvGlslVersions {
+
+static const int allDesktopThresholds[] = { 130, 140, 150, 330, 400, 410, 420, 430, 440, 450, 460 };
+static const int allEsThresholds[] = { 300, 310, 320 };
+
+static bool isKnownOp(SpvOp op)
+{
+    switch (op) {
+    case SpvOpNop:
+    case SpvOpUndef:
+    case SpvOpSourceContinued:
+    case SpvOpSource:
+    case SpvOpSourceExtension:
+    case SpvOpName:
+    case SpvOpMemberName:
+    case SpvOpString:
+    case SpvOpLine:
+    case SpvOpNoLine:
+    case SpvOpModuleProcessed:
+    case SpvOpMemoryModel:
+    case SpvOpTypeVoid:
+    case SpvOpTypeBool:
+    case SpvOpTypeVector:
+    case SpvOpTypeMatrix:
+    case SpvOpTypeSampledImage:
+    case SpvOpTypeArray:
+    case SpvOpTypeStruct:
+    case SpvOpTypePointer:
+    case SpvOpTypeFunction:
+    case SpvOpConstantTrue:
+    case SpvOpConstantFalse:
+    case SpvOpConstant:
+    case SpvOpConstantComposite:
+    case SpvOpConstantNull:
+    case SpvOpFunction:
+    case SpvOpFunctionParameter:
+    case SpvOpFunctionEnd:
+    case SpvOpFunctionCall:
+    case SpvOpLoad:
+    case SpvOpStore:
+    case SpvOpVectorExtractDynamic:
+    case SpvOpVectorInsertDynamic:
+    case SpvOpVectorShuffle:
+    case SpvOpCompositeConstruct:
+    case SpvOpCompositeExtract:
+    case SpvOpCompositeInsert:
+    case SpvOpCopyObject:
+    case SpvOpTranspose:
+    case SpvOpSampledImage:
+    case SpvOpImageSampleImplicitLod:
+    case SpvOpImageSampleExplicitLod:
+    case SpvOpImageSampleDrefImplicitLod:
+    case SpvOpImageSampleDrefExplicitLod:
+    case SpvOpImageSampleProjImplicitLod:
+    case SpvOpImageSampleProjExplicitLod:
+    case SpvOpConvertFToU:
+    case SpvOpConvertFToS:
+    case SpvOpConvertSToF:
+    case SpvOpConvertUToF:
+    case SpvOpBitcast:
+    case SpvOpSNegate:
+    case SpvOpFNegate:
+    case SpvOpIAdd:
+    case SpvOpFAdd:
+    case SpvOpISub:
+    case SpvOpFSub:
+    case SpvOpIMul:
+    case SpvOpFMul:
+    case SpvOpUDiv:
+    case SpvOpSDiv:
+    case SpvOpFDiv:
+    case SpvOpUMod:
+    case SpvOpSMod:
+    case SpvOpFMod:
+    case SpvOpVectorTimesScalar:
+    case SpvOpMatrixTimesScalar:
+    case SpvOpVectorTimesMatrix:
+    case SpvOpMatrixTimesVector:
+    case SpvOpMatrixTimesMatrix:
+    case SpvOpOuterProduct:
+    case SpvOpDot:
+    case SpvOpAny:
+    case SpvOpAll:
+    case SpvOpIsNan:
+    case SpvOpIsInf:
+    case SpvOpLogicalEqual:
+    case SpvOpLogicalNotEqual:
+    case SpvOpLogicalOr:
+    case SpvOpLogicalAnd:
+    case SpvOpLogicalNot:
+    case SpvOpIEqual:
+    case SpvOpINotEqual:
+    case SpvOpUGreaterThan:
+    case SpvOpSGreaterThan:
+    case SpvOpUGreaterThanEqual:
+    case SpvOpSGreaterThanEqual:
+    case SpvOpULessThan:
+    case SpvOpSLessThan:
+    case SpvOpULessThanEqual:
+    case SpvOpSLessThanEqual:
+    case SpvOpFOrdEqual:
+    case SpvOpFOrdNotEqual:
+    case SpvOpFOrdLessThan:
+    case SpvOpFOrdGreaterThan:
+    case SpvOpFOrdLessThanEqual:
+    case SpvOpFOrdGreaterThanEqual:
+    case SpvOpShiftRightLogical:
+    case SpvOpShiftRightArithmetic:
+    case SpvOpShiftLeftLogical:
+    case SpvOpBitwiseOr:
+    case SpvOpBitwiseXor:
+    case SpvOpBitwiseAnd:
+    case SpvOpNot:
+    case SpvOpDPdx:
+    case SpvOpDPdy:
+    case SpvOpFwidth:
+    case SpvOpPhi:
+    case SpvOpLoopMerge:
+    case SpvOpSelectionMerge:
+    case SpvOpLabel:
+    case SpvOpBranch:
+    case SpvOpBranchConditional:
+    case SpvOpSwitch:
+    case SpvOpKill:
+    case SpvOpReturn:
+    case SpvOpReturnValue:
+    case SpvOpUnreachable:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool isKnownExtInst(quint32 inst)
+{
+    if (inst >= GLSLstd450Round && inst <= GLSLstd450InverseSqrt)
+        return true;
+    if (inst >= GLSLstd450FMin && inst <= GLSLstd450SmoothStep)
+        return inst != GLSLstd450IMix;
+    return inst >= GLSLstd450Length && inst <= GLSLstd450Refract;
+}
+
+static bool isKnownDecoration(quint32 decoration)
+{
+    switch (decoration) {
+    case SpvDecorationRelaxedPrecision:
+    case SpvDecorationBlock:
+    case SpvDecorationRowMajor:
+    case SpvDecorationColMajor:
+    case SpvDecorationArrayStride:
+    case SpvDecorationMatrixStride:
+    case SpvDecorationNoPerspective:
+    case SpvDecorationFlat:
+    case SpvDecorationCentroid:
+    case SpvDecorationLocation:
+    case SpvDecorationBinding:
+    case SpvDecorationDescriptorSet:
+    case SpvDecorationOffset:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool isKnownBuiltIn(quint32 builtIn)
+{
+    switch (builtIn) {
+    case SpvBuiltInPosition:
+    case SpvBuiltInPointSize:
+    case SpvBuiltInFragCoord:
+    case SpvBuiltInFrontFacing:
+    case SpvBuiltInPointCoord:
+    case SpvBuiltInFragDepth:
+        return true;
+    default:
+        return false;
+    }
+}
+
+struct Usage
+{
+    bool known = false;
+    bool varyings = false;
+    bool samplers = false;
+};
+
+static Usage usage(const QByteArray &spirv)
+{
+    Usage u;
+    if (spirv.size() < 20 || spirv.size() % 4)
+        return u;
+
+    QVector<quint32> words(spirv.size() / 4);
+    memcpy(words.data(), spirv.constData(), spirv.size());
+    if (words[0] != SpvMagicNumber)
+        return u;
+
+    SpvExecutionModel model = SpvExecutionModelMax;
+    quint32 glslStd450 = 0;
+    QSet<quint32> vectorTypes;
+    QHash<quint32, quint32> pointeeTypes; // pointer type -> pointee type
+    QHash<quint32, quint32> resultTypes; // result id -> type
+    QHash<quint32, quint32> constants;
+    QSet<quint32> builtInIds; // variables and struct types with built-ins
+    QHash<quint32, QHash<quint32, quint32>> memberBuiltIns; // struct type -> member -> built-in
+    QHash<quint32, quint32> interfaceVars; // Input and Output variables -> pointee type
+    QHash<quint32, SpvStorageClass> storageClasses;
+
+    int pos = 5;
+    while (pos < words.count()) {
+        const int wordCount = int(words[pos] >> 16);
+        if (wordCount == 0 || pos + wordCount > words.count())
+            return u;
+        const SpvOp op = SpvOp(words[pos] & 0xFFFF);
+        const quint32 *w = words.constData() + pos;
+
+        bool hasResult = false;
+        bool hasResultType = false;
+        SpvHasResultAndType(op, &hasResult, &hasResultType);
+        if (hasResult && hasResultType && wordCount > 2)
+            resultTypes.insert(w[2], w[1]);
+
+        switch (op) {
+        case SpvOpCapability:
+            if (wordCount < 2 || (w[1] != SpvCapabilityShader && w[1] != SpvCapabilityMatrix))
+                return u;
+            break;
+        case SpvOpExtInstImport:
+            if (wordCount < 3 || qstrncmp(reinterpret_cast<const char *>(w + 2), "GLSL.std.450", 13))
+                return u;
+            glslStd450 = w[1];
+            break;
+        case SpvOpExtInst:
+            if (wordCount < 5 || w[3] != glslStd450 || !isKnownExtInst(w[4]))
+                return u;
+            break;
+        case SpvOpEntryPoint:
+            if (wordCount < 3 || model != SpvExecutionModelMax)
+                return u;
+            model = SpvExecutionModel(w[1]);
+            if (model != SpvExecutionModelVertex && model != SpvExecutionModelFragment)
+                return u;
+            break;
+        case SpvOpExecutionMode:
+            if (wordCount < 3 || (w[2] != SpvExecutionModeOriginUpperLeft && w[2] != SpvExecutionModeDepthReplacing))
+                return u;
+            break;
+        case SpvOpDecorate:
+            if (wordCount < 3)
+                return u;
+            if (w[2] == SpvDecorationBuiltIn) {
+                if (wordCount < 4 || !isKnownBuiltIn(w[3]))
+                    return u;
+                builtInIds.insert(w[1]);
+            } else if (!isKnownDecoration(w[2])) {
+                return u;
+            }
+            break;
+        case SpvOpMemberDecorate:
+            if (wordCount < 4)
+                return u;
+            if (w[3] == SpvDecorationBuiltIn) {
+                // ClipDistance and CullDistance are in every gl_PerVertex
+                // glslang generates, they only matter when accessed.
+                if (wordCount < 5 || (!isKnownBuiltIn(w[4]) && w[4] != SpvBuiltInClipDistance
+                                      && w[4] != SpvBuiltInCullDistance))
+                    return u;
+                builtInIds.insert(w[1]);
+                memberBuiltIns[w[1]].insert(w[2], w[4]);
+            } else if (!isKnownDecoration(w[3])) {
+                return u;
+            }
+            break;
+        case SpvOpTypeInt:
+        case SpvOpTypeFloat:
+            if (wordCount < 3 || w[2] != 32)
+                return u;
+            break;
+        case SpvOpTypeVector:
+            vectorTypes.insert(w[1]);
+            break;
+        case SpvOpTypeImage:
+            // 2D, 3D and cube textures, not arrayed, not multisampled, sampled
+            if (wordCount < 9 || (w[3] != SpvDim2D && w[3] != SpvDim3D && w[3] != SpvDimCube)
+                    || w[5] != 0 || w[6] != 0 || w[7] != 1)
+                return u;
+            break;
+        case SpvOpTypePointer:
+            if (wordCount < 4)
+                return u;
+            pointeeTypes.insert(w[1], w[3]);
+            break;
+        case SpvOpConstant:
+            if (wordCount == 4)
+                constants.insert(w[2], w[3]);
+            break;
+        case SpvOpVariable:
+        {
+            if (wordCount < 4)
+                return u;
+            const SpvStorageClass storage = SpvStorageClass(w[3]);
+            switch (storage) {
+            case SpvStorageClassInput:
+            case SpvStorageClassOutput:
+                interfaceVars.insert(w[2], pointeeTypes.value(w[1]));
+                break;
+            case SpvStorageClassUniformConstant:
+                u.samplers = true;
+                break;
+            case SpvStorageClassUniform:
+            case SpvStorageClassPrivate:
+            case SpvStorageClassFunction:
+                break;
+            default:
+                return u;
+            }
+            storageClasses.insert(w[2], storage);
+        }
+            break;
+        case SpvOpAccessChain:
+        case SpvOpInBoundsAccessChain:
+            if (wordCount > 4) {
+                const quint32 structType = interfaceVars.value(w[3]);
+                const auto members = memberBuiltIns.constFind(structType);
+                if (members != memberBuiltIns.cend()) {
+                    const auto c = constants.constFind(w[4]);
+                    if (c == constants.cend() || !isKnownBuiltIn(members->value(*c)))
+                        return u;
+                }
+            }
+            break;
+        case SpvOpSelect:
+            // a vector condition may become a mix() that needs newer versions
+            if (wordCount < 6 || vectorTypes.contains(resultTypes.value(w[3])))
+                return u;
+            break;
+        default:
+            if (!isKnownOp(op))
+                return u;
+            break;
+        }
+        pos += wordCount;
+    }
+
+    if (model == SpvExecutionModelMax)
+        return u;
+
+    const SpvStorageClass varyingStorage = model == SpvExecutionModelVertex
+            ? SpvStorageClassOutput : SpvStorageClassInput;
+    for (auto it = interfaceVars.cbegin(), end = interfaceVars.cend(); it != end; ++it) {
+        if (storageClasses.value(it.key()) == varyingStorage
+                && !builtInIds.contains(it.key()) && !builtInIds.contains(it.value()))
+        {
+            u.varyings = true;
+        }
+    }
+
+    u.known = true;
+    return u;
+}
+
+QVector<int> thresholds(const QByteArray &spirv, bool es)
+{
+    const Usage u = usage(spirv);
+    QVector<int> result;
+    if (!u.known) {
+        if (es) {
+            for (int v : allEsThresholds)
+                result.append(v);
+        } else {
+            for (int v : allDesktopThresholds)
+                result.append(v);
+        }
+        return result;
+    }
+
+    if (es) {
+        result.append(300);
+        if (u.varyings || u.samplers)
+            result.append(310);
+    } else {
+        result.append(130);
+        result.append(330);
+        if (u.varyings)
+            result.append(410);
+        if (u.samplers)
+            result.append(420);
+    }
+    return result;
+}
+
+} // namespace QSpirvGlslVersions
+
+QT_END_NAMESPACE
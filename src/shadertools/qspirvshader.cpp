@@ -29,10 +29,14 @@
 
 #include "qspirvshader_p.h"
 #include "qspirvshaderremap_p.h"
+#include "qspirvshadercost_p.h"
 #include <QtGui/private/qshaderdescription_p_p.h>
 #include <QFile>
+#include <QSet>
 #include <QDebug>
 
+#include <algorithm>
+
 #include <spirv_cross_c.h>
 
 QT_BEGIN_NAMESPACE
@@ -41,20 +45,46 @@ struct QSpirvShaderPrivate
 {
     ~QSpirvShaderPrivate();
 
+    void setIr(const QByteArray &spirv);
     void createCompiler(spvc_backend backend);
+    spvc_compiler_options compilerOptions(spvc_compiler compiler, spvc_compiler_options *cache, bool *created);
+    void collectMslResources();
+    void mslNativeBindings(QShader::NativeResourceBindingMap *nativeBindings);
     void processResources();
+    void processSpecializationConstants();
 
     QShaderDescription::InOutVariable inOutVar(const spvc_reflected_resource &r);
     QShaderDescription::BlockVariable blockVar(spvc_type_id typeId, uint32_t memberIdx);
 
     QByteArray ir;
     QShaderDescription shaderDescription;
+    QVector<QSpirvShader::SpecializationConstant> specConstants;
 
     spvc_context ctx = nullptr;
+    spvc_parsed_ir parsedIr = nullptr;
     spvc_compiler glslGen = nullptr;
     spvc_compiler hlslGen = nullptr;
     spvc_compiler mslGen = nullptr;
 
+    // Created from the first compiler of each backend and installed into
+    // every later one, with only the per-call settings updated in between.
+    spvc_compiler_options glslOptions = nullptr;
+    spvc_compiler_options hlslOptions = nullptr;
+    spvc_compiler_options mslOptions = nullptr;
+
+    // The resources with a native binding in MSL, collected only once since
+    // every MSL compiler works on a copy of the same IR.
+    struct MslResource {
+        spvc_variable_id id;
+        int binding;
+        bool combinedImageSampler;
+    };
+    QVector<MslResource> mslResources;
+    bool mslResourcesCollected = false;
+    // Typically the same for all MSL versions, in which case all results
+    // share one map.
+    QShader::NativeResourceBindingMap lastMslBindings;
+
     QString spirvCrossErrorMsg;
 };
 
@@ -63,6 +93,97 @@ QSpirvShaderPrivate::~QSpirvShaderPrivate()
     spvc_context_destroy(ctx);
 }
 
+void QSpirvShaderPrivate::setIr(const QByteArray &spirv)
+{
+    // The SPIR-V is shared, not copied, and is returned as-is from
+    // QSpirvShader::spirvBinary().
+    ir = spirv;
+
+    // Everything allocated from the context belongs to the previous module.
+    spvc_context_destroy(ctx);
+    ctx = nullptr;
+    parsedIr = nullptr;
+    glslGen = hlslGen = mslGen = nullptr;
+    glslOptions = hlslOptions = mslOptions = nullptr;
+    mslResources.clear();
+    mslResourcesCollected = false;
+    lastMslBindings.clear();
+}
+
+// Options are not tied to a compiler instance, only to the backend, so one
+// object per backend is enough. created tells if the settings that are the
+// same for every call need to be applied.
+spvc_compiler_options QSpirvShaderPrivate::compilerOptions(spvc_compiler compiler, spvc_compiler_options *cache,
+                                                           bool *created)
+{
+    *created = false;
+    if (!*cache) {
+        if (spvc_compiler_create_compiler_options(compiler, cache) != SPVC_SUCCESS) {
+            *cache = nullptr;
+            return nullptr;
+        }
+        *created = true;
+    }
+    return *cache;
+}
+
+void QSpirvShaderPrivate::collectMslResources()
+{
+    mslResourcesCollected = true;
+
+    spvc_resources resources;
+    if (spvc_compiler_create_shader_resources(mslGen, &resources) != SPVC_SUCCESS)
+        return;
+
+    static const struct {
+        spvc_resource_type type;
+        bool combinedImageSampler;
+    } types[] = {
+        { SPVC_RESOURCE_TYPE_UNIFORM_BUFFER, false },
+        { SPVC_RESOURCE_TYPE_STORAGE_BUFFER, false },
+        { SPVC_RESOURCE_TYPE_SAMPLED_IMAGE, true },
+        { SPVC_RESOURCE_TYPE_STORAGE_IMAGE, false }
+    };
+    for (const auto &t : types) {
+        const spvc_reflected_resource *resourceList = nullptr;
+        size_t resourceListCount = 0;
+        if (spvc_resources_get_resource_list_for_type(resources, t.type,
+                                                      &resourceList, &resourceListCount) == SPVC_SUCCESS)
+        {
+            for (size_t i = 0; i < resourceListCount; ++i) {
+                const unsigned binding = spvc_compiler_get_decoration(mslGen, resourceList[i].id, SpvDecorationBinding);
+                mslResources.append({ resourceList[i].id, int(binding), t.combinedImageSampler });
+            }
+        }
+    }
+}
+
+void QSpirvShaderPrivate::mslNativeBindings(QShader::NativeResourceBindingMap *nativeBindings)
+{
+    if (!mslResourcesCollected)
+        collectMslResources();
+
+    // A nativeBinding of -1 means unused. This also fits
+    // *_get_automatic_resource_binding() which returns uint32_t(-1) when
+    // there is no binding, which can happen when the uniform block, sampler,
+    // etc. is not actively used in the shader. The map must always be
+    // complete, including a (binding -> -1) mapping for inactive resources as
+    // well. The second value of the pair is only relevant for combined image
+    // samplers, and is -1 otherwise.
+    QShader::NativeResourceBindingMap bindings;
+    for (const MslResource &r : qAsConst(mslResources)) {
+        const unsigned nativeBinding = spvc_compiler_msl_get_automatic_resource_binding(mslGen, r.id);
+        const int nativeSamplerBinding = r.combinedImageSampler
+                ? int(spvc_compiler_msl_get_automatic_resource_binding_secondary(mslGen, r.id))
+                : -1;
+        bindings.insert(r.binding, { int(nativeBinding), nativeSamplerBinding });
+    }
+
+    if (bindings != lastMslBindings)
+        lastMslBindings = bindings;
+    *nativeBindings = lastMslBindings;
+}
+
 void QSpirvShaderPrivate::createCompiler(spvc_backend backend)
 {
     if (!ctx) {
@@ -72,12 +193,16 @@ void QSpirvShaderPrivate::createCompiler(spvc_backend backend)
         }
     }
 
-    const SpvId *spirv = reinterpret_cast<const SpvId *>(ir.constData());
-    size_t wordCount = ir.size() / sizeof(SpvId);
-    spvc_parsed_ir parsedIr;
-    if (spvc_context_parse_spirv(ctx, spirv, wordCount, &parsedIr) != SPVC_SUCCESS) {
-        qWarning("Failed to parse SPIR-V: %s", spvc_context_get_last_error_string(ctx));
-        return;
+    // Parse only once. Each compiler gets its own copy of the parsed IR
+    // since compiling modifies it, but copying is a lot cheaper than parsing.
+    if (!parsedIr) {
+        const SpvId *spirv = reinterpret_cast<const SpvId *>(ir.constData());
+        size_t wordCount = ir.size() / sizeof(SpvId);
+        if (spvc_context_parse_spirv(ctx, spirv, wordCount, &parsedIr) != SPVC_SUCCESS) {
+            qWarning("Failed to parse SPIR-V: %s", spvc_context_get_last_error_string(ctx));
+            parsedIr = nullptr;
+            return;
+        }
     }
 
     spvc_compiler *outCompiler = nullptr;
@@ -96,7 +221,7 @@ void QSpirvShaderPrivate::createCompiler(spvc_backend backend)
     }
 
     if (spvc_context_create_compiler(ctx, backend, parsedIr,
-                                     SPVC_CAPTURE_MODE_TAKE_OWNERSHIP, outCompiler) != SPVC_SUCCESS)
+                                     SPVC_CAPTURE_MODE_COPY, outCompiler) != SPVC_SUCCESS)
     {
         qWarning("Failed to create SPIRV-Cross compiler: %s", spvc_context_get_last_error_string(ctx));
         return;
@@ -475,6 +600,188 @@ void QSpirvShaderPrivate::processResources()
     }
 }
 
+void QSpirvShaderPrivate::processSpecializationConstants()
+{
+    specConstants.clear();
+    if (!glslGen)
+        return;
+
+    const spvc_specialization_constant *constants = nullptr;
+    size_t count = 0;
+    if (spvc_compiler_get_specialization_constants(glslGen, &constants, &count) != SPVC_SUCCESS)
+        return;
+
+    for (size_t i = 0; i < count; ++i) {
+        spvc_constant c = spvc_compiler_get_constant_handle(glslGen, constants[i].id);
+        const spvc_type t = spvc_compiler_get_type_handle(glslGen, spvc_constant_get_type(c));
+        if (spvc_type_get_vector_size(t) != 1 || spvc_type_get_columns(t) != 1)
+            continue;
+        QSpirvShader::SpecializationConstant sc;
+        sc.constantId = int(constants[i].constant_id);
+        sc.name = spvc_compiler_get_name(glslGen, constants[i].id);
+        switch (spvc_type_get_basetype(t)) {
+        case SPVC_BASETYPE_BOOLEAN:
+            sc.type = QSpirvShader::SpecializationConstant::Bool;
+            sc.defaultValue = spvc_constant_get_scalar_u32(c, 0, 0) != 0;
+            break;
+        case SPVC_BASETYPE_INT32:
+            sc.type = QSpirvShader::SpecializationConstant::Int;
+            sc.defaultValue = spvc_constant_get_scalar_i32(c, 0, 0);
+            break;
+        case SPVC_BASETYPE_UINT32:
+            sc.type = QSpirvShader::SpecializationConstant::Uint;
+            sc.defaultValue = spvc_constant_get_scalar_u32(c, 0, 0);
+            break;
+        case SPVC_BASETYPE_FP32:
+            sc.type = QSpirvShader::SpecializationConstant::Float;
+            sc.defaultValue = spvc_constant_get_scalar_fp32(c, 0, 0);
+            break;
+        case SPVC_BASETYPE_FP64:
+            sc.type = QSpirvShader::SpecializationConstant::Double;
+            sc.defaultValue = spvc_constant_get_scalar_fp64(c, 0, 0);
+            break;
+        default:
+            qWarning("Unsupported specialization constant type for constant_id %u", constants[i].constant_id);
+            continue;
+        }
+        specConstants.append(sc);
+    }
+
+    std::sort(specConstants.begin(), specConstants.end(),
+              [](const QSpirvShader::SpecializationConstant &a, const QSpirvShader::SpecializationConstant &b) {
+        return a.constantId < b.constantId;
+    });
+}
+
+// Strings are accepted as well, since that is what comes from command lines.
+static bool specConstantBool(const QVariant &v, bool *ok)
+{
+    *ok = true;
+    if (v.userType() == QMetaType::Bool)
+        return v.toBool();
+    const QString s = v.toString().trimmed().toLower();
+    if (s == QLatin1String("true") || s == QLatin1String("1"))
+        return true;
+    if (s == QLatin1String("false") || s == QLatin1String("0"))
+        return false;
+    *ok = false;
+    return false;
+}
+
+// Turns the specialization constants listed in values into regular
+// constants with the given value. This is done on the SPIR-V level, before
+// SPIRV-Cross ever sees the module, so that all targets are generated with
+// the values baked in, exactly like a Vulkan implementation would do it.
+// Constants the module does not declare are skipped, found receives the ones
+// that were specialized.
+static QByteArray freezeSpecializationConstants(const QByteArray &ir, const QHash<int, QVariant> &values,
+                                                QString *errorMessage, QSet<int> *found)
+{
+    if (ir.size() < 20 || ir.size() % 4) {
+        *errorMessage = QLatin1String("Invalid SPIR-V binary");
+        return QByteArray();
+    }
+
+    const int wordTotal = ir.size() / 4;
+    QVector<quint32> words(wordTotal);
+    memcpy(words.data(), ir.constData(), ir.size());
+
+    struct ScalarType { bool isBool; bool isFloat; bool isSigned; quint32 width; };
+    QHash<quint32, ScalarType> types;
+    QHash<quint32, int> specIds; // result id -> constant_id
+
+    int pos = 5;
+    while (pos < wordTotal) {
+        const int wordCount = int(words[pos] >> 16);
+        if (wordCount == 0 || pos + wordCount > wordTotal) {
+            *errorMessage = QLatin1String("Invalid SPIR-V binary");
+            return QByteArray();
+        }
+        switch (words[pos] & 0xFFFF) {
+        case SpvOpDecorate:
+            if (wordCount >= 4 && words[pos + 2] == SpvDecorationSpecId)
+                specIds.insert(words[pos + 1], int(words[pos + 3]));
+            break;
+        case SpvOpTypeBool:
+            types.insert(words[pos + 1], { true, false, false, 32 });
+            break;
+        case SpvOpTypeInt:
+            types.insert(words[pos + 1], { false, false, words[pos + 3] != 0, words[pos + 2] });
+            break;
+        case SpvOpTypeFloat:
+            types.insert(words[pos + 1], { false, true, false, words[pos + 2] });
+            break;
+        default:
+            break;
+        }
+        pos += wordCount;
+    }
+
+    // The output is never larger than the input, so it is written into one
+    // buffer of the input's size of which only the used part is returned.
+    QVector<quint32> result(wordTotal);
+    memcpy(result.data(), words.constData(), 5 * 4);
+    int resultCount = 5;
+
+    pos = 5;
+    while (pos < wordTotal) {
+        const int wordCount = int(words[pos] >> 16);
+        const quint32 op = words[pos] & 0xFFFF;
+        const int first = resultCount;
+        memcpy(result.data() + first, words.constData() + pos, wordCount * 4);
+        resultCount += wordCount;
+        pos += wordCount;
+
+        if (op == SpvOpDecorate) {
+            if (words[pos - wordCount + 2] == SpvDecorationSpecId
+                    && values.contains(int(words[pos - wordCount + 3])))
+            {
+                resultCount = first; // the constant is not specializable anymore
+            }
+            continue;
+        }
+        if (op != SpvOpSpecConstantTrue && op != SpvOpSpecConstantFalse && op != SpvOpSpecConstant)
+            continue;
+
+        const int constantId = specIds.value(result[first + 2], -1);
+        if (!values.contains(constantId))
+            continue;
+
+        const QVariant &v(values[constantId]);
+        const ScalarType type = types.value(result[first + 1]);
+        bool ok = true;
+        if (op == SpvOpSpecConstantTrue || op == SpvOpSpecConstantFalse) {
+            const bool b = specConstantBool(v, &ok);
+            result[first] = (result[first] & 0xFFFF0000) | (b ? SpvOpConstantTrue : SpvOpConstantFalse);
+        } else if (type.isFloat && type.width == 32 && wordCount == 4) {
+            const float f = v.toFloat(&ok);
+            memcpy(&result[first + 3], &f, 4);
+        } else if (type.isFloat && type.width == 64 && wordCount == 5) {
+            const double f = v.toDouble(&ok);
+            memcpy(&result[first + 3], &f, 8);
+        } else if (!type.isFloat && type.width == 32 && wordCount == 4) {
+            result[first + 3] = type.isSigned ? quint32(v.toInt(&ok)) : v.toUInt(&ok);
+        } else if (!type.isFloat && type.width == 64 && wordCount == 5) {
+            const quint64 u = type.isSigned ? quint64(v.toLongLong(&ok)) : v.toULongLong(&ok);
+            result[first + 3] = quint32(u);
+            result[first + 4] = quint32(u >> 32);
+        } else {
+            *errorMessage = QString::fromLatin1("Specialization constant %1 has an unsupported type").arg(constantId);
+            return QByteArray();
+        }
+        if (!ok) {
+            *errorMessage = QString::fromLatin1("Invalid value %1 for specialization constant %2")
+                    .arg(v.toString()).arg(constantId);
+            return QByteArray();
+        }
+        if (op == SpvOpSpecConstant)
+            result[first] = (result[first] & 0xFFFF0000) | SpvOpConstant;
+        found->insert(constantId);
+    }
+
+    return QByteArray(reinterpret_cast<const char *>(result.constData()), resultCount * 4);
+}
+
 QSpirvShader::QSpirvShader()
     : d(new QSpirvShaderPrivate)
 {
@@ -497,16 +804,23 @@ void QSpirvShader::setFileName(const QString &fileName)
 
 void QSpirvShader::setDevice(QIODevice *device)
 {
-    d->ir = device->readAll();
+    d->setIr(device->readAll());
     d->createCompiler(SPVC_BACKEND_GLSL);
     d->processResources();
+    d->processSpecializationConstants();
 }
 
 void QSpirvShader::setSpirvBinary(const QByteArray &spirv)
 {
-    d->ir = spirv;
+    d->setIr(spirv);
     d->createCompiler(SPVC_BACKEND_GLSL);
     d->processResources();
+    d->processSpecializationConstants();
+}
+
+QByteArray QSpirvShader::spirvBinary() const
+{
+    return d->ir;
 }
 
 QShaderDescription QSpirvShader::shaderDescription() const
@@ -514,6 +828,43 @@ QShaderDescription QSpirvShader::shaderDescription() const
     return d->shaderDescription;
 }
 
+QVector<QSpirvShader::SpecializationConstant> QSpirvShader::specializationConstants() const
+{
+    return d->specConstants;
+}
+
+QSpirvShader::CostInfo QSpirvShader::costInfo() const
+{
+    CostInfo info = QSpirvShaderCost::analyze(d->ir);
+    for (const QShaderDescription::UniformBlock &blk : d->shaderDescription.uniformBlocks())
+        info.uniformBlockSize += blk.size;
+    info.samplerCount = d->shaderDescription.combinedImageSamplers().count();
+    return info;
+}
+
+QByteArray QSpirvShader::specializedSpirvBinary(const QByteArray &spirv, const QHash<int, QVariant> &values,
+                                                QString *errorMessage, QSet<int> *specializedIds)
+{
+    QString msg;
+    QSet<int> found;
+    QByteArray result = freezeSpecializationConstants(spirv, values, &msg, &found);
+    if (msg.isEmpty() && !specializedIds) {
+        // without a way to report them, unknown ids are an error
+        for (auto it = values.cbegin(), end = values.cend(); it != end; ++it) {
+            if (!found.contains(it.key())) {
+                msg = QString::fromLatin1("No specialization constant with constant_id %1").arg(it.key());
+                result.clear();
+                break;
+            }
+        }
+    }
+    if (specializedIds)
+        *specializedIds = found;
+    if (errorMessage)
+        *errorMessage = msg;
+    return result;
+}
+
 QByteArray QSpirvShader::remappedSpirvBinary(RemapFlags flags, QString *errorMessage) const
 {
     QSpirvShaderRemapper remapper;
@@ -531,9 +882,20 @@ QByteArray QSpirvShader::translateToGLSL(int version, GlslFlags flags) const
     if (!d->glslGen)
         return QByteArray();
 
-    spvc_compiler_options options = nullptr;
-    if (spvc_compiler_create_compiler_options(d->glslGen, &options) != SPVC_SUCCESS)
+    bool created;
+    spvc_compiler_options options = d->compilerOptions(d->glslGen, &d->glslOptions, &created);
+    if (!options)
         return QByteArray();
+    if (created) {
+        // The gl backend of QRhi is not prepared for UBOs atm. Have a uniform (heh)
+        // behavior regardless of the GLSL version.
+        spvc_compiler_options_set_bool(options, SPVC_COMPILER_OPTION_GLSL_EMIT_UNIFORM_BUFFER_AS_PLAIN_UNIFORMS,
+                                       true);
+        // Do not emit binding qualifiers for samplers (and for uniform blocks, but
+        // those we just disabled above).
+        spvc_compiler_options_set_bool(options, SPVC_COMPILER_OPTION_GLSL_ENABLE_420PACK_EXTENSION,
+                                       false);
+    }
     spvc_compiler_options_set_uint(options, SPVC_COMPILER_OPTION_GLSL_VERSION,
                                    version);
     spvc_compiler_options_set_bool(options, SPVC_COMPILER_OPTION_GLSL_ES,
@@ -542,14 +904,6 @@ QByteArray QSpirvShader::translateToGLSL(int version, GlslFlags flags) const
                                    flags.testFlag(FixClipSpace));
     spvc_compiler_options_set_bool(options, SPVC_COMPILER_OPTION_GLSL_ES_DEFAULT_FLOAT_PRECISION_HIGHP,
                                    !flags.testFlag(FragDefaultMediump));
-    // The gl backend of QRhi is not prepared for UBOs atm. Have a uniform (heh)
-    // behavior regardless of the GLSL version.
-    spvc_compiler_options_set_bool(options, SPVC_COMPILER_OPTION_GLSL_EMIT_UNIFORM_BUFFER_AS_PLAIN_UNIFORMS,
-                                   true);
-    // Do not emit binding qualifiers for samplers (and for uniform blocks, but
-    // those we just disabled above).
-    spvc_compiler_options_set_bool(options, SPVC_COMPILER_OPTION_GLSL_ENABLE_420PACK_EXTENSION,
-                                   false);
     spvc_compiler_install_compiler_options(d->glslGen, options);
 
     const char *result = nullptr;
@@ -572,15 +926,18 @@ QByteArray QSpirvShader::translateToHLSL(int version) const
     if (!d->hlslGen)
         return QByteArray();
 
-    spvc_compiler_options options = nullptr;
-    if (spvc_compiler_create_compiler_options(d->hlslGen, &options) != SPVC_SUCCESS)
+    bool created;
+    spvc_compiler_options options = d->compilerOptions(d->hlslGen, &d->hlslOptions, &created);
+    if (!options)
         return QByteArray();
+    if (created) {
+        spvc_compiler_options_set_bool(options, SPVC_COMPILER_OPTION_HLSL_POINT_SIZE_COMPAT,
+                                       true);
+        spvc_compiler_options_set_bool(options, SPVC_COMPILER_OPTION_HLSL_POINT_COORD_COMPAT,
+                                       true);
+    }
     spvc_compiler_options_set_uint(options, SPVC_COMPILER_OPTION_HLSL_SHADER_MODEL,
                                    version);
-    spvc_compiler_options_set_bool(options, SPVC_COMPILER_OPTION_HLSL_POINT_SIZE_COMPAT,
-                                   true);
-    spvc_compiler_options_set_bool(options, SPVC_COMPILER_OPTION_HLSL_POINT_COORD_COMPAT,
-                                   true);
     spvc_compiler_install_compiler_options(d->hlslGen, options);
 
     const char *result = nullptr;
@@ -600,8 +957,9 @@ QByteArray QSpirvShader::translateToMSL(int version, QShader::NativeResourceBind
     if (!d->mslGen)
         return QByteArray();
 
-    spvc_compiler_options options = nullptr;
-    if (spvc_compiler_create_compiler_options(d->mslGen, &options) != SPVC_SUCCESS)
+    bool created;
+    spvc_compiler_options options = d->compilerOptions(d->mslGen, &d->mslOptions, &created);
+    if (!options)
         return QByteArray();
     spvc_compiler_options_set_uint(options, SPVC_COMPILER_OPTION_MSL_VERSION,
                                    SPVC_MAKE_MSL_VERSION(version / 10, version % 10, 0));
@@ -614,57 +972,8 @@ QByteArray QSpirvShader::translateToMSL(int version, QShader::NativeResourceBind
         return QByteArray();
     }
 
-    if (nativeBindings) {
-        spvc_resources resources;
-        if (spvc_compiler_create_shader_resources(d->mslGen, &resources) == SPVC_SUCCESS) {
-            const spvc_reflected_resource *resourceList = nullptr;
-            size_t resourceListCount = 0;
-            // A nativeBinding of -1 means unused. This also fits
-            // *_get_automatic_resource_binding() which returns uint32_t(-1)
-            // when there is no binding, which can happen when the uniform
-            // block, sampler, etc. is not actively used in the shader. The map
-            // must always be complete, including a (binding -> -1) mapping for
-            // inactive resources as well. The second value of the pair is only
-            // relevant for combined image samplers, and is -1 otherwise.
-            if (spvc_resources_get_resource_list_for_type(resources, SPVC_RESOURCE_TYPE_UNIFORM_BUFFER,
-                                                          &resourceList, &resourceListCount) == SPVC_SUCCESS)
-            {
-                for (size_t i = 0; i < resourceListCount; ++i) {
-                    unsigned binding = spvc_compiler_get_decoration(d->mslGen, resourceList[i].id, SpvDecorationBinding);
-                    unsigned nativeBinding = spvc_compiler_msl_get_automatic_resource_binding(d->mslGen, resourceList[i].id);
-                    nativeBindings->insert(int(binding), { int(nativeBinding), -1 });
-                }
-            }
-            if (spvc_resources_get_resource_list_for_type(resources, SPVC_RESOURCE_TYPE_STORAGE_BUFFER,
-                                                          &resourceList, &resourceListCount) == SPVC_SUCCESS)
-            {
-                for (size_t i = 0; i < resourceListCount; ++i) {
-                    unsigned binding = spvc_compiler_get_decoration(d->mslGen, resourceList[i].id, SpvDecorationBinding);
-                    unsigned nativeBinding = spvc_compiler_msl_get_automatic_resource_binding(d->mslGen, resourceList[i].id);
-                    nativeBindings->insert(int(binding), { int(nativeBinding), -1 });
-                }
-            }
-            if (spvc_resources_get_resource_list_for_type(resources, SPVC_RESOURCE_TYPE_SAMPLED_IMAGE,
-                                                          &resourceList, &resourceListCount) == SPVC_SUCCESS)
-            {
-                for (size_t i = 0; i < resourceListCount; ++i) {
-                    unsigned binding = spvc_compiler_get_decoration(d->mslGen, resourceList[i].id, SpvDecorationBinding);
-                    unsigned nativeTextureBinding = spvc_compiler_msl_get_automatic_resource_binding(d->mslGen, resourceList[i].id);
-                    unsigned nativeSamplerBinding = spvc_compiler_msl_get_automatic_resource_binding_secondary(d->mslGen, resourceList[i].id);
-                    nativeBindings->insert(int(binding), { int(nativeTextureBinding), int(nativeSamplerBinding) });
-                }
-            }
-            if (spvc_resources_get_resource_list_for_type(resources, SPVC_RESOURCE_TYPE_STORAGE_IMAGE,
-                                                          &resourceList, &resourceListCount) == SPVC_SUCCESS)
-            {
-                for (size_t i = 0; i < resourceListCount; ++i) {
-                    unsigned binding = spvc_compiler_get_decoration(d->mslGen, resourceList[i].id, SpvDecorationBinding);
-                    unsigned nativeBinding = spvc_compiler_msl_get_automatic_resource_binding(d->mslGen, resourceList[i].id);
-                    nativeBindings->insert(int(binding), { int(nativeBinding), -1 });
-                }
-            }
-        }
-    }
+    if (nativeBindings)
+        d->mslNativeBindings(nativeBindings);
 
     return QByteArray(result);
 }
@@ -43,6 +43,9 @@
 
 #include <QtShaderTools/private/qtshadertoolsglobal_p.h>
 #include <QtGui/private/qshader_p.h>
+#include <QtCore/QVariant>
+#include <QtCore/QHash>
+#include <QtCore/QSet>
 
 QT_BEGIN_NAMESPACE
 
@@ -64,6 +67,33 @@ public:
     };
     Q_DECLARE_FLAGS(RemapFlags, RemapFlag)
 
+    struct SpecializationConstant {
+        enum Type {
+            Bool,
+            Int,
+            Uint,
+            Float,
+            Double
+        };
+        int constantId = 0;
+        Type type = Int;
+        QByteArray name;
+        QVariant defaultValue;
+    };
+
+    struct CostInfo {
+        int instructionCount = 0;
+        int aluInstructionCount = 0;
+        int textureInstructionCount = 0;
+        int branchCount = 0;
+        int loopCount = 0;
+        int maxLiveComponents = 0;
+        int inputComponents = 0;
+        int outputComponents = 0;
+        int uniformBlockSize = 0;
+        int samplerCount = 0;
+    };
+
     QSpirvShader();
     ~QSpirvShader();
 
@@ -72,8 +102,13 @@ public:
     void setSpirvBinary(const QByteArray &spirv);
 
     QShaderDescription shaderDescription() const;
+    QVector<SpecializationConstant> specializationConstants() const;
+    CostInfo costInfo() const;
 
+    QByteArray spirvBinary() const;
     QByteArray remappedSpirvBinary(RemapFlags flags = RemapFlags(), QString *errorMessage = nullptr) const;
+    static QByteArray specializedSpirvBinary(const QByteArray &spirv, const QHash<int, QVariant> &values,
+                                             QString *errorMessage = nullptr, QSet<int> *specializedIds = nullptr);
 
     QByteArray translateToGLSL(int version = 120, GlslFlags flags = GlslFlags()) const;
     QByteArray translateToHLSL(int version = 50) const;
@@ -0,0 +1,400 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Shader Tools module
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qspirvshadercost_p.h"
+#include <QtCore/QVector>
+#include <QtCore/QHash>
+#include <QtCore/QSet>
+
+#include <algorithm>
+
+#define SPV_ENABLE_UTILITY_CODE
+#include <spirv.h>
+
+// A static estimate of what a shader costs on the GPU, to be able to catch
+// expensive shaders at build time. Instructions are counted as they appear,
+// without weighting by how often loops run. Register pressure is estimated
+// as the largest number of scalar components that are live at the same time
+// when walking the instructions of a function in order. Local variables,
+// which glslang does not turn into SSA values, count as live from their first
+// to their last use. Values that are defined before a loop and used in it
+// stay live until the end of the loop.
+
+QT_BEGIN_NAMESPACE
+
+namespace QSpirvShaderCost {
+
+enum Category {
+    Other,
+    Alu,
+    Texture,
+    Branch
+};
+
+static Category category(SpvOp op)
+{
+    if (op >= SpvOpConvertFToU && op <= SpvOpBitcast)
+        return Alu;
+    if (op >= SpvOpSNegate && op <= SpvOpSMulExtended)
+        return Alu;
+    if (op >= SpvOpAny && op <= SpvOpFUnordGreaterThanEqual)
+        return Alu;
+    if (op >= SpvOpShiftRightLogical && op <= SpvOpBitCount)
+        return Alu;
+    if (op >= SpvOpDPdx && op <= SpvOpFwidthCoarse)
+        return Alu;
+    if (op >= SpvOpImageSampleImplicitLod && op <= SpvOpImageWrite)
+        return Texture;
+    if (op >= SpvOpImageSparseSampleImplicitLod && op <= SpvOpImageSparseDrefGather)
+        return Texture;
+
+    switch (op) {
+    case SpvOpExtInst: // GLSL.std.450, all math
+    case SpvOpSelect:
+        return Alu;
+    case SpvOpImageSparseRead:
+        return Texture;
+    case SpvOpBranchConditional:
+    case SpvOpSwitch:
+        return Branch;
+    default:
+        return Other;
+    }
+}
+
+// Structure only, not executed.
+static bool isCounted(SpvOp op)
+{
+    switch (op) {
+    case SpvOpFunction:
+    case SpvOpFunctionParameter:
+    case SpvOpFunctionEnd:
+    case SpvOpLabel:
+    case SpvOpVariable:
+    case SpvOpLoopMerge:
+    case SpvOpSelectionMerge:
+    case SpvOpLine:
+    case SpvOpNoLine:
+        return false;
+    default:
+        return true;
+    }
+}
+
+struct Module
+{
+    struct Instruction {
+        int offset;
+        int wordCount;
+        SpvOp op;
+    };
+
+    bool parse(const QByteArray &spirv);
+
+    quint32 word(int instr, int idx) const { return words[instructions[instr].offset + idx]; }
+    int components(quint32 typeId) const;
+    int interfaceComponents(SpvStorageClass storage) const;
+    int maxLiveComponents(int first, int last) const;
+
+    QVector<quint32> words;
+    QVector<Instruction> instructions;
+    int firstFunction = -1;
+    QHash<quint32, int> defs; // result id -> instruction index
+    QHash<quint32, quint32> constants; // 32-bit scalar constants, for array sizes
+    QSet<quint32> builtIns;
+    QSet<quint32> structsWithBuiltIns;
+    mutable QHash<quint32, int> componentCache;
+};
+
+bool Module::parse(const QByteArray &spirv)
+{
+    if (spirv.size() < 20 || spirv.size() % 4)
+        return false;
+
+    words.resize(spirv.size() / 4);
+    memcpy(words.data(), spirv.constData(), spirv.size());
+    if (words[0] != SpvMagicNumber)
+        return false;
+
+    int pos = 5;
+    while (pos < words.count()) {
+        const int wordCount = int(words[pos] >> 16);
+        if (wordCount == 0 || pos + wordCount > words.count())
+            return false;
+        const SpvOp op = SpvOp(words[pos] & 0xFFFF);
+        const int idx = instructions.count();
+        instructions.append({ pos, wordCount, op });
+
+        bool hasResult = false;
+        bool hasResultType = false;
+        SpvHasResultAndType(op, &hasResult, &hasResultType);
+        if (hasResult) {
+            const int resultIdx = hasResultType ? 2 : 1;
+            if (resultIdx < wordCount)
+                defs.insert(words[pos + resultIdx], idx);
+        }
+
+        switch (op) {
+        case SpvOpFunction:
+            if (firstFunction < 0)
+                firstFunction = idx;
+            break;
+        case SpvOpConstant:
+            if (wordCount == 4)
+                constants.insert(words[pos + 2], words[pos + 3]);
+            break;
+        case SpvOpDecorate:
+            if (wordCount >= 3 && words[pos + 2] == SpvDecorationBuiltIn)
+                builtIns.insert(words[pos + 1]);
+            break;
+        case SpvOpMemberDecorate:
+            if (wordCount >= 4 && words[pos + 3] == SpvDecorationBuiltIn)
+                structsWithBuiltIns.insert(words[pos + 1]);
+            break;
+        default:
+            break;
+        }
+        pos += wordCount;
+    }
+
+    return true;
+}
+
+// The number of scalar components in a value of the type, with 64-bit
+// scalars counting as two. Pointers, images and samplers do not count.
+int Module::components(quint32 typeId) const
+{
+    auto cached = componentCache.constFind(typeId);
+    if (cached != componentCache.cend())
+        return *cached;
+
+    // guards against malformed, recursive types as well
+    componentCache.insert(typeId, 0);
+
+    const int instr = defs.value(typeId, -1);
+    if (instr < 0)
+        return 0;
+
+    int result = 0;
+    const int wordCount = instructions[instr].wordCount;
+    switch (instructions[instr].op) {
+    case SpvOpTypeBool:
+        result = 1;
+        break;
+    case SpvOpTypeInt:
+    case SpvOpTypeFloat:
+        result = wordCount >= 3 && word(instr, 2) == 64 ? 2 : 1;
+        break;
+    case SpvOpTypeVector:
+    case SpvOpTypeMatrix:
+        if (wordCount >= 4)
+            result = int(word(instr, 3)) * components(word(instr, 2));
+        break;
+    case SpvOpTypeArray:
+        if (wordCount >= 4)
+            result = int(constants.value(word(instr, 3), 1)) * components(word(instr, 2));
+        break;
+    case SpvOpTypeStruct:
+        for (int w = 2; w < wordCount; ++w)
+            result += components(word(instr, w));
+        break;
+    default:
+        break;
+    }
+
+    componentCache.insert(typeId, result);
+    return result;
+}
+
+// Built-ins, such as gl_Position, are not part of what gets interpolated
+// between stages and are left out.
+int Module::interfaceComponents(SpvStorageClass storage) const
+{
+    const int end = firstFunction >= 0 ? firstFunction : instructions.count();
+    int result = 0;
+    for (int i = 0; i < end; ++i) {
+        if (instructions[i].op != SpvOpVariable || instructions[i].wordCount < 4)
+            continue;
+        if (SpvStorageClass(word(i, 3)) != storage || builtIns.contains(word(i, 2)))
+            continue;
+        const int pointerType = defs.value(word(i, 1), -1);
+        if (pointerType < 0 || instructions[pointerType].wordCount < 4)
+            continue;
+        const quint32 pointee = word(pointerType, 3);
+        if (!structsWithBuiltIns.contains(pointee))
+            result += components(pointee);
+    }
+    return result;
+}
+
+// first and last are the OpFunction and OpFunctionEnd of a function.
+int Module::maxLiveComponents(int first, int last) const
+{
+    struct Value {
+        int start;
+        int end;
+        int components;
+    };
+    QVector<Value> values;
+    QHash<quint32, int> valueIndex;
+    QHash<quint32, int> labels; // label id -> instruction index
+    QVector<QPair<int, quint32>> loops; // header label index, merge block id
+    int currentLabel = first;
+
+    for (int i = first; i <= last; ++i) {
+        const SpvOp op = instructions[i].op;
+        const int wordCount = instructions[i].wordCount;
+        if (op == SpvOpLabel) {
+            currentLabel = i;
+            labels.insert(word(i, 1), i);
+            continue;
+        }
+        if (op == SpvOpLoopMerge) {
+            loops.append(qMakePair(currentLabel, word(i, 1)));
+            continue;
+        }
+
+        bool hasResult = false;
+        bool hasResultType = false;
+        SpvHasResultAndType(op, &hasResult, &hasResultType);
+        // Literals are not told apart from ids here, which at worst keeps a
+        // value live for longer.
+        for (int w = 1 + (hasResult ? 1 : 0) + (hasResultType ? 1 : 0); w < wordCount; ++w) {
+            auto it = valueIndex.constFind(word(i, w));
+            if (it == valueIndex.cend())
+                continue;
+            Value &v(values[*it]);
+            if (v.start < 0)
+                v.start = i;
+            v.end = qMax(v.end, i);
+        }
+
+        if (!hasResult || !hasResultType || wordCount < 3)
+            continue;
+        int n = 0;
+        int start = i;
+        const int type = defs.value(word(i, 1), -1);
+        if (type >= 0 && instructions[type].op == SpvOpTypePointer) {
+            // function local variables are live from their first use on
+            if (op == SpvOpVariable && instructions[type].wordCount >= 4) {
+                n = components(word(type, 3));
+                start = -1;
+            }
+        } else {
+            n = components(word(i, 1));
+        }
+        if (n > 0) {
+            valueIndex.insert(word(i, 2), values.count());
+            values.append({ start, start, n });
+        }
+    }
+
+    // Inner loops come after the outer ones, extend for them first.
+    std::sort(loops.begin(), loops.end(), [](const QPair<int, quint32> &a, const QPair<int, quint32> &b) {
+        return a.first > b.first;
+    });
+    for (const QPair<int, quint32> &loop : qAsConst(loops)) {
+        const int header = loop.first;
+        const int merge = labels.value(loop.second, last);
+        for (Value &v : values) {
+            if (v.start >= 0 && v.start < header && v.end >= header && v.end < merge)
+                v.end = merge;
+        }
+    }
+
+    QVector<QPair<int, int>> events; // position, change
+    events.reserve(values.count() * 2);
+    for (const Value &v : qAsConst(values)) {
+        if (v.start < 0)
+            continue;
+        events.append(qMakePair(v.start, v.components));
+        events.append(qMakePair(v.end + 1, -v.components));
+    }
+    // at the same position, what ends goes before what starts
+    std::sort(events.begin(), events.end());
+
+    int live = 0;
+    int result = 0;
+    for (const QPair<int, int> &e : qAsConst(events)) {
+        live += e.second;
+        result = qMax(result, live);
+    }
+    return result;
+}
+
+QSpirvShader::CostInfo analyze(const QByteArray &spirv)
+{
+    QSpirvShader::CostInfo info;
+    Module m;
+    if (!m.parse(spirv))
+        return info;
+
+    int function = -1;
+    for (int i = qMax(0, m.firstFunction); i < m.instructions.count(); ++i) {
+        const SpvOp op = m.instructions[i].op;
+        if (op == SpvOpFunction) {
+            function = i;
+            continue;
+        }
+        if (op == SpvOpFunctionEnd) {
+            if (function >= 0)
+                info.maxLiveComponents = qMax(info.maxLiveComponents, m.maxLiveComponents(function, i));
+            function = -1;
+            continue;
+        }
+        if (function < 0)
+            continue;
+        if (op == SpvOpLoopMerge)
+            ++info.loopCount;
+        if (!isCounted(op))
+            continue;
+        ++info.instructionCount;
+        switch (category(op)) {
+        case Alu:
+            ++info.aluInstructionCount;
+            break;
+        case Texture:
+            ++info.textureInstructionCount;
+            break;
+        case Branch:
+            ++info.branchCount;
+            break;
+        default:
+            break;
+        }
+    }
+
+    info.inputComponents = m.interfaceComponents(SpvStorageClassInput);
+    info.outputComponents = m.interfaceComponents(SpvStorageClassOutput);
+    return info;
+}
+
+} // namespace
+
+QT_END_NAMESPACE
@@ -58,9 +58,10 @@ QByteArray QSpirvShaderRemapper::remap(const QByteArray &ir, QSpirvShader::Remap
     const uint32_t opts = flags.testFlag(QSpirvShader::StripOnly) ? spv::spirvbin_t::STRIP
                                                                   : spv::spirvbin_t::DO_EVERYTHING;
 
-    std::vector<uint32_t> v;
-    v.resize(ir.size() / 4);
-    memcpy(v.data(), ir.constData(), v.size() * 4);
+    // spirvbin_t works in-place on a vector, that is the one copy needed
+    // on the way in, without zero-filling it first
+    const uint32_t *words = reinterpret_cast<const uint32_t *>(ir.constData());
+    std::vector<uint32_t> v(words, words + ir.size() / 4);
 
     b.remap(v, opts);
 
@@ -0,0 +1,539 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Shader Tools module
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qspirvvaryingpruner_p.h"
+#include <QtCore/QVector>
+#include <QtCore/QHash>
+#include <QtCore/QSet>
+
+#define SPV_ENABLE_UTILITY_CODE
+#include <spirv.h>
+
+// Removes the parts of the interface between two consecutive stages of a
+// pipeline that have no effect: outputs that the next stage never reads,
+// together with the code that only exists to compute them, and inputs that
+// are never read in the shader. Everything here is conservative: when the
+// module contains something that is not understood, it is left untouched.
+
+QT_BEGIN_NAMESPACE
+
+namespace QSpirvVaryingPruner {
+
+struct Module
+{
+    struct Instruction {
+        int offset;
+        int wordCount;
+        SpvOp op;
+    };
+
+    bool parse(const QByteArray &spirv);
+    QByteArray serialize() const;
+
+    quint32 word(int instr, int idx) const { return words[instructions[instr].offset + idx]; }
+    bool isCountedUse(int instr, int idx) const;
+    void countUses();
+    void removeInstruction(int instr);
+    int locationSpan(quint32 typeId, bool arrayed) const;
+    bool removeVariable(quint32 varId);
+    void removeDeadCode();
+
+    QVector<quint32> words;
+    QVector<Instruction> instructions;
+    QVector<bool> removed;
+    QVector<int> useCount;
+    QSet<quint32> removedIds;
+
+    SpvExecutionModel executionModel = SpvExecutionModelMax;
+    int firstFunction = -1;
+    QHash<quint32, int> defs; // result id -> instruction index
+    QHash<quint32, SpvStorageClass> interfaceVars;
+    QHash<quint32, quint32> locations;
+    QSet<quint32> builtIns;
+    QSet<quint32> patches;
+    QSet<quint32> structsWithBuiltIns;
+};
+
+bool Module::parse(const QByteArray &spirv)
+{
+    if (spirv.size() < 20 || spirv.size() % 4)
+        return false;
+
+    words.resize(spirv.size() / 4);
+    memcpy(words.data(), spirv.constData(), spirv.size());
+    if (words[0] != SpvMagicNumber)
+        return false;
+
+    const quint32 bound = words[3];
+    int pos = 5;
+    while (pos < words.count()) {
+        const int wordCount = int(words[pos] >> 16);
+        if (wordCount == 0 || pos + wordCount > words.count())
+            return false;
+        const SpvOp op = SpvOp(words[pos] & 0xFFFF);
+        const int idx = instructions.count();
+        instructions.append({ pos, wordCount, op });
+
+        bool hasResult = false;
+        bool hasResultType = false;
+        SpvHasResultAndType(op, &hasResult, &hasResultType);
+        if (hasResult) {
+            const int resultIdx = hasResultType ? 2 : 1;
+            if (resultIdx < wordCount)
+                defs.insert(words[pos + resultIdx], idx);
+        }
+
+        switch (op) {
+        case SpvOpEntryPoint:
+            if (executionModel != SpvExecutionModelMax)
+                return false; // only one entry point is supported
+            executionModel = SpvExecutionModel(words[pos + 1]);
+            break;
+        case SpvOpFunction:
+            if (firstFunction < 0)
+                firstFunction = idx;
+            break;
+        case SpvOpVariable:
+            if (firstFunction < 0) {
+                const SpvStorageClass storage = SpvStorageClass(words[pos + 3]);
+                if (storage == SpvStorageClassInput || storage == SpvStorageClassOutput)
+                    interfaceVars.insert(words[pos + 2], storage);
+            }
+            break;
+        case SpvOpDecorate:
+            if (wordCount >= 3) {
+                const quint32 target = words[pos + 1];
+                switch (words[pos + 2]) {
+                case SpvDecorationLocation:
+                    if (wordCount >= 4)
+                        locations.insert(target, words[pos + 3]);
+                    break;
+                case SpvDecorationBuiltIn:
+                    builtIns.insert(target);
+                    break;
+                case SpvDecorationPatch:
+                    patches.insert(target);
+                    break;
+                default:
+                    break;
+                }
+            }
+            break;
+        case SpvOpMemberDecorate:
+            if (wordCount >= 4 && words[pos + 3] == SpvDecorationBuiltIn)
+                structsWithBuiltIns.insert(words[pos + 1]);
+            break;
+        case SpvOpDecorationGroup:
+        case SpvOpGroupDecorate:
+        case SpvOpGroupMemberDecorate:
+        case SpvOpDecorateId:
+            // not generated by glslang, do not bother
+            return false;
+        default:
+            break;
+        }
+        pos += wordCount;
+    }
+
+    if (executionModel == SpvExecutionModelMax)
+        return false;
+
+    removed.fill(false, instructions.count());
+    useCount.fill(0, int(bound));
+    countUses();
+    return true;
+}
+
+QByteArray Module::serialize() const
+{
+    QVector<quint32> result;
+    result.reserve(words.count());
+    for (int i = 0; i < 5; ++i)
+        result.append(words[i]);
+
+    for (int i = 0; i < instructions.count(); ++i) {
+        if (removed[i])
+            continue;
+        const Instruction &instr(instructions[i]);
+        switch (instr.op) {
+        case SpvOpName:
+        case SpvOpDecorate:
+            if (removedIds.contains(word(i, 1)))
+                continue;
+            break;
+        case SpvOpEntryPoint:
+        {
+            // model, function id, name string, interface ids
+            int nameEnd = 3;
+            while (nameEnd < instr.wordCount) {
+                const quint32 w = word(i, nameEnd++);
+                if (!(w & 0xFF000000))
+                    break;
+            }
+            QVector<quint32> entryPoint;
+            for (int w = 1; w < nameEnd; ++w)
+                entryPoint.append(word(i, w));
+            for (int w = nameEnd; w < instr.wordCount; ++w) {
+                if (!removedIds.contains(word(i, w)))
+                    entryPoint.append(word(i, w));
+            }
+            result.append(quint32((entryPoint.count() + 1) << 16) | SpvOpEntryPoint);
+            result.append(entryPoint);
+        }
+            continue;
+        default:
+            break;
+        }
+        for (int w = 0; w < instr.wordCount; ++w)
+            result.append(word(i, w));
+    }
+
+    return QByteArray(reinterpret_cast<const char *>(result.constData()), result.count() * 4);
+}
+
+bool Module::isCountedUse(int instr, int idx) const
+{
+    switch (instructions[instr].op) {
+    case SpvOpName:
+    case SpvOpMemberName:
+    case SpvOpDecorate:
+    case SpvOpMemberDecorate:
+    case SpvOpEntryPoint:
+    case SpvOpExecutionMode:
+        return false;
+    default:
+        break;
+    }
+
+    bool hasResult = false;
+    bool hasResultType = false;
+    SpvHasResultAndType(instructions[instr].op, &hasResult, &hasResultType);
+    const int firstOperand = 1 + (hasResult ? 1 : 0) + (hasResultType ? 1 : 0);
+    if (idx < firstOperand)
+        return hasResultType && idx == 1; // the result type is a use as well
+
+    // Literals are not told apart from ids here. That may overcount uses of
+    // some ids, which is harmless since it only leads to keeping more code.
+    return word(instr, idx) < quint32(useCount.count());
+}
+
+void Module::countUses()
+{
+    for (int i = 0; i < instructions.count(); ++i) {
+        for (int w = 1; w < instructions[i].wordCount; ++w) {
+            if (isCountedUse(i, w))
+                ++useCount[int(word(i, w))];
+        }
+    }
+}
+
+void Module::removeInstruction(int instr)
+{
+    removed[instr] = true;
+    for (int w = 1; w < instructions[instr].wordCount; ++w) {
+        if (isCountedUse(instr, w))
+            --useCount[int(word(instr, w))];
+    }
+}
+
+int Module::locationSpan(quint32 typeId, bool arrayed) const
+{
+    const int def = defs.value(typeId, -1);
+    if (def < 0)
+        return -1;
+
+    switch (instructions[def].op) {
+    case SpvOpTypePointer:
+        return locationSpan(word(def, 3), arrayed);
+    case SpvOpTypeArray:
+    {
+        if (arrayed)
+            return locationSpan(word(def, 2), false);
+        const int lengthDef = defs.value(word(def, 3), -1);
+        if (lengthDef < 0 || instructions[lengthDef].op != SpvOpConstant)
+            return -1;
+        const int elemSpan = locationSpan(word(def, 2), false);
+        return elemSpan < 0 ? -1 : elemSpan * int(word(lengthDef, 3));
+    }
+    case SpvOpTypeMatrix:
+    {
+        const int colSpan = locationSpan(word(def, 2), false);
+        return colSpan < 0 ? -1 : colSpan * int(word(def, 3));
+    }
+    case SpvOpTypeVector:
+    {
+        const int compDef = defs.value(word(def, 2), -1);
+        const bool is64 = compDef >= 0 && instructions[compDef].wordCount > 2 && word(compDef, 2) == 64;
+        return is64 && word(def, 3) > 2 ? 2 : 1;
+    }
+    case SpvOpTypeFloat:
+    case SpvOpTypeInt:
+    case SpvOpTypeBool:
+        return 1;
+    default:
+        // structs and blocks are not handled
+        return -1;
+    }
+}
+
+// Removes an interface variable that is only ever written (directly or via
+// access chains), together with the writes.
+bool Module::removeVariable(quint32 varId)
+{
+    QSet<quint32> pointers;
+    pointers.insert(varId);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = firstFunction; i >= 0 && i < instructions.count(); ++i) {
+            const SpvOp op = instructions[i].op;
+            if ((op == SpvOpAccessChain || op == SpvOpInBoundsAccessChain)
+                    && pointers.contains(word(i, 3)) && !pointers.contains(word(i, 2)))
+            {
+                pointers.insert(word(i, 2));
+                changed = true;
+            }
+        }
+    }
+
+    QVector<int> toRemove;
+    for (int i = 0; i < instructions.count(); ++i) {
+        if (removed[i])
+            continue;
+        const SpvOp op = instructions[i].op;
+        bool referenced = false;
+        bool allowed = true;
+        for (int w = 1; w < instructions[i].wordCount; ++w) {
+            if (!isCountedUse(i, w) || !pointers.contains(word(i, w)))
+                continue;
+            referenced = true;
+            if (op == SpvOpStore && w == 1)
+                continue;
+            if ((op == SpvOpAccessChain || op == SpvOpInBoundsAccessChain) && w == 3)
+                continue;
+            allowed = false;
+        }
+        if (!allowed)
+            return false;
+        if (referenced)
+            toRemove.append(i);
+    }
+
+    for (int i : toRemove)
+        removeInstruction(i);
+    removeInstruction(defs.value(varId));
+    for (quint32 id : qAsConst(pointers))
+        removedIds.insert(id);
+
+    return true;
+}
+
+static bool isPure(SpvOp op, quint32 extInstSet, quint32 extInst)
+{
+    if (op >= SpvOpConvertFToU && op <= SpvOpBitcast)
+        return true;
+    if (op >= SpvOpSNegate && op <= SpvOpSMulExtended)
+        return true;
+    if (op >= SpvOpAny && op <= SpvOpFUnordGreaterThanEqual)
+        return true;
+    if (op >= SpvOpShiftRightLogical && op <= SpvOpBitCount)
+        return true;
+    if (op >= SpvOpDPdx && op <= SpvOpFwidthCoarse)
+        return true;
+    if (op >= SpvOpImageSampleImplicitLod && op <= SpvOpImageQuerySamples)
+        return op != SpvOpImageWrite;
+
+    switch (op) {
+    case SpvOpUndef:
+    case SpvOpLoad:
+    case SpvOpAccessChain:
+    case SpvOpInBoundsAccessChain:
+    case SpvOpVectorExtractDynamic:
+    case SpvOpVectorInsertDynamic:
+    case SpvOpVectorShuffle:
+    case SpvOpCompositeConstruct:
+    case SpvOpCompositeExtract:
+    case SpvOpCompositeInsert:
+    case SpvOpCopyObject:
+    case SpvOpTranspose:
+    case SpvOpSampledImage:
+    case SpvOpSelect:
+    case SpvOpPhi:
+        return true;
+    case SpvOpExtInst:
+        // GLSL.std.450 Modf and Frexp write through a pointer, the rest is pure
+        return extInstSet != 0 && extInst != 35 && extInst != 51;
+    default:
+        return false;
+    }
+}
+
+void Module::removeDeadCode()
+{
+    quint32 glslStd450 = 0;
+    for (int i = 0; i < instructions.count(); ++i) {
+        if (instructions[i].op == SpvOpExtInstImport) {
+            const char *name = reinterpret_cast<const char *>(&words[instructions[i].offset + 2]);
+            if (!qstrncmp(name, "GLSL.std.450", 12))
+                glslStd450 = word(i, 1);
+        }
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = instructions.count() - 1; i >= firstFunction && i >= 0; --i) {
+            if (removed[i])
+                continue;
+            bool hasResult = false;
+            bool hasResultType = false;
+            SpvHasResultAndType(instructions[i].op, &hasResult, &hasResultType);
+            if (!hasResult || !hasResultType)
+                continue;
+            const quint32 resultId = word(i, 2);
+            if (useCount[int(resultId)] > 0)
+                continue;
+            const bool extInst = instructions[i].op == SpvOpExtInst && instructions[i].wordCount > 4;
+            const quint32 set = extInst && word(i, 3) == glslStd450 ? glslStd450 : 0;
+            if (!isPure(instructions[i].op, set, extInst ? word(i, 4) : 0))
+                continue;
+            removeInstruction(i);
+            removedIds.insert(resultId);
+            changed = true;
+        }
+    }
+}
+
+static inline bool isArrayedInput(SpvExecutionModel model)
+{
+    return model == SpvExecutionModelTessellationControl
+            || model == SpvExecutionModelTessellationEvaluation
+            || model == SpvExecutionModelGeometry;
+}
+
+static inline bool isArrayedOutput(SpvExecutionModel model)
+{
+    return model == SpvExecutionModelTessellationControl;
+}
+
+static quint32 pointeeStructType(const Module &m, quint32 varId)
+{
+    int def = m.defs.value(m.word(m.defs.value(varId), 1), -1); // the pointer type
+    if (def >= 0)
+        def = m.defs.value(m.word(def, 3), -1);
+    while (def >= 0 && m.instructions[def].op == SpvOpTypeArray)
+        def = m.defs.value(m.word(def, 2), -1);
+    return def >= 0 && m.instructions[def].op == SpvOpTypeStruct ? m.word(def, 1) : 0;
+}
+
+/*
+    Returns \a spirv with the outputs that are not read by the next stage,
+    represented by \a nextStageSpirv, removed. Built-ins are never removed.
+ */
+QByteArray removeUnusedOutputs(const QByteArray &spirv, const QByteArray &nextStageSpirv)
+{
+    Module next;
+    if (!next.parse(nextStageSpirv))
+        return spirv;
+
+    QSet<quint32> readLocations;
+    for (auto it = next.interfaceVars.cbegin(), end = next.interfaceVars.cend(); it != end; ++it) {
+        if (it.value() != SpvStorageClassInput)
+            continue;
+        const quint32 var = it.key();
+        if (next.builtIns.contains(var) || next.structsWithBuiltIns.contains(pointeeStructType(next, var)))
+            continue;
+        if (next.useCount[int(var)] == 0)
+            continue;
+        if (!next.locations.contains(var))
+            return spirv;
+        const int span = next.locationSpan(next.word(next.defs.value(var), 1), isArrayedInput(next.executionModel));
+        if (span < 0)
+            return spirv;
+        const quint32 location = next.locations.value(var);
+        for (int i = 0; i < span; ++i)
+            readLocations.insert(location + quint32(i));
+    }
+
+    Module m;
+    if (!m.parse(spirv))
+        return spirv;
+
+    bool changed = false;
+    for (auto it = m.interfaceVars.cbegin(), end = m.interfaceVars.cend(); it != end; ++it) {
+        if (it.value() != SpvStorageClassOutput)
+            continue;
+        const quint32 var = it.key();
+        if (!m.locations.contains(var) || m.builtIns.contains(var) || m.patches.contains(var))
+            continue;
+        const int span = m.locationSpan(m.word(m.defs.value(var), 1), isArrayedOutput(m.executionModel));
+        if (span < 0)
+            continue;
+        const quint32 location = m.locations.value(var);
+        bool read = false;
+        for (int i = 0; i < span && !read; ++i)
+            read = readLocations.contains(location + quint32(i));
+        if (!read && m.removeVariable(var))
+            changed = true;
+    }
+
+    if (!changed)
+        return spirv;
+
+    m.removeDeadCode();
+    return m.serialize();
+}
+
+/*
+    Returns \a spirv with the inputs that are never read removed. Inputs of
+    the vertex stage are left alone since those are not varyings.
+ */
+QByteArray removeUnusedInputs(const QByteArray &spirv)
+{
+    Module m;
+    if (!m.parse(spirv) || m.executionModel == SpvExecutionModelVertex)
+        return spirv;
+
+    bool changed = false;
+    for (auto it = m.interfaceVars.cbegin(), end = m.interfaceVars.cend(); it != end; ++it) {
+        if (it.value() != SpvStorageClassInput)
+            continue;
+        const quint32 var = it.key();
+        if (!m.locations.contains(var) || m.builtIns.contains(var) || m.useCount[int(var)] > 0)
+            continue;
+        if (m.removeVariable(var))
+            changed = true;
+    }
+
+    return changed ? m.serialize() : spirv;
+}
+
+} // namespace
+
+QT_END_NAMESPACE
@@ -7,17 +7,35 @@ DEFINES += QT_BUILD_SHADERTOOLS_LIB
 HEADERS += \
     $$PWD/qtshadertoolsglobal.h \
     $$PWD/qshaderbaker.h \
+    $$PWD/qshaderbaker_p.h \
+    $$PWD/qshaderincluderesolver.h \
     $$PWD/qspirvshader_p.h \
     $$PWD/qspirvshaderremap_p.h \
+    $$PWD/qspirvshadercost_p.h \
+    $$PWD/qshaderpackwriter_p.h \
     $$PWD/qspirvcompiler_p.h \
-    $$PWD/qshaderbatchablerewriter_p.h
+    $$PWD/qshaderbatchablerewriter_p.h \
+    $$PWD/qspirvvaryingpruner_p.h \
+    $$PWD/qspirvcompact_p.h \
+    $$PWD/qspirvglslversions_p.h
 
 SOURCES += \
     $$PWD/qshaderbaker.cpp \
+    $$PWD/qshaderincluderesolver.cpp \
     $$PWD/qspirvshader.cpp \
     $$PWD/qspirvshaderremap.cpp \
+    $$PWD/qspirvshadercost.cpp \
+    $$PWD/qshaderpackwriter.cpp \
     $$PWD/qspirvcompiler.cpp \
-    $$PWD/qshaderbatchablerewriter.cpp
+    $$PWD/qshaderbatchablerewriter.cpp \
+    $$PWD/qspirvvaryingpruner.cpp \
+    $$PWD/qspirvcompact.cpp \
+    $$PWD/qspirvglslversions.cpp
+
+qtConfig(system-zlib): \
+    QMAKE_USE_PRIVATE += zlib
+else: \
+    QT_PRIVATE += zlib-private
 
 INCLUDEPATH += $$PWD/../3rdparty/SPIRV-Cross $$PWD/../3rdparty/glslang
 
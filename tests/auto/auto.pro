@@ -1,3 +1,7 @@
 TEMPLATE = subdirs
 SUBDIRS = \
-    qshaderbaker
+    qshaderbaker \
+    qshaderbakerconcurrency \
+    qshaderbatchablerewriter \
+    qsb \
+    qspirvallocations
@@ -0,0 +1,6 @@
+TARGET = tst_qsb
+CONFIG += testcase
+
+QT += testlib gui-private
+
+SOURCES += tst_qsb.cpp
@@ -0,0 +1,732 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#include <QtTest/QtTest>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QLibraryInfo>
+#include <QtCore/QProcess>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QTemporaryDir>
+#include <QtGui/private/qshader_p.h>
+
+#include <algorithm>
+
+static const char colorFrag[] =
+        "#version 440\n"
+        "\n"
+        "layout(location = 0) in vec3 v_color;\n"
+        "layout(location = 0) out vec4 fragColor;\n"
+        "\n"
+        "layout(std140, binding = 0) uniform buf {\n"
+        "    mat4 mvp;\n"
+        "    float opacity;\n"
+        "} ubuf;\n"
+        "\n"
+        "void main()\n"
+        "{\n"
+        "    fragColor = vec4(v_color * ubuf.opacity, ubuf.opacity);\n"
+        "}\n";
+
+class tst_Qsb : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void skipUnchanged();
+    void watch();
+    void identicalBytes();
+    void trailer();
+    void toolCommand();
+    void retarget();
+    void merge();
+    void strip_data();
+    void strip();
+    void split();
+    void compressionLevel();
+    void prune();
+    void budget_data();
+    void budget();
+    void dumpJson();
+
+private:
+    bool runQsb(const QStringList &arguments, QByteArray *errorOutput = nullptr, QByteArray *output = nullptr);
+    QString writeFile(const QString &name, const QByteArray &contents);
+    static QByteArray readFile(const QString &fileName);
+    static QShader readPack(const QString &fileName);
+
+    QString qsb;
+    QTemporaryDir dir;
+};
+
+void tst_Qsb::initTestCase()
+{
+    qsb = QLibraryInfo::location(QLibraryInfo::BinariesPath) + QLatin1String("/qsb");
+#ifdef Q_OS_WIN
+    qsb += QLatin1String(".exe");
+#endif
+    if (!QFileInfo::exists(qsb))
+        QSKIP("qsb not found");
+    QVERIFY(dir.isValid());
+}
+
+bool tst_Qsb::runQsb(const QStringList &arguments, QByteArray *errorOutput, QByteArray *output)
+{
+    QProcess p;
+    p.start(qsb, arguments);
+    if (!p.waitForFinished()) {
+        qWarning("qsb did not finish");
+        return false;
+    }
+    const QByteArray stderrData = p.readAllStandardError();
+    if (errorOutput)
+        *errorOutput = stderrData;
+    if (output)
+        *output = p.readAllStandardOutput();
+    if (p.exitStatus() != QProcess::NormalExit || p.exitCode() != 0) {
+        qWarning("qsb failed: %s", stderrData.constData());
+        return false;
+    }
+    return true;
+}
+
+QString tst_Qsb::writeFile(const QString &name, const QByteArray &contents)
+{
+    const QString fileName = dir.filePath(name);
+    QFile f(fileName);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return QString();
+    f.write(contents);
+    return fileName;
+}
+
+QByteArray tst_Qsb::readFile(const QString &fileName)
+{
+    QFile f(fileName);
+    return f.open(QIODevice::ReadOnly) ? f.readAll() : QByteArray();
+}
+
+QShader tst_Qsb::readPack(const QString &fileName)
+{
+    return QShader::fromSerialized(readFile(fileName));
+}
+
+// Sets the modification time to something in the past, so that any write
+// afterwards shows, regardless of the file system's timestamp resolution.
+static bool backdate(const QString &fileName)
+{
+    QFile f(fileName);
+    return f.open(QIODevice::ReadWrite)
+            && f.setFileTime(QDateTime(QDate(2000, 1, 1), QTime(0, 0), Qt::UTC), QFileDevice::FileModificationTime);
+}
+
+static QDateTime modified(const QString &fileName)
+{
+    return QFileInfo(fileName).fileTime(QFileDevice::FileModificationTime);
+}
+
+void tst_Qsb::skipUnchanged()
+{
+    const QString input = writeFile(QLatin1String("skip.frag"), colorFrag);
+    const QString output = dir.filePath(QLatin1String("skip.frag.qsb"));
+    const QStringList args = { QLatin1String("--glsl"), QLatin1String("100 es,120"), QLatin1String("-o"), output, input };
+
+    QVERIFY(runQsb(args));
+    const QShader baked = readPack(output);
+    QVERIFY(baked.isValid());
+    QCOMPARE(baked.availableShaders().count(), 3);
+
+    // unchanged input, the output is not touched at all
+    QVERIFY(backdate(output));
+    QByteArray bytes = readFile(output);
+    QVERIFY(runQsb(args));
+    QCOMPARE(readFile(output), bytes);
+    QCOMPARE(modified(output), QDateTime(QDate(2000, 1, 1), QTime(0, 0), Qt::UTC));
+
+    // The first change bakes, as the trailer has no source hash yet. That
+    // takes a preprocessing run of its own, so it is only added now.
+    writeFile(QLatin1String("skip.frag"), QByteArray("// a comment\n") + colorFrag);
+    QVERIFY(runQsb(args));
+    QCOMPARE(readPack(output), baked);
+
+    // Only a comment changed: the bake is skipped, only the trailer gets
+    // the new fingerprint, and the modification time is kept.
+    QVERIFY(backdate(output));
+    const QDateTime old = modified(output);
+    bytes = readFile(output);
+    writeFile(QLatin1String("skip.frag"), QByteArray("// another comment\n") + colorFrag);
+    QVERIFY(runQsb(args));
+    QCOMPARE(modified(output), old);
+    QCOMPARE(readPack(output), baked);
+    QVERIFY(readFile(output) != bytes);
+
+    // now the fingerprint alone tells that nothing changed
+    bytes = readFile(output);
+    QVERIFY(runQsb(args));
+    QCOMPARE(readFile(output), bytes);
+    QCOMPARE(modified(output), old);
+
+    // a real change gets baked
+    QByteArray changed = colorFrag;
+    changed.replace("ubuf.opacity, ubuf.opacity", "ubuf.opacity, 1.0");
+    writeFile(QLatin1String("skip.frag"), changed);
+    QVERIFY(runQsb(args));
+    QVERIFY(modified(output) != old);
+    const QShader rebaked = readPack(output);
+    QVERIFY(rebaked.isValid());
+    QVERIFY(rebaked != baked);
+}
+
+// A smoke test for -w: changing a file the input includes rebakes it.
+void tst_Qsb::watch()
+{
+    writeFile(QLatin1String("watch.glsl"), "const float scale = 0.5;\n");
+    const QString input = writeFile(QLatin1String("watch.frag"),
+                                    "#version 440\n"
+                                    "#extension GL_GOOGLE_include_directive : enable\n"
+                                    "\n"
+                                    "#include \"watch.glsl\"\n"
+                                    "\n"
+                                    "layout(location = 0) out vec4 fragColor;\n"
+                                    "\n"
+                                    "void main()\n"
+                                    "{\n"
+                                    "    fragColor = vec4(scale);\n"
+                                    "}\n");
+    const QString output = dir.filePath(QLatin1String("watch.qsb"));
+
+    QProcess p;
+    p.start(qsb, { QLatin1String("-w"), QLatin1String("-o"), output, input });
+    QVERIFY(p.waitForStarted());
+    QByteArray errorOutput;
+    QTRY_VERIFY_WITH_TIMEOUT((errorOutput += p.readAllStandardError()).contains("Watching for changes"), 30000);
+    const QByteArray baked = readFile(output);
+    QVERIFY(readPack(output).isValid());
+
+    writeFile(QLatin1String("watch.glsl"), "const float scale = 0.25;\n");
+    QTRY_VERIFY_WITH_TIMEOUT(readFile(output) != baked && readPack(output).isValid(), 30000);
+
+    p.kill();
+    p.waitForFinished();
+}
+
+void tst_Qsb::identicalBytes()
+{
+    const QString input = writeFile(QLatin1String("identical.frag"), colorFrag);
+    const QString output = dir.filePath(QLatin1String("identical.frag.qsb"));
+    const QStringList args = { QLatin1String("--glsl"), QLatin1String("100 es,120,150"),
+                               QLatin1String("--hlsl"), QLatin1String("50"),
+                               QLatin1String("--msl"), QLatin1String("12"),
+                               QLatin1String("-o"), output, input };
+
+    QVERIFY(runQsb(args));
+    const QByteArray bytes = readFile(output);
+    QVERIFY(!bytes.isEmpty());
+
+    // With --force the bake runs, and the result is the same, byte for
+    // byte, so the existing file is left alone.
+    QVERIFY(backdate(output));
+    const QDateTime old = modified(output);
+    QVERIFY(runQsb(QStringList(args) << QLatin1String("--force")));
+    QCOMPARE(readFile(output), bytes);
+    QCOMPARE(modified(output), old);
+
+    // baking into another file gives the same bytes, too
+    const QString otherOutput = dir.filePath(QLatin1String("identical2.frag.qsb"));
+    QStringList otherArgs = args;
+    otherArgs[otherArgs.indexOf(output)] = otherOutput;
+    QVERIFY(runQsb(otherArgs));
+    QCOMPARE(readPack(otherOutput), readPack(output));
+}
+
+static bool hasTrailer(const QByteArray &pack)
+{
+    return pack.endsWith("QSBT");
+}
+
+void tst_Qsb::trailer()
+{
+    const QString input = writeFile(QLatin1String("trailer.frag"), colorFrag);
+    const QString output = dir.filePath(QLatin1String("trailer.frag.qsb"));
+    QVERIFY(runQsb({ QLatin1String("--glsl"), QLatin1String("100 es,120"), QLatin1String("--hlsl"), QLatin1String("50"),
+                     QLatin1String("-o"), output, input }));
+    QVERIFY(hasTrailer(readFile(output)));
+    const QShader baked = readPack(output);
+    QVERIFY(baked.isValid());
+
+    // every mode writing packs adds the trailer
+    const QString stripped = dir.filePath(QLatin1String("stripped.qsb"));
+    QVERIFY(runQsb({ QLatin1String("--strip"), QLatin1String("hlsl"), QLatin1String("-o"), stripped, output }));
+    QVERIFY(hasTrailer(readFile(stripped)));
+    QCOMPARE(readPack(stripped).availableShaders().count(), 3);
+
+    const QString merged = dir.filePath(QLatin1String("merged.qsb"));
+    QVERIFY(runQsb({ QLatin1String("--merge"), QLatin1String("-o"), merged, stripped, output }));
+    QVERIFY(hasTrailer(readFile(merged)));
+    QCOMPARE(readPack(merged).availableShaders().count(), 4);
+
+    // A bake into a pack written by another mode is never skipped, the
+    // trailer does not tell what it was made from.
+    QVERIFY(backdate(stripped));
+    const QDateTime old = modified(stripped);
+    QVERIFY(runQsb({ QLatin1String("--glsl"), QLatin1String("100 es,120"), QLatin1String("-o"), stripped, input }));
+    QVERIFY(modified(stripped) != old);
+    QCOMPARE(readPack(stripped).availableShaders().count(), 3);
+}
+
+// A stand-in for fxc that copies its input, so the "DXBC" is the HLSL.
+void tst_Qsb::toolCommand()
+{
+#ifdef Q_OS_WIN
+    QSKIP("Needs cp");
+#else
+    const QString input = writeFile(QLatin1String("tool.frag"), colorFrag);
+    const QString hlslOutput = dir.filePath(QLatin1String("tool-hlsl.qsb"));
+    QVERIFY(runQsb({ QLatin1String("--hlsl"), QLatin1String("50,51"), QLatin1String("-o"), hlslOutput, input }));
+    const QShader hlsl = readPack(hlslOutput);
+    QVERIFY(hlsl.isValid());
+
+    const QString cacheDir = dir.filePath(QLatin1String("toolcache"));
+    const QStringList args = { QLatin1String("--glsl"), QLatin1String("100 es,120"),
+                               QLatin1String("--hlsl"), QLatin1String("50,51"),
+                               QLatin1String("--msl"), QLatin1String("12"),
+                               QLatin1String("--fxc"), QLatin1String("--fxc-command"), QLatin1String("cp {input} {output}"),
+                               QLatin1String("--tool-cache"), cacheDir, input };
+
+    // The tool runs in parallel, and the pack must not depend on the order
+    // the runs finish in.
+    const QString serialOutput = dir.filePath(QLatin1String("tool-serial.qsb"));
+    QVERIFY(runQsb(QStringList(args) << QLatin1String("-j") << QLatin1String("1") << QLatin1String("-o") << serialOutput));
+    const QString parallelOutput = dir.filePath(QLatin1String("tool-parallel.qsb"));
+    QVERIFY(runQsb(QStringList(args) << QLatin1String("-j") << QLatin1String("8") << QLatin1String("-o") << parallelOutput));
+    QCOMPARE(readFile(parallelOutput), readFile(serialOutput));
+
+    const QShader s = readPack(parallelOutput);
+    QVERIFY(s.isValid());
+    QCOMPARE(s.availableShaders().count(), 6);
+    for (int version : { 50, 51 }) {
+        QVERIFY(!s.availableShaders().contains(QShaderKey(QShader::HlslShader, QShaderVersion(version))));
+        const QShaderCode dxbc = s.shader(QShaderKey(QShader::DxbcShader, QShaderVersion(version)));
+        QCOMPARE(dxbc.shader(), hlsl.shader(QShaderKey(QShader::HlslShader, QShaderVersion(version))).shader());
+        QCOMPARE(dxbc.entryPoint(), QByteArrayLiteral("main"));
+    }
+
+    // One cache entry per tool run. Prove that the entries are used by
+    // changing them.
+    QDir cache(cacheDir);
+    const QStringList entries = cache.entryList(QDir::Files);
+    QCOMPARE(entries.count(), 2);
+    for (const QString &entry : entries) {
+        QFile f(cache.filePath(entry));
+        QVERIFY(f.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        f.write("cached");
+    }
+    QVERIFY(runQsb(QStringList(args) << QLatin1String("--force") << QLatin1String("-o") << parallelOutput));
+    const QShader cached = readPack(parallelOutput);
+    for (int version : { 50, 51 })
+        QCOMPARE(cached.shader(QShaderKey(QShader::DxbcShader, QShaderVersion(version))).shader(), QByteArrayLiteral("cached"));
+    QCOMPARE(cache.entryList(QDir::Files).count(), 2);
+#endif
+}
+
+static const char colorVert[] =
+        "#version 440\n"
+        "\n"
+        "layout(location = 0) in vec4 position;\n"
+        "layout(location = 1) in vec3 color;\n"
+        "layout(location = 0) out vec3 v_color;\n"
+        "\n"
+        "layout(std140, binding = 0) uniform buf {\n"
+        "    mat4 mvp;\n"
+        "    float opacity;\n"
+        "} ubuf;\n"
+        "\n"
+        "out gl_PerVertex { vec4 gl_Position; };\n"
+        "\n"
+        "void main()\n"
+        "{\n"
+        "    v_color = color;\n"
+        "    gl_Position = ubuf.mvp * position;\n"
+        "}\n";
+
+// Retargeting a pack that only has SPIR-V must give the same shaders as
+// baking all targets from the source.
+void tst_Qsb::retarget()
+{
+    const QString input = writeFile(QLatin1String("retarget.vert"), colorVert);
+    const QStringList targets = { QLatin1String("--glsl"), QLatin1String("100 es,120,150,330,440"),
+                                  QLatin1String("--hlsl"), QLatin1String("50"),
+                                  QLatin1String("--msl"), QLatin1String("12") };
+
+    const QString fullOutput = dir.filePath(QLatin1String("retarget-full.qsb"));
+    QVERIFY(runQsb(QStringList(targets) << QLatin1String("-b") << QLatin1String("-o") << fullOutput << input));
+    const QShader full = readPack(fullOutput);
+    QVERIFY(full.isValid());
+
+    const QString spirvOutput = dir.filePath(QLatin1String("retarget-spirv.qsb"));
+    QVERIFY(runQsb({ QLatin1String("-b"), QLatin1String("-o"), spirvOutput, input }));
+    QCOMPARE(readPack(spirvOutput).availableShaders().count(), 2);
+
+    const QString retargetedOutput = dir.filePath(QLatin1String("retarget-retargeted.qsb"));
+    QVERIFY(runQsb(QStringList(targets) << QLatin1String("--retarget") << QLatin1String("-o") << retargetedOutput
+                   << spirvOutput));
+    const QShader retargeted = readPack(retargetedOutput);
+    QVERIFY(retargeted.isValid());
+
+    QCOMPARE(retargeted.stage(), full.stage());
+    QCOMPARE(retargeted.description(), full.description());
+    QVector<QShaderKey> keys = full.availableShaders();
+    QVector<QShaderKey> retargetedKeys = retargeted.availableShaders();
+    std::sort(keys.begin(), keys.end());
+    std::sort(retargetedKeys.begin(), retargetedKeys.end());
+    QCOMPARE(retargetedKeys, keys);
+    QCOMPARE(keys.count(), 16);
+    for (const QShaderKey &key : qAsConst(keys)) {
+        QCOMPARE(retargeted.shader(key), full.shader(key));
+        const QShader::NativeResourceBindingMap *map = full.nativeResourceBindingMap(key);
+        const QShader::NativeResourceBindingMap *retargetedMap = retargeted.nativeResourceBindingMap(key);
+        QCOMPARE(bool(retargetedMap), bool(map));
+        if (map)
+            QCOMPARE(*retargetedMap, *map);
+    }
+}
+
+void tst_Qsb::merge()
+{
+    const QString input = writeFile(QLatin1String("merge.vert"), colorVert);
+    const QString glsl = dir.filePath(QLatin1String("merge-glsl.qsb"));
+    QVERIFY(runQsb({ QLatin1String("--glsl"), QLatin1String("100 es,120"), QLatin1String("-o"), glsl, input }));
+    const QString hlsl = dir.filePath(QLatin1String("merge-hlsl.qsb"));
+    QVERIFY(runQsb({ QLatin1String("-b"), QLatin1String("--hlsl"), QLatin1String("50"), QLatin1String("-o"), hlsl, input }));
+
+    // the batchable variant's extra input is not a mismatch
+    const QString merged = dir.filePath(QLatin1String("merged-all.qsb"));
+    QVERIFY(runQsb({ QLatin1String("--merge"), QLatin1String("-o"), merged, glsl, hlsl }));
+    const QShader s = readPack(merged);
+    QCOMPARE(s.availableShaders().count(), 6);
+    QCOMPARE(s.description(), readPack(hlsl).description());
+
+    // a different shader for the same stage is
+    QByteArray other = colorVert;
+    other.replace("float opacity;", "float opacity;\n    vec4 tint;");
+    const QString otherInput = writeFile(QLatin1String("merge-other.vert"), other);
+    const QString otherPack = dir.filePath(QLatin1String("merge-other.qsb"));
+    QVERIFY(runQsb({ QLatin1String("--hlsl"), QLatin1String("50"), QLatin1String("-o"), otherPack, otherInput }));
+    QByteArray errorOutput;
+    QVERIFY(!runQsb({ QLatin1String("--merge"), QLatin1String("-o"), dir.filePath(QLatin1String("merged-bad.qsb")),
+                      glsl, otherPack }, &errorOutput));
+    QVERIFY(errorOutput.contains("different reflection data"));
+    QVERIFY(!QFile::exists(dir.filePath(QLatin1String("merged-bad.qsb"))));
+}
+
+void tst_Qsb::strip_data()
+{
+    QTest::addColumn<QString>("spec");
+    QTest::addColumn<int>("remaining");
+
+    QTest::newRow("glsl.300 es") << QString::fromLatin1("glsl.300 es") << 4;
+    QTest::newRow("glsl.300es") << QString::fromLatin1("glsl.300es") << 4;
+    QTest::newRow("glsl.300") << QString::fromLatin1("glsl.300") << 5;
+    QTest::newRow("glsl") << QString::fromLatin1("glsl") << 2;
+    QTest::newRow("hlsl.50,spirv.100") << QString::fromLatin1("hlsl.50,spirv.100") << 3;
+}
+
+void tst_Qsb::strip()
+{
+    QFETCH(QString, spec);
+    QFETCH(int, remaining);
+
+    const QString input = writeFile(QLatin1String("strip.frag"), colorFrag);
+    const QString pack = dir.filePath(QLatin1String("strip.qsb"));
+    QVERIFY(runQsb({ QLatin1String("--glsl"), QLatin1String("100 es,300 es,120"), QLatin1String("--hlsl"), QLatin1String("50"),
+                     QLatin1String("-o"), pack, input }));
+    QCOMPARE(readPack(pack).availableShaders().count(), 5);
+
+    const QString stripped = dir.filePath(QLatin1String("strip-stripped.qsb"));
+    QVERIFY(runQsb({ QLatin1String("--strip"), spec, QLatin1String("-o"), stripped, pack }));
+    QCOMPARE(readPack(stripped).availableShaders().count(), remaining);
+}
+
+void tst_Qsb::split()
+{
+    const QString input = writeFile(QLatin1String("split.frag"), colorFrag);
+    const QString pack = dir.filePath(QLatin1String("split.qsb"));
+    QVERIFY(runQsb({ QLatin1String("--glsl"), QLatin1String("100 es,120"), QLatin1String("--hlsl"), QLatin1String("50"),
+                     QLatin1String("--msl"), QLatin1String("12"), QLatin1String("-o"), pack, input }));
+    const QShader full = readPack(pack);
+    QCOMPARE(full.availableShaders().count(), 5);
+
+    const QString outDir = dir.filePath(QLatin1String("split"));
+    QVERIFY(runQsb({ QLatin1String("--split"), QLatin1String("-o"), outDir, pack }));
+    QStringList platforms = QDir(outDir).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    platforms.sort();
+    QCOMPARE(platforms, QStringList({ QLatin1String("d3d"), QLatin1String("metal"),
+                                      QLatin1String("opengl"), QLatin1String("vulkan") }));
+
+    const QVector<QPair<QString, QVector<QShaderKey>>> expected = {
+        { QLatin1String("d3d"), { QShaderKey(QShader::HlslShader, QShaderVersion(50)) } },
+        { QLatin1String("metal"), { QShaderKey(QShader::MslShader, QShaderVersion(12)) } },
+        { QLatin1String("opengl"), { QShaderKey(QShader::GlslShader, QShaderVersion(100, QShaderVersion::GlslEs)),
+                                     QShaderKey(QShader::GlslShader, QShaderVersion(120)) } },
+        { QLatin1String("vulkan"), { QShaderKey(QShader::SpirvShader, QShaderVersion(100)) } }
+    };
+    for (const auto &platform : expected) {
+        const QString platformDir = outDir + QLatin1Char('/') + platform.first;
+        QCOMPARE(QDir(platformDir).entryList(QDir::Files), QStringList(QLatin1String("split.qsb")));
+        const QShader s = readPack(platformDir + QLatin1String("/split.qsb"));
+        QVERIFY(s.isValid());
+        QCOMPARE(s.stage(), full.stage());
+        QCOMPARE(s.description(), full.description());
+        QVector<QShaderKey> keys = s.availableShaders();
+        std::sort(keys.begin(), keys.end());
+        QVector<QShaderKey> expectedKeys = platform.second;
+        std::sort(expectedKeys.begin(), expectedKeys.end());
+        QCOMPARE(keys, expectedKeys);
+        for (const QShaderKey &key : qAsConst(keys))
+            QCOMPARE(s.shader(key), full.shader(key));
+    }
+}
+
+void tst_Qsb::prune()
+{
+    const QString input = writeFile(QLatin1String("prune.frag"), colorFrag);
+    const QString pack = dir.filePath(QLatin1String("prune.qsb"));
+    QVERIFY(runQsb({ QLatin1String("--glsl"), QLatin1String("100 es,120"), QLatin1String("--hlsl"), QLatin1String("50"),
+                     QLatin1String("-o"), pack, input }));
+    const QShader full = readPack(pack);
+    QCOMPARE(full.availableShaders().count(), 4);
+
+    // packs are matched by file name, whatever the path in the profile
+    const QString profile = writeFile(QLatin1String("prune-profile.txt"),
+                                      "# recorded at run time\n"
+                                      "assets/shaders/prune.qsb hlsl.50\n"
+                                      "\n"
+                                      "prune.qsb glsl.100es\n"
+                                      "prune.qsb hlsl.50\n");
+    const QString pruned = dir.filePath(QLatin1String("prune-pruned.qsb"));
+    const QString warmup = dir.filePath(QLatin1String("prune-warmup.txt"));
+    QVERIFY(runQsb({ QLatin1String("--prune-with"), profile, QLatin1String("--warmup-list"), warmup,
+                     QLatin1String("-o"), pruned, pack }));
+    const QShader s = readPack(pruned);
+    QVERIFY(s.isValid());
+    QCOMPARE(s.description(), full.description());
+    QVector<QShaderKey> keys = s.availableShaders();
+    std::sort(keys.begin(), keys.end());
+    QVector<QShaderKey> expectedKeys = {
+        QShaderKey(QShader::GlslShader, QShaderVersion(100, QShaderVersion::GlslEs)),
+        QShaderKey(QShader::HlslShader, QShaderVersion(50))
+    };
+    std::sort(expectedKeys.begin(), expectedKeys.end());
+    QCOMPARE(keys, expectedKeys);
+    for (const QShaderKey &key : qAsConst(keys))
+        QCOMPARE(s.shader(key), full.shader(key));
+    QCOMPARE(readFile(warmup), (pruned + QLatin1String(" hlsl.50\n") + pruned + QLatin1String(" glsl.100es\n")).toUtf8());
+
+    // a line that does not parse must not make its shader look unused
+    const QString badProfile = writeFile(QLatin1String("prune-bad.txt"),
+                                         "prune.qsb hlsl.50\n"
+                                         "prune.qsb glsl.100es standard\n");
+    const QString badOutput = dir.filePath(QLatin1String("prune-bad.qsb"));
+    QByteArray errorOutput;
+    QVERIFY(!runQsb({ QLatin1String("--prune-with"), badProfile, QLatin1String("-o"), badOutput, pack }, &errorOutput));
+    QVERIFY(errorOutput.contains("Invalid entry"));
+    QVERIFY(!QFile::exists(badOutput));
+}
+
+// The compression level only changes the size, not what loads from the pack.
+void tst_Qsb::compressionLevel()
+{
+    const QString input = writeFile(QLatin1String("compression.frag"), colorFrag);
+    const QStringList targets = { QLatin1String("--glsl"), QLatin1String("100 es,120"),
+                                  QLatin1String("--hlsl"), QLatin1String("50") };
+
+    const QString stored = dir.filePath(QLatin1String("compression-0.qsb"));
+    QVERIFY(runQsb(QStringList(targets) << QLatin1String("-z") << QLatin1String("0") << QLatin1String("-o") << stored << input));
+    const QString smallest = dir.filePath(QLatin1String("compression-9.qsb"));
+    QVERIFY(runQsb(QStringList(targets) << QLatin1String("-z") << QLatin1String("9") << QLatin1String("-o") << smallest << input));
+    QVERIFY(QFileInfo(stored).size() > QFileInfo(smallest).size());
+
+    const QShader s0 = readPack(stored);
+    const QShader s9 = readPack(smallest);
+    QVERIFY(s0.isValid());
+    QCOMPARE(s0.stage(), s9.stage());
+    QCOMPARE(s0.description(), s9.description());
+    QVector<QShaderKey> keys = s0.availableShaders();
+    QVector<QShaderKey> keys9 = s9.availableShaders();
+    std::sort(keys.begin(), keys.end());
+    std::sort(keys9.begin(), keys9.end());
+    QCOMPARE(keys9, keys);
+    QCOMPARE(keys.count(), 4);
+    for (const QShaderKey &key : qAsConst(keys))
+        QCOMPARE(s9.shader(key), s0.shader(key));
+
+    // out of range levels are reported and the default is used
+    for (const char *level : { "10", "-2", "fast" }) {
+        const QString output = dir.filePath(QLatin1String("compression-bad.qsb"));
+        QFile::remove(output);
+        QByteArray errorOutput;
+        QVERIFY(runQsb(QStringList(targets) << QLatin1String("-z") << QLatin1String(level) << QLatin1String("-o") << output << input,
+                       &errorOutput));
+        QVERIFY2(errorOutput.contains(QByteArray("Ignoring invalid compression level ") + level), errorOutput.constData());
+        QCOMPARE(readPack(output).availableShaders().count(), 4);
+    }
+}
+
+void tst_Qsb::budget_data()
+{
+    QTest::addColumn<QString>("budget");
+    QTest::addColumn<bool>("valid");
+    QTest::addColumn<bool>("withinBudget");
+
+    QTest::newRow("fragment") << QString::fromLatin1("fragment.texture=100") << true << true;
+    QTest::newRow("vertex") << QString::fromLatin1("vertex.live=1") << true << true;
+    QTest::newRow("any stage") << QString::fromLatin1("live=1000,samplers=16") << true << true;
+    QTest::newRow("tessellationcontrol") << QString::fromLatin1("tessellationcontrol.alu=1") << true << true;
+    QTest::newRow("over") << QString::fromLatin1("fragment.instructions=1") << true << false;
+    // %1 is the instruction count analyze mode reports for the shader
+    QTest::newRow("at the limit") << QString::fromLatin1("fragment.instructions=%1") << true << true;
+    // a stage analyze mode never reports would make the entry a no-op
+    QTest::newRow("Fragment") << QString::fromLatin1("Fragment.texture=100") << false << true;
+    QTest::newRow("frag") << QString::fromLatin1("frag.texture=100") << false << true;
+    QTest::newRow("pixel") << QString::fromLatin1("pixel.texture=100") << false << true;
+    QTest::newRow("two dots") << QString::fromLatin1("fragment.x.texture=100") << false << true;
+    QTest::newRow("metric") << QString::fromLatin1("fragment.textures=100") << false << true;
+}
+
+void tst_Qsb::budget()
+{
+    QFETCH(QString, budget);
+    QFETCH(bool, valid);
+    QFETCH(bool, withinBudget);
+
+    const QString input = writeFile(QLatin1String("budget.frag"), colorFrag);
+    const QString pack = dir.filePath(QLatin1String("budget.qsb"));
+    QVERIFY(runQsb({ QLatin1String("-o"), pack, input }));
+
+    if (budget.contains(QLatin1String("%1"))) {
+        QByteArray output;
+        QVERIFY(runQsb({ QLatin1String("--analyze"), pack }, nullptr, &output));
+        const QRegularExpressionMatch m = QRegularExpression(QLatin1String("instructions: (\\d+)"))
+                .match(QString::fromUtf8(output));
+        QVERIFY2(m.hasMatch(), output.constData());
+        budget = budget.arg(m.captured(1));
+    }
+
+    QByteArray errorOutput;
+    QCOMPARE(runQsb({ QLatin1String("--analyze"), QLatin1String("--budget"), budget, pack }, &errorOutput),
+             valid && withinBudget);
+    QCOMPARE(errorOutput.contains("Invalid budget entry"), !valid);
+    QCOMPARE(errorOutput.contains("over the budget of"), valid && !withinBudget);
+}
+
+// How --dump-json names the keys of a pack.
+static QString keyName(const QShaderKey &key)
+{
+    QString s;
+    switch (key.source()) {
+    case QShader::SpirvShader:
+        s = QLatin1String("spirv");
+        break;
+    case QShader::GlslShader:
+        s = QLatin1String("glsl");
+        break;
+    case QShader::HlslShader:
+        s = QLatin1String("hlsl");
+        break;
+    default:
+        s = QLatin1String("other");
+        break;
+    }
+    s += QLatin1Char('.') + QString::number(key.sourceVersion().version());
+    if (key.sourceVersion().flags().testFlag(QShaderVersion::GlslEs))
+        s += QLatin1String("es");
+    return s;
+}
+
+void tst_Qsb::dumpJson()
+{
+    const QString vert = writeFile(QLatin1String("dump.vert"), colorVert);
+    const QString frag = writeFile(QLatin1String("dump.frag"), colorFrag);
+    const QString glslPack = dir.filePath(QLatin1String("dump-glsl.qsb"));
+    QVERIFY(runQsb({ QLatin1String("--glsl"), QLatin1String("100 es,120"), QLatin1String("-o"), glslPack, frag }));
+    const QString hlslPack = dir.filePath(QLatin1String("dump-hlsl.qsb"));
+    QVERIFY(runQsb({ QLatin1String("-b"), QLatin1String("--hlsl"), QLatin1String("50"), QLatin1String("-o"), hlslPack, vert }));
+    const QString spirvPack = dir.filePath(QLatin1String("dump-spirv.qsb"));
+    QVERIFY(runQsb({ QLatin1String("-o"), spirvPack, frag }));
+
+    // not sorted by name, the output must still be in this order
+    const QStringList packs = { spirvPack, hlslPack, glslPack };
+    const QStringList stages = { QLatin1String("fragment"), QLatin1String("vertex"), QLatin1String("fragment") };
+    const QVector<QStringList> keys = {
+        { QLatin1String("spirv.100") },
+        { QLatin1String("hlsl.50"), QLatin1String("hlsl.50"), QLatin1String("spirv.100"), QLatin1String("spirv.100") },
+        { QLatin1String("glsl.100es"), QLatin1String("glsl.120"), QLatin1String("spirv.100") }
+    };
+
+    QByteArray output;
+    QVERIFY(runQsb(QStringList { QLatin1String("--dump-json"), QLatin1String("-j"), QLatin1String("2") } + packs,
+                   nullptr, &output));
+    const QList<QByteArray> lines = output.trimmed().split('\n');
+    QCOMPARE(lines.count(), packs.count());
+
+    for (int i = 0; i < packs.count(); ++i) {
+        QJsonParseError error;
+        const QJsonObject summary = QJsonDocument::fromJson(lines[i], &error).object();
+        QVERIFY2(error.error == QJsonParseError::NoError, qPrintable(error.errorString()));
+        QCOMPARE(summary.value(QLatin1String("file")).toString(), packs[i]);
+        QVERIFY(!summary.contains(QLatin1String("error")));
+        QCOMPARE(summary.value(QLatin1String("stage")).toString(), stages[i]);
+        QCOMPARE(summary.value(QLatin1String("size")).toInt(), int(QFileInfo(packs[i]).size()));
+
+        const QShader pack = readPack(packs[i]);
+        const QJsonArray shaders = summary.value(QLatin1String("shaders")).toArray();
+        QStringList shaderKeys;
+        for (const QJsonValue &value : shaders) {
+            const QJsonObject shader = value.toObject();
+            const QString name = shader.value(QLatin1String("key")).toString();
+            const QShader::Variant variant = shader.value(QLatin1String("batchable")).toBool()
+                    ? QShader::BatchableVertexShader : QShader::StandardShader;
+            shaderKeys.append(name);
+            bool found = false;
+            for (const QShaderKey &key : pack.availableShaders()) {
+                if (keyName(key) == name && key.sourceVariant() == variant) {
+                    QCOMPARE(shader.value(QLatin1String("size")).toInt(), pack.shader(key).shader().size());
+                    found = true;
+                }
+            }
+            QVERIFY2(found, qPrintable(name));
+        }
+        QCOMPARE(shaderKeys, keys[i]);
+    }
+}
+
+#include <tst_qsb.moc>
+QTEST_MAIN(tst_Qsb)
@@ -0,0 +1,22 @@
+#version 440
+
+layout(location = 0) in vec2 v_texcoord;
+layout(location = 1) in vec3 v_color;
+layout(location = 0) out vec4 fragColor;
+
+layout(std140, binding = 0) uniform buf {
+    mat4 mvp;
+    vec4 tint;
+} ubuf;
+
+layout(binding = 1) uniform sampler2D tex;
+
+void main()
+{
+    vec4 c = vec4(0.0);
+    for (int i = 0; i < 4; ++i)
+        c += texture(tex, v_texcoord + vec2(float(i) * 0.01));
+    if (c.a < 0.5)
+        c.rgb *= v_color;
+    fragColor = c * ubuf.tint;
+}
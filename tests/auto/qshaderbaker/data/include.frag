@@ -0,0 +1,12 @@
+#version 440
+#extension GL_GOOGLE_include_directive : enable
+
+#include "include/lighting.glsl"
+
+layout(location = 0) in vec3 v_normal;
+layout(location = 0) out vec4 fragColor;
+
+void main()
+{
+    fragColor = vec4(lighting(normalize(v_normal)), 1.0);
+}
@@ -0,0 +1,2 @@
+const vec3 LIGHT_DIR = vec3(0.0, 0.0, 1.0);
+const vec3 BASE_COLOR = vec3(1.0, 0.5, 0.25);
@@ -0,0 +1,6 @@
+#include "common.glsl"
+
+vec3 lighting(vec3 n)
+{
+    return BASE_COLOR * max(dot(n, LIGHT_DIR), 0.0);
+}
@@ -0,0 +1,11 @@
+#version 440
+
+layout(location = 0) in vec3 v_color;
+layout(location = 2) in float v_notread;
+
+layout(location = 0) out vec4 fragColor;
+
+void main()
+{
+    fragColor = vec4(v_color, 1.0);
+}
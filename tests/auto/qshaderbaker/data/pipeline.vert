@@ -0,0 +1,24 @@
+#version 440
+
+layout(location = 0) in vec4 position;
+layout(location = 1) in vec3 color;
+layout(location = 2) in vec3 normal;
+
+layout(location = 0) out vec3 v_color;
+layout(location = 1) out vec3 v_unused;
+layout(location = 2) out float v_notread;
+
+layout(std140, binding = 0) uniform buf {
+    mat4 mvp;
+    mat3 normalMatrix;
+} ubuf;
+
+out gl_PerVertex { vec4 gl_Position; };
+
+void main()
+{
+    v_color = color;
+    v_unused = normalize(ubuf.normalMatrix * normal);
+    v_notread = position.z * 0.5;
+    gl_Position = ubuf.mvp * position;
+}
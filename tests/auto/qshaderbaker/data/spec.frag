@@ -0,0 +1,18 @@
+#version 440
+
+layout(constant_id = 0) const bool useTint = false;
+layout(constant_id = 1) const int sampleCount = 4;
+layout(constant_id = 2) const float scale = 0.5;
+
+layout(location = 0) in vec3 v_color;
+layout(location = 0) out vec4 fragColor;
+
+void main()
+{
+    vec3 c = v_color * scale;
+    for (int i = 1; i < sampleCount; ++i)
+        c += v_color * 0.01;
+    if (useTint)
+        c *= vec3(1.0, 0.5, 0.5);
+    fragColor = vec4(c, 1.0);
+}
@@ -1,7 +1,7 @@
 TARGET = tst_qshaderbaker
 CONFIG += testcase
 
-QT += testlib shadertools gui-private
+QT += testlib shadertools shadertools-private gui-private
 
 SOURCES += tst_qshaderbaker.cpp
 
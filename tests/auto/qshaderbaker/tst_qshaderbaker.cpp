@@ -28,9 +28,17 @@
 
 #include <QtTest/QtTest>
 #include <QFile>
+#include <QTemporaryDir>
 #include <QtShaderTools/QShaderBaker>
+#include <QtShaderTools/QShaderIncludeBundle>
+#include <QtShaderTools/private/qspirvshader_p.h>
+#include <QtShaderTools/private/qspirvcompiler_p.h>
+#include <QtShaderTools/private/qshaderbaker_p.h>
+#include <QtShaderTools/private/qspirvcompact_p.h>
+#include <QtShaderTools/private/qshaderpackwriter_p.h>
 #include <QtGui/private/qshaderdescription_p.h>
 #include <QtGui/private/qshader_p.h>
+#include <QtCore/qendian.h>
 
 class tst_QShaderBaker : public QObject
 {
@@ -57,6 +65,31 @@ private slots:
     void reflectArrayOfStructInBlock();
     void reflectCombinedImageSampler();
     void mslNativeBindingMap();
+    void manyVersions();
+    void glslVersionClasses_data();
+    void glslVersionClasses();
+    void glslMiddleVersions();
+    void glslTranslationCount_data();
+    void glslTranslationCount();
+    void translateFromSpirv();
+    void translateFromSpirvFile();
+    void invalidSpirv();
+    void bakePipeline();
+    void bakePipelineInvalidOrder();
+    void reflectSpecializationConstants();
+    void specializationConstants();
+    void bakeToSink();
+    void compactSpirv();
+    void compilerMemoryLimit();
+    void spirvSharing();
+    void includeBundle();
+    void includeGuards_data();
+    void includeGuards();
+    void referencedPreambleMacros();
+    void normalizedSourceHash();
+    void costInfo();
+    void byteSwappedSpirv();
+    void streamedPack();
 };
 
 void tst_QShaderBaker::initTestCase()
@@ -674,5 +707,1025 @@ void tst_QShaderBaker::mslNativeBindingMap()
     QCOMPARE(nativeBindingPair.second, 1); // sampler
 }
 
+void tst_QShaderBaker::manyVersions()
+{
+    const QVector<QShaderBaker::GeneratedShader> targets = {
+        { QShader::SpirvShader, QShaderVersion(100) },
+        { QShader::GlslShader, QShaderVersion(100, QShaderVersion::GlslEs) },
+        { QShader::GlslShader, QShaderVersion(300, QShaderVersion::GlslEs) },
+        { QShader::GlslShader, QShaderVersion(120) },
+        { QShader::GlslShader, QShaderVersion(150) },
+        { QShader::HlslShader, QShaderVersion(50) },
+        { QShader::HlslShader, QShaderVersion(51) },
+        { QShader::MslShader, QShaderVersion(12) },
+        { QShader::MslShader, QShaderVersion(20) },
+        { QShader::MslShader, QShaderVersion(21) }
+    };
+
+    QShaderBaker baker;
+    baker.setSourceFileName(QLatin1String(":/data/sgtexture.frag"));
+    baker.setGeneratedShaderVariants({ QShader::StandardShader });
+    baker.setGeneratedShaders(targets);
+    const QShader s = baker.bake();
+    QVERIFY(s.isValid());
+
+    // Each translation must give the same result as translating on its own,
+    // with nothing carried over from the previous one.
+    QSpirvShader spirvShader;
+    spirvShader.setSpirvBinary(s.shader(QShaderKey(QShader::SpirvShader, QShaderVersion(100))).shader());
+    for (const QShaderBaker::GeneratedShader &target : targets) {
+        const QShaderKey key(target.first, target.second);
+        QSpirvShader freshSpirvShader;
+        freshSpirvShader.setSpirvBinary(spirvShader.spirvBinary());
+        QByteArray expected;
+        switch (target.first) {
+        case QShader::GlslShader:
+            expected = freshSpirvShader.translateToGLSL(target.second.version(),
+                                                        target.second.flags().testFlag(QShaderVersion::GlslEs)
+                                                        ? QSpirvShader::GlslEs : QSpirvShader::GlslFlags());
+            break;
+        case QShader::HlslShader:
+            expected = freshSpirvShader.translateToHLSL(target.second.version());
+            break;
+        case QShader::MslShader:
+            expected = freshSpirvShader.translateToMSL(target.second.version());
+            break;
+        default:
+            continue;
+        }
+        QVERIFY(!expected.isEmpty());
+        QCOMPARE(s.shader(key).shader(), expected);
+    }
+
+    // The native binding maps are the same for all MSL versions, and are
+    // stored only once.
+    const QShader::NativeResourceBindingMap *msl12 = s.nativeResourceBindingMap(QShaderKey(QShader::MslShader, QShaderVersion(12)));
+    const QShader::NativeResourceBindingMap *msl20 = s.nativeResourceBindingMap(QShaderKey(QShader::MslShader, QShaderVersion(20)));
+    const QShader::NativeResourceBindingMap *msl21 = s.nativeResourceBindingMap(QShaderKey(QShader::MslShader, QShaderVersion(21)));
+    QVERIFY(msl12 && msl20 && msl21);
+    QCOMPARE(msl12->count(), 3);
+    QCOMPARE(*msl20, *msl12);
+    QCOMPARE(*msl21, *msl12);
+    QVERIFY(msl20->isSharedWith(*msl12));
+    QVERIFY(msl21->isSharedWith(*msl12));
+}
+
+void tst_QShaderBaker::glslVersionClasses_data()
+{
+    QTest::addColumn<QString>("fileName");
+    QTest::newRow("color.vert") << QString::fromLatin1(":/data/color.vert");
+    QTest::newRow("color.frag") << QString::fromLatin1(":/data/color.frag");
+    QTest::newRow("sgtexture.frag") << QString::fromLatin1(":/data/sgtexture.frag");
+    QTest::newRow("array_of_struct_in_ubuf.frag") << QString::fromLatin1(":/data/array_of_struct_in_ubuf.frag");
+}
+
+// The GLSL versions are translated in groups, the results must still be the
+// same as translating each version separately.
+void tst_QShaderBaker::glslVersionClasses()
+{
+    QFETCH(QString, fileName);
+
+    const int desktopVersions[] = { 450, 120, 130, 140, 150, 330, 400, 410, 420, 430, 440, 460, 120 };
+    const int esVersions[] = { 100, 300, 310, 320 };
+    QVector<QShaderBaker::GeneratedShader> targets;
+    targets.append({ QShader::SpirvShader, QShaderVersion(100) });
+    for (int v : desktopVersions)
+        targets.append({ QShader::GlslShader, QShaderVersion(v) });
+    for (int v : esVersions)
+        targets.append({ QShader::GlslShader, QShaderVersion(v, QShaderVersion::GlslEs) });
+
+    QShaderBaker baker;
+    baker.setSourceFileName(fileName);
+    baker.setGeneratedShaderVariants({ QShader::StandardShader, QShader::BatchableVertexShader });
+    baker.setGeneratedShaders(targets);
+    const QShader s = baker.bake();
+    QVERIFY2(s.isValid(), qPrintable(baker.errorMessage()));
+
+    const QVector<QShader::Variant> variants = s.stage() == QShader::VertexStage
+            ? QVector<QShader::Variant> { QShader::StandardShader, QShader::BatchableVertexShader }
+            : QVector<QShader::Variant> { QShader::StandardShader };
+    for (QShader::Variant variant : variants) {
+        QSpirvShader spirvShader;
+        spirvShader.setSpirvBinary(s.shader(QShaderKey(QShader::SpirvShader, QShaderVersion(100), variant)).shader());
+        for (const QShaderBaker::GeneratedShader &target : targets) {
+            if (target.first != QShader::GlslShader)
+                continue;
+            const bool es = target.second.flags().testFlag(QShaderVersion::GlslEs);
+            const QByteArray expected = spirvShader.translateToGLSL(target.second.version(),
+                                                                    es ? QSpirvShader::GlslEs : QSpirvShader::GlslFlags());
+            QVERIFY(!expected.isEmpty());
+            QCOMPARE(s.shader(QShaderKey(target.first, target.second, variant)).shader(), expected);
+        }
+    }
+}
+
+static QByteArray withVersionLine(const QByteArray &code, const QByteArray &versionLine)
+{
+    const int lineEnd = code.indexOf('\n');
+    return lineEnd < 0 ? QByteArray() : versionLine + code.mid(lineEnd);
+}
+
+// A version in the middle of a range whose ends are both requested must not
+// get the code of one of the ends with only the #version directive changed
+// when SPIRV-Cross emits something else for it.
+void tst_QShaderBaker::glslMiddleVersions()
+{
+    QShaderBaker baker;
+    baker.setSourceFileName(QLatin1String(":/data/color.vert"));
+    baker.setGeneratedShaderVariants({ QShader::StandardShader });
+    baker.setGeneratedShaders({
+        { QShader::SpirvShader, QShaderVersion(100) },
+        { QShader::GlslShader, QShaderVersion(120) },
+        { QShader::GlslShader, QShaderVersion(130) },
+        { QShader::GlslShader, QShaderVersion(330) },
+        { QShader::GlslShader, QShaderVersion(440) },
+        { QShader::GlslShader, QShaderVersion(100, QShaderVersion::GlslEs) },
+        { QShader::GlslShader, QShaderVersion(300, QShaderVersion::GlslEs) },
+        { QShader::GlslShader, QShaderVersion(320, QShaderVersion::GlslEs) }
+    });
+    const QShader s = baker.bake();
+    QVERIFY2(s.isValid(), qPrintable(baker.errorMessage()));
+
+    const QByteArray v120 = s.shader(QShaderKey(QShader::GlslShader, QShaderVersion(120))).shader();
+    const QByteArray v130 = s.shader(QShaderKey(QShader::GlslShader, QShaderVersion(130))).shader();
+    const QByteArray v330 = s.shader(QShaderKey(QShader::GlslShader, QShaderVersion(330))).shader();
+    const QByteArray v440 = s.shader(QShaderKey(QShader::GlslShader, QShaderVersion(440))).shader();
+    QVERIFY(v130.startsWith("#version 130\n"));
+    QVERIFY(v330.startsWith("#version 330\n"));
+
+    // 130 has in/out instead of attribute/varying, 330 has explicit input
+    // locations, 440 has explicit bindings.
+    QVERIFY(v130 != withVersionLine(v120, "#version 130"));
+    QVERIFY(v130.contains("\nin "));
+    QVERIFY(!v130.contains("attribute "));
+    QVERIFY(v330 != withVersionLine(v130, "#version 330"));
+    QVERIFY(v330 != withVersionLine(v440, "#version 330"));
+    QVERIFY(v330.contains("layout(location = 0) in "));
+
+    QSpirvShader spirvShader;
+    spirvShader.setSpirvBinary(s.shader(QShaderKey(QShader::SpirvShader, QShaderVersion(100))).shader());
+    QCOMPARE(v130, spirvShader.translateToGLSL(130));
+    QCOMPARE(v330, spirvShader.translateToGLSL(330));
+
+    const QByteArray es100 = s.shader(QShaderKey(QShader::GlslShader, QShaderVersion(100, QShaderVersion::GlslEs))).shader();
+    const QByteArray es300 = s.shader(QShaderKey(QShader::GlslShader, QShaderVersion(300, QShaderVersion::GlslEs))).shader();
+    QVERIFY(es300.startsWith("#version 300 es\n"));
+    QVERIFY(es300 != withVersionLine(es100, "#version 300 es"));
+    QCOMPARE(es300, spirvShader.translateToGLSL(300, QSpirvShader::GlslEs));
+}
+
+void tst_QShaderBaker::glslTranslationCount_data()
+{
+    QTest::addColumn<QString>("fileName");
+    QTest::addColumn<int>("expectedCount");
+
+    // 130-150, 330-400, 410-460, ES 300, ES 310-320
+    QTest::newRow("color.vert") << QString::fromLatin1(":/data/color.vert") << 5;
+    QTest::newRow("color.frag") << QString::fromLatin1(":/data/color.frag") << 5;
+    // samplers get a binding from 420 on
+    QTest::newRow("sgtexture.frag") << QString::fromLatin1(":/data/sgtexture.frag") << 6;
+}
+
+// SPIRV-Cross only runs once for the versions it generates the same code for.
+void tst_QShaderBaker::glslTranslationCount()
+{
+    QFETCH(QString, fileName);
+    QFETCH(int, expectedCount);
+
+    const int desktopVersions[] = { 130, 140, 150, 330, 400, 410, 420, 430, 440, 450, 460 };
+    const int esVersions[] = { 300, 310, 320 };
+    QVector<QShaderBaker::GeneratedShader> targets;
+    for (int v : desktopVersions)
+        targets.append({ QShader::GlslShader, QShaderVersion(v) });
+    for (int v : esVersions)
+        targets.append({ QShader::GlslShader, QShaderVersion(v, QShaderVersion::GlslEs) });
+
+    QShaderBaker baker;
+    baker.setSourceFileName(fileName);
+    baker.setGeneratedShaderVariants({ QShader::StandardShader });
+    baker.setGeneratedShaders(targets);
+    const QShader s = baker.bake();
+    QVERIFY2(s.isValid(), qPrintable(baker.errorMessage()));
+    QCOMPARE(QShaderBakerPrivate::get(&baker)->glslTranslationCount, expectedCount);
+
+    for (const QShaderBaker::GeneratedShader &target : targets) {
+        const QByteArray code = s.shader(QShaderKey(target.first, target.second)).shader();
+        QByteArray directive = QByteArrayLiteral("#version ") + QByteArray::number(target.second.version());
+        if (target.second.flags().testFlag(QShaderVersion::GlslEs))
+            directive += QByteArrayLiteral(" es");
+        QVERIFY(code.startsWith(directive + '\n'));
+    }
+}
+
+void tst_QShaderBaker::translateFromSpirv()
+{
+    QShaderBaker glslBaker;
+    glslBaker.setSourceFileName(QLatin1String(":/data/color.vert"));
+    glslBaker.setGeneratedShaderVariants({ QShader::StandardShader });
+    glslBaker.setGeneratedShaders({ { QShader::SpirvShader, QShaderVersion(100) } });
+    QShader glslResult = glslBaker.bake();
+    QVERIFY(glslResult.isValid());
+    const QByteArray spirv = glslResult.shader(QShaderKey(QShader::SpirvShader, QShaderVersion(100))).shader();
+    QVERIFY(!spirv.isEmpty());
+
+    QShaderBaker baker;
+    baker.setSourceSpirv(spirv, QShader::VertexStage);
+    baker.setGeneratedShaderVariants({ QShader::StandardShader, QShader::BatchableVertexShader });
+    QVector<QShaderBaker::GeneratedShader> targets;
+    targets.append({ QShader::SpirvShader, QShaderVersion(100) });
+    targets.append({ QShader::GlslShader, QShaderVersion(100, QShaderVersion::GlslEs) });
+    targets.append({ QShader::GlslShader, QShaderVersion(120) });
+    targets.append({ QShader::HlslShader, QShaderVersion(50) });
+    targets.append({ QShader::MslShader, QShaderVersion(12) });
+    baker.setGeneratedShaders(targets);
+    QShader s = baker.bake();
+    QVERIFY(s.isValid());
+    QVERIFY(baker.errorMessage().isEmpty());
+
+    // the batchable variant cannot be generated from SPIR-V
+    QCOMPARE(s.availableShaders().count(), 5);
+    QCOMPARE(s.stage(), QShader::VertexStage);
+    QCOMPARE(s.shader(QShaderKey(QShader::SpirvShader, QShaderVersion(100))).shader(), spirv);
+    QCOMPARE(s.description(), glslResult.description());
+    QVERIFY(s.nativeResourceBindingMap(QShaderKey(QShader::MslShader, QShaderVersion(12))));
+}
+
+void tst_QShaderBaker::translateFromSpirvFile()
+{
+    QShaderBaker glslBaker;
+    glslBaker.setSourceFileName(QLatin1String(":/data/color.frag"));
+    glslBaker.setGeneratedShaderVariants({ QShader::StandardShader });
+    glslBaker.setGeneratedShaders({ { QShader::SpirvShader, QShaderVersion(100) } });
+    QShader glslResult = glslBaker.bake();
+    QVERIFY(glslResult.isValid());
+
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString fn = tempDir.filePath(QLatin1String("color.frag.spv"));
+    QFile f(fn);
+    QVERIFY(f.open(QIODevice::WriteOnly));
+    f.write(glslResult.shader(QShaderKey(QShader::SpirvShader, QShaderVersion(100))).shader());
+    f.close();
+
+    QShaderBaker baker;
+    baker.setSourceFileName(fn);
+    baker.setGeneratedShaderVariants({ QShader::StandardShader });
+    baker.setGeneratedShaders({ { QShader::GlslShader, QShaderVersion(330) } });
+    QShader s = baker.bake();
+    QVERIFY(s.isValid());
+    QVERIFY(baker.errorMessage().isEmpty());
+    QCOMPARE(s.stage(), QShader::FragmentStage);
+    QVERIFY(s.shader(QShaderKey(QShader::GlslShader, QShaderVersion(330))).shader().contains(QByteArrayLiteral("#version 330")));
+}
+
+void tst_QShaderBaker::invalidSpirv()
+{
+    QShaderBaker baker;
+    baker.setSourceSpirv(QByteArrayLiteral("#version 440\nvoid main() { }\n"), QShader::VertexStage);
+    baker.setGeneratedShaderVariants({ QShader::StandardShader });
+    baker.setGeneratedShaders({ { QShader::GlslShader, QShaderVersion(330) } });
+    QShader s = baker.bake();
+    QVERIFY(!s.isValid());
+    QVERIFY(!baker.errorMessage().isEmpty());
+    qDebug() << baker.errorMessage();
+}
+
+void tst_QShaderBaker::bakePipeline()
+{
+    QShaderBaker baker;
+    baker.setGeneratedShaderVariants({ QShader::StandardShader, QShader::BatchableVertexShader });
+    QVector<QShaderBaker::GeneratedShader> targets;
+    targets.append({ QShader::SpirvShader, QShaderVersion(100) });
+    targets.append({ QShader::GlslShader, QShaderVersion(120) });
+    targets.append({ QShader::HlslShader, QShaderVersion(50) });
+    baker.setGeneratedShaders(targets);
+    const QVector<QShader> shaders = baker.bakePipeline({ QLatin1String(":/data/pipeline.vert"),
+                                                          QLatin1String(":/data/pipeline.frag") });
+    QVERIFY(baker.errorMessage().isEmpty());
+    QCOMPARE(shaders.count(), 2);
+    QVERIFY(shaders[0].isValid());
+    QVERIFY(shaders[1].isValid());
+    QCOMPARE(shaders[0].stage(), QShader::VertexStage);
+    QCOMPARE(shaders[1].stage(), QShader::FragmentStage);
+
+    // v_unused is not declared by the fragment shader, v_notread is declared
+    // but never read, so only v_color survives.
+    const QShaderDescription vsDesc = shaders[0].description();
+    QCOMPARE(vsDesc.outputVariables().count(), 1);
+    QCOMPARE(vsDesc.outputVariables().first().name, QByteArrayLiteral("v_color"));
+    QCOMPARE(vsDesc.inputVariables().count(), 3);
+    QCOMPARE(shaders[1].description().inputVariables().count(), 1);
+
+    for (QShader::Variant v : { QShader::StandardShader, QShader::BatchableVertexShader }) {
+        const QByteArray glsl = shaders[0].shader(QShaderKey(QShader::GlslShader, QShaderVersion(120), v)).shader();
+        QVERIFY(glsl.contains(QByteArrayLiteral("v_color")));
+        QVERIFY(!glsl.contains(QByteArrayLiteral("v_unused")));
+        QVERIFY(!glsl.contains(QByteArrayLiteral("v_notread")));
+        QVERIFY(!glsl.contains(QByteArrayLiteral("normalize")));
+    }
+    const QByteArray fsGlsl = shaders[1].shader(QShaderKey(QShader::GlslShader, QShaderVersion(120))).shader();
+    QVERIFY(!fsGlsl.contains(QByteArrayLiteral("v_notread")));
+
+    // The stages on their own keep everything.
+    baker.setSourceFileName(QLatin1String(":/data/pipeline.vert"));
+    QShader s = baker.bake();
+    QVERIFY(s.isValid());
+    QCOMPARE(s.description().outputVariables().count(), 3);
+}
+
+void tst_QShaderBaker::bakePipelineInvalidOrder()
+{
+    QShaderBaker baker;
+    baker.setGeneratedShaderVariants({ QShader::StandardShader });
+    baker.setGeneratedShaders({ { QShader::SpirvShader, QShaderVersion(100) } });
+    const QVector<QShader> shaders = baker.bakePipeline({ QLatin1String(":/data/pipeline.frag"),
+                                                          QLatin1String(":/data/pipeline.vert") });
+    QVERIFY(shaders.isEmpty());
+    QVERIFY(!baker.errorMessage().isEmpty());
+
+    QTest::ignoreMessage(QtWarningMsg, "QShaderBaker: Failed to open :/data/nonexistent.frag");
+    const QVector<QShader> missing = baker.bakePipeline({ QLatin1String(":/data/pipeline.vert"),
+                                                          QLatin1String(":/data/nonexistent.frag") });
+    QVERIFY(missing.isEmpty());
+    QVERIFY(baker.errorMessage().contains(QLatin1String("nonexistent.frag")));
+}
+
+void tst_QShaderBaker::reflectSpecializationConstants()
+{
+    QShaderBaker baker;
+    baker.setSourceFileName(QLatin1String(":/data/spec.frag"));
+    baker.setGeneratedShaderVariants({ QShader::StandardShader });
+    baker.setGeneratedShaders({ { QShader::SpirvShader, QShaderVersion(100) } });
+    QShader s = baker.bake();
+    QVERIFY(s.isValid());
+
+    QSpirvShader spirvShader;
+    spirvShader.setSpirvBinary(s.shader(QShaderKey(QShader::SpirvShader, QShaderVersion(100))).shader());
+    const QVector<QSpirvShader::SpecializationConstant> constants = spirvShader.specializationConstants();
+    QCOMPARE(constants.count(), 3);
+
+    QCOMPARE(constants[0].constantId, 0);
+    QCOMPARE(constants[0].name, QByteArrayLiteral("useTint"));
+    QCOMPARE(constants[0].type, QSpirvShader::SpecializationConstant::Bool);
+    QCOMPARE(constants[0].defaultValue.toBool(), false);
+
+    QCOMPARE(constants[1].constantId, 1);
+    QCOMPARE(constants[1].name, QByteArrayLiteral("sampleCount"));
+    QCOMPARE(constants[1].type, QSpirvShader::SpecializationConstant::Int);
+    QCOMPARE(constants[1].defaultValue.toInt(), 4);
+
+    QCOMPARE(constants[2].constantId, 2);
+    QCOMPARE(constants[2].name, QByteArrayLiteral("scale"));
+    QCOMPARE(constants[2].type, QSpirvShader::SpecializationConstant::Float);
+    QCOMPARE(constants[2].defaultValue.toFloat(), 0.5f);
+}
+
+void tst_QShaderBaker::specializationConstants()
+{
+    QShaderBaker glslBaker;
+    glslBaker.setSourceFileName(QLatin1String(":/data/spec.frag"));
+    glslBaker.setGeneratedShaderVariants({ QShader::StandardShader });
+    glslBaker.setGeneratedShaders({ { QShader::SpirvShader, QShaderVersion(100) } });
+    QShader glslResult = glslBaker.bake();
+    QVERIFY(glslResult.isValid());
+    const QByteArray spirv = glslResult.shader(QShaderKey(QShader::SpirvShader, QShaderVersion(100))).shader();
+
+    const QShaderKey glslKey(QShader::GlslShader, QShaderVersion(330));
+    QShaderBaker baker;
+    baker.setGeneratedShaderVariants({ QShader::StandardShader });
+    baker.setGeneratedShaders({ { QShader::SpirvShader, QShaderVersion(100) },
+                                { QShader::GlslShader, QShaderVersion(330) } });
+
+    // unspecialized, SPIRV-Cross leaves all constants overridable
+    baker.setSourceSpirv(spirv, QShader::FragmentStage);
+    QShader s = baker.bake();
+    QVERIFY(s.isValid());
+    QByteArray glsl = s.shader(glslKey).shader();
+    QVERIFY(glsl.contains(QByteArrayLiteral("SPIRV_CROSS_CONSTANT_ID_0")));
+    QVERIFY(glsl.contains(QByteArrayLiteral("SPIRV_CROSS_CONSTANT_ID_2")));
+
+    // the same SPIR-V, specialized twice without recompiling
+    for (float scale : { 0.25f, 2.0f }) {
+        baker.setSpecializationConstants({ { 1, 8 }, { 2, scale } });
+        s = baker.bake();
+        QVERIFY2(s.isValid(), qPrintable(baker.errorMessage()));
+        glsl = s.shader(glslKey).shader();
+        QVERIFY(glsl.contains(QByteArrayLiteral("SPIRV_CROSS_CONSTANT_ID_0")));
+        QVERIFY(!glsl.contains(QByteArrayLiteral("SPIRV_CROSS_CONSTANT_ID_1")));
+        QVERIFY(!glsl.contains(QByteArrayLiteral("SPIRV_CROSS_CONSTANT_ID_2")));
+        QVERIFY(glsl.contains(QByteArray::number(scale)));
+
+        QSpirvShader specialized;
+        specialized.setSpirvBinary(s.shader(QShaderKey(QShader::SpirvShader, QShaderVersion(100))).shader());
+        QCOMPARE(specialized.specializationConstants().count(), 1);
+        QCOMPARE(specialized.specializationConstants().first().constantId, 0);
+    }
+
+    // from source works as well
+    baker.setSourceFileName(QLatin1String(":/data/spec.frag"));
+    baker.setSpecializationConstants({ { 0, true } });
+    s = baker.bake();
+    QVERIFY(s.isValid());
+    QVERIFY(!s.shader(glslKey).shader().contains(QByteArrayLiteral("SPIRV_CROSS_CONSTANT_ID_0")));
+
+    baker.setSpecializationConstants({ { 5, 1 } });
+    s = baker.bake();
+    QVERIFY(!s.isValid());
+    QVERIFY(!baker.errorMessage().isEmpty());
+
+    // values must fit the type of the constant
+    for (const QVariant &v : { QVariant(QLatin1String("foo")), QVariant(2) }) {
+        baker.setSpecializationConstants({ { 0, v } });
+        s = baker.bake();
+        QVERIFY(!s.isValid());
+        QVERIFY(!baker.errorMessage().isEmpty());
+    }
+    baker.setSpecializationConstants({ { 1, QLatin1String("eight") } });
+    QVERIFY(!baker.bake().isValid());
+    baker.setSpecializationConstants({ { 2, QLatin1String("half") } });
+    QVERIFY(!baker.bake().isValid());
+    baker.setSpecializationConstants({ { 0, QLatin1String("true") }, { 1, QLatin1String("8") } });
+    s = baker.bake();
+    QVERIFY2(s.isValid(), qPrintable(baker.errorMessage()));
+
+    // in a pipeline, a constant only needs to exist in one of the stages
+    const QStringList pipeline = { QLatin1String(":/data/color.vert"), QLatin1String(":/data/spec.frag") };
+    baker.setSpecializationConstants({ { 1, 8 } });
+    const QVector<QShader> shaders = baker.bakePipeline(pipeline);
+    QVERIFY2(shaders.count() == 2, qPrintable(baker.errorMessage()));
+    QVERIFY(!shaders[1].shader(glslKey).shader().contains(QByteArrayLiteral("SPIRV_CROSS_CONSTANT_ID_1")));
+    baker.setSpecializationConstants({ { 1, 8 }, { 5, 1 } });
+    QVERIFY(baker.bakePipeline(pipeline).isEmpty());
+    QVERIFY(baker.errorMessage().contains(QLatin1String("constant_id 5")));
+}
+
+class TestSink : public QShaderBakerSink
+{
+public:
+    bool begin(QShader::Stage stage, const QShaderDescription &description,
+               const QVector<QShaderKey> &keys) override
+    {
+        result.setStage(stage);
+        result.setDescription(description);
+        expectedKeys = keys;
+        return true;
+    }
+
+    bool addShader(const QShaderKey &key, const QShaderCode &shader,
+                   const QShader::NativeResourceBindingMap *nativeBindings) override
+    {
+        result.setShader(key, shader);
+        if (nativeBindings)
+            result.setResourceBindingMap(key, *nativeBindings);
+        return true;
+    }
+
+    QShader result;
+    QVector<QShaderKey> expectedKeys;
+};
+
+void tst_QShaderBaker::bakeToSink()
+{
+    QShaderBaker baker;
+    baker.setSourceFileName(QLatin1String(":/data/color.vert"));
+    baker.setGeneratedShaderVariants({ QShader::StandardShader, QShader::BatchableVertexShader });
+    QVector<QShaderBaker::GeneratedShader> targets;
+    targets.append({ QShader::SpirvShader, QShaderVersion(100) });
+    targets.append({ QShader::GlslShader, QShaderVersion(120) });
+    targets.append({ QShader::MslShader, QShaderVersion(12) });
+    baker.setGeneratedShaders(targets);
+    const QShader expected = baker.bake();
+    QVERIFY(expected.isValid());
+
+    TestSink sink;
+    QShaderBakerPrivate::get(&baker)->sink = &sink;
+    const QShader s = baker.bake();
+    QShaderBakerPrivate::get(&baker)->sink = nullptr;
+    QVERIFY(baker.errorMessage().isEmpty());
+    QVERIFY(!s.isValid()); // all shaders went to the sink
+
+    QCOMPARE(sink.expectedKeys.count(), 6);
+    QCOMPARE(sink.result.availableShaders().count(), 6);
+    for (const QShaderKey &key : sink.expectedKeys)
+        QCOMPARE(sink.result.shader(key), expected.shader(key));
+    QCOMPARE(sink.result, expected);
+}
+
+void tst_QShaderBaker::compactSpirv()
+{
+    QShaderBaker glslBaker;
+    glslBaker.setSourceFileName(QLatin1String(":/data/pipeline.vert"));
+    glslBaker.setGeneratedShaderVariants({ QShader::StandardShader });
+    glslBaker.setGeneratedShaders({ { QShader::SpirvShader, QShaderVersion(100) } });
+    QShader glslResult = glslBaker.bake();
+    QVERIFY(glslResult.isValid());
+    const QByteArray spirv = glslResult.shader(QShaderKey(QShader::SpirvShader, QShaderVersion(100))).shader();
+
+    const QByteArray compact = QSpirvCompact::encode(spirv);
+    QVERIFY(QSpirvCompact::isCompact(compact));
+    QVERIFY(!QSpirvCompact::isCompact(spirv));
+    QVERIFY(compact.size() < spirv.size());
+    QCOMPARE(QSpirvCompact::decode(compact), spirv);
+
+    // truncated data must be rejected, not crash
+    QVERIFY(QSpirvCompact::decode(compact.left(compact.size() / 2)).isEmpty());
+
+    QShaderBaker baker;
+    baker.setSourceSpirv(compact, QShader::VertexStage);
+    baker.setGeneratedShaderVariants({ QShader::StandardShader });
+    baker.setGeneratedShaders({ { QShader::SpirvShader, QShaderVersion(100) } });
+    QShader s = baker.bake();
+    QVERIFY(s.isValid());
+    QCOMPARE(s.shader(QShaderKey(QShader::SpirvShader, QShaderVersion(100))).shader(), spirv);
+    QCOMPARE(s.description(), glslResult.description());
+}
+
+void tst_QShaderBaker::compilerMemoryLimit()
+{
+    QShaderBaker baker;
+    baker.setSourceFileName(QLatin1String(":/data/pipeline.vert"));
+    baker.setGeneratedShaderVariants({ QShader::StandardShader });
+    baker.setGeneratedShaders({ { QShader::SpirvShader, QShaderVersion(100) } });
+    const QShader reference = baker.bake();
+    QVERIFY(reference.isValid());
+
+    // A single page is not enough for anything, the compile must fail
+    // instead of going over the limit.
+    baker.setCompilerPoolPageSize(4096);
+    baker.setCompilerMemoryLimit(4096);
+    QShader s = baker.bake();
+    QVERIFY(!s.isValid());
+    QVERIFY(baker.errorMessage().contains(QLatin1String("Memory limit")));
+
+    // The pool is reused after a failed compile, with a different page size
+    // and without a limit the results must be identical.
+    baker.setCompilerPoolPageSize(64 * 1024);
+    baker.setCompilerMemoryLimit(0);
+    for (int i = 0; i < 3; ++i) {
+        s = baker.bake();
+        QVERIFY(s.isValid());
+        QVERIFY(baker.errorMessage().isEmpty());
+        QCOMPARE(s, reference);
+    }
+
+    QSpirvCompiler compiler;
+    compiler.setSourceFileName(QLatin1String(":/data/pipeline.vert"));
+    QVERIFY(!compiler.compileToSpirv().isEmpty());
+    const qint64 peak = compiler.peakMemoryUsage();
+    QVERIFY(peak > 0);
+    compiler.setMemoryLimit(peak);
+    QVERIFY(!compiler.compileToSpirv().isEmpty());
+    QCOMPARE(compiler.peakMemoryUsage(), peak);
+}
+
+static QByteArray bakeSpirv(const QString &fileName)
+{
+    QShaderBaker baker;
+    baker.setSourceFileName(fileName);
+    baker.setGeneratedShaderVariants({ QShader::StandardShader });
+    baker.setGeneratedShaders({ { QShader::SpirvShader, QShaderVersion(100) } });
+    return baker.bake().shader(QShaderKey(QShader::SpirvShader, QShaderVersion(100))).shader();
+}
+
+void tst_QShaderBaker::spirvSharing()
+{
+    const QByteArray spirv = bakeSpirv(QLatin1String(":/data/color.vert"));
+    QVERIFY(!spirv.isEmpty());
+
+    QSpirvShader spirvShader;
+    spirvShader.setSpirvBinary(spirv);
+    QCOMPARE(spirvShader.spirvBinary().constData(), spirv.constData());
+
+    // The SPIR-V in the result is the input itself, not a copy, even when
+    // other targets get generated from it.
+    QShaderBaker baker;
+    baker.setSourceSpirv(spirv, QShader::VertexStage);
+    baker.setGeneratedShaderVariants({ QShader::StandardShader });
+    baker.setGeneratedShaders({
+        { QShader::SpirvShader, QShaderVersion(100) },
+        { QShader::GlslShader, QShaderVersion(100, QShaderVersion::GlslEs) },
+        { QShader::GlslShader, QShaderVersion(120) },
+        { QShader::HlslShader, QShaderVersion(50) }
+    });
+    const QShader s = baker.bake();
+    QVERIFY(s.isValid());
+    QCOMPARE(s.shader(QShaderKey(QShader::SpirvShader, QShaderVersion(100))).shader().constData(),
+             spirv.constData());
+
+    // Translating more than once must give identical results when the
+    // parsed module is reused.
+    QCOMPARE(spirvShader.translateToGLSL(120), spirvShader.translateToGLSL(120));
+    QCOMPARE(spirvShader.translateToGLSL(120),
+             s.shader(QShaderKey(QShader::GlslShader, QShaderVersion(120))).shader());
+}
+
+void tst_QShaderBaker::includeBundle()
+{
+    QShaderBaker baker;
+    baker.setSourceFileName(QLatin1String(":/data/include.frag"));
+    baker.setGeneratedShaderVariants({ QShader::StandardShader });
+    baker.setGeneratedShaders({ { QShader::SpirvShader, QShaderVersion(100) } });
+    const QShader reference = baker.bake();
+    QVERIFY2(reference.isValid(), qPrintable(baker.errorMessage()));
+    const QStringList includes = { QLatin1String(":/data/include/lighting.glsl"),
+                                   QLatin1String(":/data/include/common.glsl") };
+    QCOMPARE(baker.includedFiles(), includes);
+
+    QShaderIncludeBundle bundle;
+    QVERIFY(bundle.addDirectory(QLatin1String("qrc:/data/include")));
+    QCOMPARE(bundle.files(), QStringList({ QLatin1String(":/data/include/common.glsl"),
+                                           QLatin1String(":/data/include/lighting.glsl") }));
+    QCOMPARE(bundle.resolve(QLatin1String("include/lighting.glsl"), QLatin1String(":/data/include.frag")),
+             includes[0]);
+    QCOMPARE(bundle.resolve(QLatin1String("../include/common.glsl"), includes[0]), includes[1]);
+    QVERIFY(bundle.resolve(QLatin1String("missing.glsl"), includes[0]).isEmpty());
+
+    baker.setIncludeResolver(&bundle);
+    QShader s = baker.bake();
+    QVERIFY2(s.isValid(), qPrintable(baker.errorMessage()));
+    QCOMPARE(s, reference);
+    QCOMPARE(baker.includedFiles(), includes);
+
+    // the serialized form, loaded from memory and from a memory mapped file
+    const QByteArray data = bundle.serialize();
+    QShaderIncludeBundle loaded;
+    QVERIFY(loaded.loadData(data));
+    QCOMPARE(loaded.files(), bundle.files());
+    for (const QString &fn : includes) {
+        const QByteArray contents = loaded.contents(fn);
+        QCOMPARE(contents, bundle.contents(fn));
+        // not copied
+        QVERIFY(contents.constData() > data.constData());
+        QVERIFY(contents.constData() < data.constData() + data.size());
+    }
+    baker.setIncludeResolver(&loaded);
+    QCOMPARE(baker.bake(), reference);
+
+    QTemporaryDir tmpDir;
+    QVERIFY(tmpDir.isValid());
+    const QString bundleFn = tmpDir.filePath(QLatin1String("includes.bundle"));
+    QFile f(bundleFn);
+    QVERIFY(f.open(QIODevice::WriteOnly));
+    f.write(data);
+    f.close();
+    QShaderIncludeBundle mapped;
+    QVERIFY(mapped.load(bundleFn));
+    QCOMPARE(mapped.serialize(), data);
+    baker.setIncludeResolver(&mapped);
+    QCOMPARE(baker.bake(), reference);
+
+    // files added individually take precedence over the loaded bundle
+    mapped.addFile(includes[1], QByteArrayLiteral("const vec3 LIGHT_DIR = vec3(0.0, 1.0, 0.0);\n"
+                                                  "const vec3 BASE_COLOR = vec3(1.0);\n"));
+    s = baker.bake();
+    QVERIFY2(s.isValid(), qPrintable(baker.errorMessage()));
+    QVERIFY(s != reference);
+
+    // only the bundle is consulted when set
+    QShaderIncludeBundle empty;
+    baker.setIncludeResolver(&empty);
+    QVERIFY(!baker.bake().isValid());
+    QVERIFY(!baker.errorMessage().isEmpty());
+
+    baker.setIncludeResolver(nullptr);
+    QCOMPARE(baker.bake(), reference);
+
+    QVERIFY(!empty.loadData(QByteArrayLiteral("QSIB")));
+    QByteArray truncated = data;
+    truncated.truncate(data.size() - 8);
+    QVERIFY(!empty.loadData(truncated));
+    QVERIFY(empty.files().isEmpty());
+}
+
+// Counts how many times each header is actually read.
+class CountingIncludeResolver : public QShaderIncludeResolver
+{
+public:
+    QString resolve(const QString &headerName, const QString &includerName) const override
+    {
+        return bundle.resolve(headerName, includerName);
+    }
+    QByteArray contents(const QString &path) const override
+    {
+        ++reads[path];
+        return bundle.contents(path);
+    }
+
+    QShaderIncludeBundle bundle;
+    mutable QHash<QString, int> reads;
+};
+
+void tst_QShaderBaker::includeGuards_data()
+{
+    QTest::addColumn<QByteArray>("guardBegin");
+    QTest::addColumn<QByteArray>("guardEnd");
+    QTest::addColumn<bool>("skipped");
+
+    QTest::newRow("ifndef") << QByteArray("/* header */\n#ifndef LEVEL_%1_GLSL\n#define LEVEL_%1_GLSL\n")
+                            << QByteArray("#endif // LEVEL_%1_GLSL\n") << true;
+    QTest::newRow("if !defined") << QByteArray("#if !defined( LEVEL_%1_GLSL )\n#define LEVEL_%1_GLSL 1\n")
+                                 << QByteArray("#endif\n") << true;
+    QTest::newRow("pragma once") << QByteArray("#pragma once\n") << QByteArray() << true;
+    QTest::newRow("ifndef and pragma once") << QByteArray("#ifndef LEVEL_%1_GLSL\n#define LEVEL_%1_GLSL\n#pragma once\n")
+                                            << QByteArray("#endif\n") << true;
+    // only counts when not inside a conditional block
+    QTest::newRow("conditional pragma once") << QByteArray("#ifdef LEVEL_%1_ONCE\n#pragma once\n#endif\n")
+                                             << QByteArray() << false;
+    // not covering the whole file, up to the preprocessor to handle
+    QTest::newRow("partial") << QByteArray("#ifndef LEVEL_%1_GLSL\n#define LEVEL_%1_GLSL\n")
+                             << QByteArray("#endif\nconst float level_%1_tail = 1.0;\n") << false;
+}
+
+void tst_QShaderBaker::includeGuards()
+{
+    QFETCH(QByteArray, guardBegin);
+    QFETCH(QByteArray, guardEnd);
+    QFETCH(bool, skipped);
+
+    // Every level includes the next one twice, via different relative paths,
+    // so without skipping the deepest level is requested 2^depth times.
+    const int depth = 6;
+    CountingIncludeResolver resolver;
+    for (int level = 0; level <= depth; ++level) {
+        const QByteArray n = QByteArray::number(level);
+        QByteArray header = QString::fromLatin1(guardBegin).arg(level).toLatin1();
+        if (level < depth) {
+            const QByteArray next = QByteArray::number(level + 1);
+            header += "#include \"level" + next + ".glsl\"\n";
+            header += "#include \"../inc/./level" + next + ".glsl\"\n";
+            header += "float level" + n + "() { return level" + next + "() * 0.5; }\n";
+        } else {
+            header += "float level" + n + "() { return 1.0; }\n";
+        }
+        header += QString::fromLatin1(guardEnd).arg(level).toLatin1();
+        resolver.bundle.addFile(QLatin1String("inc/level") + QString::number(level) + QLatin1String(".glsl"), header);
+    }
+
+    const QByteArray source = QByteArrayLiteral("#version 440\n"
+                                                "#extension GL_GOOGLE_include_directive : enable\n"
+                                                "#include \"level0.glsl\"\n"
+                                                "#include \"level0.glsl\"\n"
+                                                "layout(location = 0) out vec4 fragColor;\n"
+                                                "void main() { fragColor = vec4(level0()); }\n");
+
+    QShaderBaker baker;
+    baker.setSourceString(source, QShader::FragmentStage, QLatin1String("inc/main.frag"));
+    baker.setGeneratedShaderVariants({ QShader::StandardShader });
+    baker.setGeneratedShaders({ { QShader::SpirvShader, QShaderVersion(100) } });
+    baker.setIncludeResolver(&resolver);
+    const QShader s = baker.bake();
+    if (!skipped) {
+        // the headers read more than once redefine their functions or
+        // the tail constants
+        QVERIFY(!s.isValid());
+        QVERIFY(resolver.reads.value(QLatin1String("inc/level1.glsl")) > 1);
+        return;
+    }
+    QVERIFY2(s.isValid(), qPrintable(baker.errorMessage()));
+    QCOMPARE(baker.includedFiles().count(), depth + 1);
+    for (auto it = resolver.reads.cbegin(), end = resolver.reads.cend(); it != end; ++it)
+        QVERIFY2(it.value() == 1, qPrintable(it.key()));
+    QCOMPARE(resolver.reads.count(), depth + 1);
+
+    // With the guard macro undefined in between, the header must be read
+    // again, and defines its function once more.
+    if (guardBegin.startsWith("#pragma"))
+        return;
+    resolver.reads.clear();
+    baker.setSourceString(QByteArrayLiteral("#version 440\n"
+                                            "#extension GL_GOOGLE_include_directive : enable\n"
+                                            "#include \"level6.glsl\"\n"
+                                            "#undef LEVEL_6_GLSL\n"
+                                            "#include \"level6.glsl\"\n"
+                                            "layout(location = 0) out vec4 fragColor;\n"
+                                            "void main() { fragColor = vec4(level6()); }\n"),
+                          QShader::FragmentStage, QLatin1String("inc/main.frag"));
+    QVERIFY(!baker.bake().isValid());
+    QCOMPARE(resolver.reads.value(QLatin1String("inc/level6.glsl")), 2);
+}
+
+void tst_QShaderBaker::referencedPreambleMacros()
+{
+    QShaderIncludeBundle bundle;
+    bundle.addFile(QLatin1String("inc/header.glsl"), QByteArrayLiteral("const float headerValue = IN_HEADER;\n"));
+
+    QShaderBaker baker;
+    baker.setIncludeResolver(&bundle);
+    baker.setSourceString(QByteArrayLiteral("#version 440\n"
+                                            "#extension GL_GOOGLE_include_directive : enable\n"
+                                            "#include \"header.glsl\"\n"
+                                            "layout(location = 0) out vec4 fragColor;\n"
+                                            "void main()\n"
+                                            "{\n"
+                                            "#ifdef USED\n"
+                                            "    fragColor = vec4(VIA_INDIRECT * headerValue);\n"
+                                            "#endif\n"
+                                            "}\n"),
+                          QShader::FragmentStage, QLatin1String("inc/main.frag"));
+    baker.setGeneratedShaderVariants({ QShader::StandardShader });
+    baker.setGeneratedShaders({ { QShader::SpirvShader, QShaderVersion(100) },
+                                { QShader::GlslShader, QShaderVersion(120) } });
+
+    // no preamble, nothing to report
+    QShader s = baker.bake();
+    QVERIFY(!s.isValid()); // IN_HEADER is undefined
+    QVERIFY(baker.referencedPreambleMacros().isEmpty());
+
+    baker.setPreamble(QByteArrayLiteral("#define USED\n"
+                                        "#define UNUSED 2.0\n"
+                                        "#define INDIRECT 0.5\n"
+                                        "#define VIA_INDIRECT (INDIRECT * 2.0)\n"
+                                        "#define IN_HEADER 3.0\n"
+                                        "#define UNUSED_TOO(x) (x * UNUSED)\n"));
+    const QShader reference = baker.bake();
+    QVERIFY2(reference.isValid(), qPrintable(baker.errorMessage()));
+    QByteArrayList macros = baker.referencedPreambleMacros();
+    std::sort(macros.begin(), macros.end());
+    QCOMPARE(macros, QByteArrayList({ "INDIRECT", "IN_HEADER", "USED", "VIA_INDIRECT" }));
+
+    // changing the macros that are not referenced does not change the result
+    baker.setPreamble(QByteArrayLiteral("#define USED\n"
+                                        "#define UNUSED 4.0\n"
+                                        "#define INDIRECT 0.5\n"
+                                        "#define VIA_INDIRECT (INDIRECT * 2.0)\n"
+                                        "#define IN_HEADER 3.0\n"));
+    QCOMPARE(baker.bake(), reference);
+    QCOMPARE(baker.referencedPreambleMacros().count(), 4);
+
+    // names put together by token pasting cannot be tracked
+    baker.setPreamble(QByteArrayLiteral("#define USED\n"
+                                        "#define UNUSED 4.0\n"
+                                        "#define INDIRECT 0.5\n"
+                                        "#define CONCAT(a, b) a ## b\n"
+                                        "#define VIA_INDIRECT CONCAT(INDI, RECT)\n"
+                                        "#define IN_HEADER 3.0\n"));
+    QVERIFY(baker.bake().isValid());
+    QCOMPARE(baker.referencedPreambleMacros().count(), 6);
+}
+
+static QByteArray normalizedHash(const QByteArray &source, QShader::Stage stage = QShader::FragmentStage,
+                                 const QByteArray &preamble = QByteArray())
+{
+    QSpirvCompiler compiler;
+    compiler.setSourceString(source, stage);
+    compiler.setPreamble(preamble);
+    return compiler.normalizedSourceHash();
+}
+
+void tst_QShaderBaker::normalizedSourceHash()
+{
+    const QByteArray source = QByteArrayLiteral("#version 440\n"
+                                                "layout(location = 0) out vec4 fragColor;\n"
+                                                "void main()\n"
+                                                "{\n"
+                                                "    float a = 1.0;\n"
+                                                "    a += 2.0;\n"
+                                                "    fragColor = vec4(a);\n"
+                                                "}\n");
+    const QByteArray hash = normalizedHash(source);
+    QVERIFY(!hash.isEmpty());
+
+    // comments, whitespace, and what the preprocessor drops do not matter
+    const QByteArray equivalent = QByteArrayLiteral("#version 440\n"
+                                                    "// the output\n"
+                                                    "layout(location=0) out vec4 fragColor;\n"
+                                                    "#define UNUSED 42\n"
+                                                    "void main() {\n"
+                                                    "    /* comment */ float a=1.0;\n"
+                                                    "#if 0\n"
+                                                    "    a = 3.0;\n"
+                                                    "#endif\n"
+                                                    "    a    +=\t2.0;\n"
+                                                    "\n"
+                                                    "    fragColor = vec4( a );\n"
+                                                    "}\n");
+    QCOMPARE(normalizedHash(equivalent), hash);
+    QCOMPARE(normalizedHash(source, QShader::FragmentStage, QByteArrayLiteral("#define UNUSED 1\n")), hash);
+
+    // while anything that ends up in the token stream does
+    QVERIFY(normalizedHash(QByteArray(source).replace("2.0", "3.0")) != hash);
+    QVERIFY(normalizedHash(QByteArray(source).replace("a += 2.0", "a + = 2.0")) != hash);
+    QVERIFY(normalizedHash(QByteArray(source).replace("440", "450")) != hash);
+    QVERIFY(normalizedHash(source, QShader::VertexStage) != hash);
+    const QByteArray withMacro = QByteArray(source).replace("2.0", "VALUE");
+    QVERIFY(normalizedHash(withMacro, QShader::FragmentStage, QByteArrayLiteral("#define VALUE 2.0\n")) == hash);
+    QVERIFY(normalizedHash(withMacro, QShader::FragmentStage, QByteArrayLiteral("#define VALUE 3.0\n")) != hash);
+
+    // preprocessing errors give no hash
+    QVERIFY(normalizedHash(QByteArrayLiteral("#version 440\n#error broken\n")).isEmpty());
+}
+
+void tst_QShaderBaker::costInfo()
+{
+    QSpirvShader simple;
+    simple.setSpirvBinary(bakeSpirv(QLatin1String(":/data/color.frag")));
+    const QSpirvShader::CostInfo simpleCost = simple.costInfo();
+    QVERIFY(simpleCost.instructionCount > 0);
+    QVERIFY(simpleCost.aluInstructionCount > 0);
+    QCOMPARE(simpleCost.textureInstructionCount, 0);
+    QCOMPARE(simpleCost.branchCount, 0);
+    QCOMPARE(simpleCost.loopCount, 0);
+    QVERIFY(simpleCost.maxLiveComponents > 0);
+    QCOMPARE(simpleCost.inputComponents, 3);
+    QCOMPARE(simpleCost.outputComponents, 4);
+    QVERIFY(simpleCost.uniformBlockSize >= 68);
+    QCOMPARE(simpleCost.samplerCount, 0);
+
+    QSpirvShader complex;
+    complex.setSpirvBinary(bakeSpirv(QLatin1String(":/data/cost.frag")));
+    const QSpirvShader::CostInfo cost = complex.costInfo();
+    QVERIFY(cost.instructionCount > simpleCost.instructionCount);
+    QCOMPARE(cost.textureInstructionCount, 1);
+    QCOMPARE(cost.branchCount, 2); // the loop condition and the if
+    QCOMPARE(cost.loopCount, 1);
+    // the accumulated color is live across the loop, next to the input
+    QVERIFY(cost.maxLiveComponents >= 4);
+    QCOMPARE(cost.inputComponents, 5);
+    QCOMPARE(cost.outputComponents, 4);
+    QCOMPARE(cost.uniformBlockSize, 80);
+    QCOMPARE(cost.samplerCount, 1);
+
+    QSpirvShader invalid;
+    invalid.setSpirvBinary(QByteArrayLiteral("not spirv"));
+    QCOMPARE(invalid.costInfo().instructionCount, 0);
+}
+
+void tst_QShaderBaker::byteSwappedSpirv()
+{
+    const QByteArray spirv = bakeSpirv(QLatin1String(":/data/color.vert"));
+    QVERIFY(!spirv.isEmpty());
+
+    // the other byte order, at an odd address
+    QByteArray buf(spirv.size() + 1, Qt::Uninitialized);
+    for (int i = 0; i < spirv.size(); i += 4)
+        qToUnaligned(qbswap(qFromUnaligned<quint32>(spirv.constData() + i)), buf.data() + 1 + i);
+    const QByteArray swapped = QByteArray::fromRawData(buf.constData() + 1, spirv.size());
+
+    QShaderBaker baker;
+    baker.setGeneratedShaderVariants({ QShader::StandardShader });
+    baker.setGeneratedShaders({
+        { QShader::SpirvShader, QShaderVersion(100) },
+        { QShader::GlslShader, QShaderVersion(330) }
+    });
+    baker.setSourceSpirv(spirv, QShader::VertexStage);
+    const QShader expected = baker.bake();
+    QVERIFY(expected.isValid());
+    baker.setSourceSpirv(swapped, QShader::VertexStage);
+    const QShader s = baker.bake();
+    QVERIFY2(s.isValid(), qPrintable(baker.errorMessage()));
+    QCOMPARE(s.shader(QShaderKey(QShader::SpirvShader, QShaderVersion(100))).shader(), spirv);
+    QCOMPARE(s.shader(QShaderKey(QShader::GlslShader, QShaderVersion(330))).shader(),
+             expected.shader(QShaderKey(QShader::GlslShader, QShaderVersion(330))).shader());
+}
+
+void tst_QShaderBaker::streamedPack()
+{
+    QShaderBaker baker;
+    baker.setSourceFileName(QLatin1String(":/data/color.vert"));
+    baker.setGeneratedShaderVariants({ QShader::StandardShader, QShader::BatchableVertexShader });
+    baker.setGeneratedShaders({
+        { QShader::SpirvShader, QShaderVersion(100) },
+        { QShader::GlslShader, QShaderVersion(100, QShaderVersion::GlslEs) },
+        { QShader::HlslShader, QShaderVersion(50) },
+        { QShader::MslShader, QShaderVersion(12) }
+    });
+    const QShader s = baker.bake();
+    QVERIFY2(s.isValid(), qPrintable(baker.errorMessage()));
+
+    QBuffer buf;
+    QVERIFY(buf.open(QIODevice::WriteOnly));
+    QShaderPackWriter writer(&buf);
+    const QVector<QShaderKey> keys = s.availableShaders();
+    QVERIFY(writer.begin(s.stage(), s.description(), keys.count()));
+    int bindingMaps = 0;
+    for (const QShaderKey &key : keys) {
+        QVERIFY(writer.addShader(key, s.shader(key)));
+        if (const QShader::NativeResourceBindingMap *map = s.nativeResourceBindingMap(key)) {
+            writer.addResourceBindingMap(key, *map);
+            ++bindingMaps;
+        }
+    }
+    QVERIFY(bindingMaps > 0);
+    QVERIFY(writer.finish());
+    buf.close();
+
+    // the same data as QShader writes, up to the order of the hashes
+    const QByteArray expected = s.serialized();
+    QCOMPARE(qUncompress(buf.data()).size(), qUncompress(expected).size());
+    const QShader streamed = QShader::fromSerialized(buf.data());
+    QVERIFY(streamed.isValid());
+    QCOMPARE(streamed, QShader::fromSerialized(expected));
+    QCOMPARE(streamed.availableShaders().count(), keys.count());
+    for (const QShaderKey &key : keys) {
+        QCOMPARE(streamed.shader(key).shader(), s.shader(key).shader());
+        QCOMPARE(streamed.shader(key).entryPoint(), s.shader(key).entryPoint());
+        const QShader::NativeResourceBindingMap *map = s.nativeResourceBindingMap(key);
+        const QShader::NativeResourceBindingMap *streamedMap = streamed.nativeResourceBindingMap(key);
+        QCOMPARE(!streamedMap, !map);
+        if (map)
+            QCOMPARE(*streamedMap, *map);
+    }
+}
+
 #include <tst_qshaderbaker.moc>
 QTEST_MAIN(tst_QShaderBaker)
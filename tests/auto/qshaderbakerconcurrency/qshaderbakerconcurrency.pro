@@ -0,0 +1,8 @@
+TARGET = tst_qshaderbakerconcurrency
+CONFIG += testcase
+
+QT += testlib shadertools gui-private
+
+SOURCES += tst_qshaderbakerconcurrency.cpp
+
+RESOURCES += qshaderbakerconcurrency.qrc
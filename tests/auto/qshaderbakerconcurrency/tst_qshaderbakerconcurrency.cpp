@@ -0,0 +1,170 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#include <QtTest/QtTest>
+#include <QThreadPool>
+#include <QtShaderTools/QShaderBaker>
+#include <QtGui/private/qshader_p.h>
+
+// Bakes the same corpus serially and on several threads at once, and
+// verifies that the results, including the error messages, are identical.
+// Mostly useful in a ThreadSanitizer build (qmake CONFIG+=tsan).
+
+class tst_QShaderBakerConcurrency : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void concurrentBake_data();
+    void concurrentBake();
+    void concurrentBakeSharedPool();
+
+private:
+    struct Result {
+        QShader shader;
+        QString errorMessage;
+    };
+    static Result bakeOne(const QString &fileName);
+    QVector<Result> bakeConcurrently(int threadCount, int rounds);
+
+    QStringList corpus;
+    QVector<Result> serialResults;
+};
+
+tst_QShaderBakerConcurrency::Result tst_QShaderBakerConcurrency::bakeOne(const QString &fileName)
+{
+    QShaderBaker baker;
+    baker.setSourceFileName(fileName);
+    baker.setGeneratedShaderVariants({ QShader::StandardShader, QShader::BatchableVertexShader });
+    baker.setGeneratedShaders({
+        { QShader::SpirvShader, QShaderVersion(100) },
+        { QShader::GlslShader, QShaderVersion(100, QShaderVersion::GlslEs) },
+        { QShader::GlslShader, QShaderVersion(120) },
+        { QShader::GlslShader, QShaderVersion(150) },
+        { QShader::HlslShader, QShaderVersion(50) },
+        { QShader::MslShader, QShaderVersion(12) }
+    });
+    Result r;
+    r.shader = baker.bake();
+    r.errorMessage = baker.errorMessage();
+    return r;
+}
+
+void tst_QShaderBakerConcurrency::initTestCase()
+{
+    QDirIterator it(QLatin1String(":/data"));
+    while (it.hasNext())
+        corpus.append(it.next());
+    QVERIFY(!corpus.isEmpty());
+
+    bool sawError = false;
+    for (const QString &fn : qAsConst(corpus)) {
+        serialResults.append(bakeOne(fn));
+        if (!serialResults.last().shader.isValid())
+            sawError = true;
+    }
+    // the error paths need to be covered too
+    QVERIFY(sawError);
+}
+
+// Bakes the corpus 'rounds' times with 'threadCount' threads pulling the
+// next file from a shared counter, so that different threads work on
+// different files, and on the same file, at the same time.
+QVector<tst_QShaderBakerConcurrency::Result> tst_QShaderBakerConcurrency::bakeConcurrently(int threadCount, int rounds)
+{
+    const int jobCount = corpus.count() * rounds;
+    QVector<Result> results(jobCount);
+    Result *out = results.data();
+    QAtomicInt next;
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadCount);
+    for (int t = 0; t < threadCount; ++t) {
+        pool.start([this, out, &next, jobCount] {
+            for (int i = next.fetchAndAddRelaxed(1); i < jobCount; i = next.fetchAndAddRelaxed(1))
+                out[i] = bakeOne(corpus.at(i % corpus.count()));
+        });
+    }
+    pool.waitForDone();
+
+    return results;
+}
+
+void tst_QShaderBakerConcurrency::concurrentBake_data()
+{
+    QTest::addColumn<int>("threadCount");
+    QTest::addColumn<int>("rounds");
+
+    QTest::newRow("2 threads") << 2 << 4;
+    QTest::newRow("4 threads") << 4 << 4;
+    const int ideal = QThread::idealThreadCount();
+    if (ideal > 4)
+        QTest::newRow("ideal thread count") << ideal << 4;
+}
+
+void tst_QShaderBakerConcurrency::concurrentBake()
+{
+    QFETCH(int, threadCount);
+    QFETCH(int, rounds);
+
+    const QVector<Result> results = bakeConcurrently(threadCount, rounds);
+    QCOMPARE(results.count(), corpus.count() * rounds);
+    for (int i = 0; i < results.count(); ++i) {
+        const Result &expected(serialResults[i % corpus.count()]);
+        const QByteArray fn = corpus[i % corpus.count()].toUtf8();
+        QVERIFY2(results[i].shader == expected.shader, fn.constData());
+        QVERIFY2(results[i].errorMessage == expected.errorMessage, fn.constData());
+    }
+}
+
+// The global thread pool reuses its threads, which means the per-thread
+// glslang state stays around between bakes.
+void tst_QShaderBakerConcurrency::concurrentBakeSharedPool()
+{
+    const int rounds = 8;
+    const int jobCount = corpus.count() * rounds;
+    QVector<Result> results(jobCount);
+    Result *out = results.data();
+    for (int i = 0; i < jobCount; ++i) {
+        QThreadPool::globalInstance()->start([this, out, i] {
+            out[i] = bakeOne(corpus.at(i % corpus.count()));
+        });
+    }
+    QThreadPool::globalInstance()->waitForDone();
+
+    for (int i = 0; i < jobCount; ++i) {
+        const Result &expected(serialResults[i % corpus.count()]);
+        QVERIFY(results[i].shader == expected.shader);
+        QCOMPARE(results[i].errorMessage, expected.errorMessage);
+    }
+}
+
+#include <tst_qshaderbakerconcurrency.moc>
+QTEST_MAIN(tst_QShaderBakerConcurrency)
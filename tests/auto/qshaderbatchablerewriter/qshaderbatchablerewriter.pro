@@ -0,0 +1,6 @@
+TARGET = tst_qshaderbatchablerewriter
+CONFIG += testcase
+
+QT += testlib shadertools-private
+
+SOURCES += tst_qshaderbatchablerewriter.cpp
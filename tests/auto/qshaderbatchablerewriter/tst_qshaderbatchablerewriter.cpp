@@ -0,0 +1,145 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#include <QtTest/QtTest>
+#include <QRandomGenerator>
+#include <QtShaderTools/private/qshaderbatchablerewriter_p.h>
+
+using QShaderBatchableRewriter::Tokenizer;
+
+class tst_QShaderBatchableRewriter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void addZAdjustment_data();
+    void addZAdjustment();
+    void scalarAndSimdMatch();
+};
+
+static const char *expectedMainEnd = "    gl_Position.z = _qt_order * gl_Position.w;\n}";
+
+void tst_QShaderBatchableRewriter::addZAdjustment_data()
+{
+    QTest::addColumn<QByteArray>("input");
+    QTest::addColumn<QByteArray>("beforeInsertion");
+
+    QTest::newRow("simple")
+            << QByteArray("#version 440\nvoid main()\n{\n    gl_Position = vec4(1.0);\n}\n")
+            << QByteArray("    gl_Position = vec4(1.0);\n");
+    QTest::newRow("nested")
+            << QByteArray("void main() { if (x) { y(); } else { z(); }\n}")
+            << QByteArray("else { z(); }\n");
+    QTest::newRow("block comment with braces")
+            << QByteArray("void main() {\n    /* { a*b } */ gl_Position = p;\n}")
+            << QByteArray("gl_Position = p;\n");
+    QTest::newRow("line comment with brace")
+            << QByteArray("void main() {\n    // }\n    gl_Position = p;\n}")
+            << QByteArray("gl_Position = p;\n");
+    QTest::newRow("preprocessor with brace")
+            << QByteArray("void main() {\n#define X } \\\n  }\n    gl_Position = p;\n}")
+            << QByteArray("gl_Position = p;\n");
+    QTest::newRow("other void functions")
+            << QByteArray("void mainly() { }\nvoid main() { gl_Position = p;\n}")
+            << QByteArray("gl_Position = p;\n");
+}
+
+void tst_QShaderBatchableRewriter::addZAdjustment()
+{
+    QFETCH(QByteArray, input);
+    QFETCH(QByteArray, beforeInsertion);
+
+    const QByteArray result = QShaderBatchableRewriter::addZAdjustment(input, 7);
+    QVERIFY(result.contains("layout(location = 7) in float _qt_order;\n"));
+    QVERIFY(result.endsWith(beforeInsertion + expectedMainEnd));
+    QVERIFY(result.indexOf("_qt_order;\n") < result.indexOf("void main"));
+}
+
+struct TokenRecord
+{
+    Tokenizer::Token token;
+    qptrdiff pos;
+    qptrdiff identifier;
+};
+
+static QVector<TokenRecord> tokenize(const QByteArray &input, bool simd)
+{
+    QVector<TokenRecord> tokens;
+    Tokenizer tok;
+    tok.initialize(input, simd);
+    for (;;) {
+        const Tokenizer::Token t = tok.next();
+        tokens.append({ t, tok.pos - tok.stream,
+                        t == Tokenizer::Token_Identifier ? tok.identifier - tok.stream : -1 });
+        if (t == Tokenizer::Token_EOF)
+            break;
+    }
+    return tokens;
+}
+
+// Random inputs built from fragments that exercise every scanner, with
+// lengths spread around the 16 byte block size so that both the vectorized
+// loops and the scalar tails are hit.
+void tst_QShaderBatchableRewriter::scalarAndSimdMatch()
+{
+    static const char *fragments[] = {
+        "void", "main", "vec4", "_qt_x1", "a", "Z9", "{", "}", ";", "(", ")",
+        " ", "   ", "\t", "\n", "\r\n", "                    ",
+        "/*", "*/", "*", "/", "//", "#", "\\", "\\\n", "\\ \r\n",
+        "0123456789", "abcdefghijklmnopqrstuvwxyzABCDEFGHIJ_",
+        "@", "\x80", "\xff"
+    };
+    const int fragmentCount = int(sizeof(fragments) / sizeof(fragments[0]));
+
+    QRandomGenerator rng(1234);
+    for (int iteration = 0; iteration < 20000; ++iteration) {
+        QByteArray input;
+        const int pieces = rng.bounded(1, 40);
+        for (int i = 0; i < pieces; ++i)
+            input += fragments[rng.bounded(fragmentCount)];
+        if (rng.bounded(8) == 0)
+            input.insert(rng.bounded(input.size() + 1), '\0');
+
+        const QVector<TokenRecord> scalar = tokenize(input, false);
+        const QVector<TokenRecord> simd = tokenize(input, true);
+        if (scalar.count() != simd.count())
+            QFAIL(qPrintable(QString::fromLatin1("Token count mismatch for %1").arg(QString::fromLatin1(input.toHex()))));
+        for (int i = 0; i < scalar.count(); ++i) {
+            if (scalar[i].token != simd[i].token || scalar[i].pos != simd[i].pos
+                    || scalar[i].identifier != simd[i].identifier)
+            {
+                QFAIL(qPrintable(QString::fromLatin1("Token %1 mismatch for %2").arg(i)
+                                 .arg(QString::fromLatin1(input.toHex()))));
+            }
+        }
+    }
+}
+
+#include <tst_qshaderbatchablerewriter.moc>
+QTEST_MAIN(tst_QShaderBatchableRewriter)
@@ -0,0 +1,8 @@
+TARGET = tst_qspirvallocations
+CONFIG += testcase
+
+QT += testlib shadertools-private gui-private
+
+SOURCES += tst_qspirvallocations.cpp
+
+RESOURCES += qspirvallocations.qrc
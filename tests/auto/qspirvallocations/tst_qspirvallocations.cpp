@@ -0,0 +1,149 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#include <QtTest/QtTest>
+#include <QtShaderTools/QShaderBaker>
+#include <QtShaderTools/private/qspirvshader_p.h>
+#include <QtGui/private/qshader_p.h>
+#include <cstdlib>
+#include <new>
+
+// Replacing the global operator new affects every test in the executable,
+// so this lives in a test of its own.
+//
+// Counts the operator new calls of exactly a given size while enabled. The
+// containers in SPIRV-Cross allocate through operator new, so this catches
+// copies of the SPIR-V words made on the std::vector level. QByteArray
+// allocates with malloc() and is not counted.
+static QAtomicInt allocationSize;
+static QAtomicInt allocationCount;
+
+void *operator new(std::size_t size)
+{
+    const int counted = allocationSize.loadRelaxed();
+    if (counted > 0 && size == std::size_t(counted))
+        allocationCount.fetchAndAddRelaxed(1);
+    void *p = std::malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+struct AllocationCounter
+{
+    AllocationCounter(int size)
+    {
+        allocationCount.storeRelaxed(0);
+        allocationSize.storeRelaxed(size);
+    }
+    ~AllocationCounter() { allocationSize.storeRelaxed(0); }
+    int count() const { return allocationCount.loadRelaxed(); }
+};
+
+typedef QVector<QShaderBaker::GeneratedShader> GeneratedShaders;
+Q_DECLARE_METATYPE(GeneratedShaders)
+
+class tst_QSpirvAllocations : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void reflection();
+    void bake_data();
+    void bake();
+
+private:
+    QByteArray spirv;
+};
+
+void tst_QSpirvAllocations::initTestCase()
+{
+    QShaderBaker baker;
+    baker.setSourceFileName(QLatin1String(":/data/color.vert"));
+    baker.setGeneratedShaderVariants({ QShader::StandardShader });
+    baker.setGeneratedShaders({ { QShader::SpirvShader, QShaderVersion(100) } });
+    spirv = baker.bake().shader(QShaderKey(QShader::SpirvShader, QShaderVersion(100))).shader();
+    QVERIFY(!spirv.isEmpty());
+}
+
+void tst_QSpirvAllocations::reflection()
+{
+    // Parsing makes one copy of the words, and the GLSL compiler used for
+    // reflection gets one more with its copy of the parsed module.
+    AllocationCounter counter(spirv.size());
+    QSpirvShader spirvShader;
+    spirvShader.setSpirvBinary(spirv);
+    QCOMPARE(counter.count(), 2);
+}
+
+void tst_QSpirvAllocations::bake_data()
+{
+    QTest::addColumn<GeneratedShaders>("targets");
+    QTest::addColumn<int>("expectedCount");
+
+    // The words are parsed once per bake, not once per target. Each
+    // translated target adds exactly one copy with the parsed module its
+    // compiler works on.
+    QTest::newRow("spirv")
+            << GeneratedShaders({ { QShader::SpirvShader, QShaderVersion(100) } })
+            << 2;
+    QTest::newRow("spirv+glsl")
+            << GeneratedShaders({ { QShader::SpirvShader, QShaderVersion(100) },
+                                  { QShader::GlslShader, QShaderVersion(120) } })
+            << 3;
+    QTest::newRow("spirv+glsl+hlsl")
+            << GeneratedShaders({ { QShader::SpirvShader, QShaderVersion(100) },
+                                  { QShader::GlslShader, QShaderVersion(120) },
+                                  { QShader::HlslShader, QShaderVersion(50) } })
+            << 4;
+}
+
+void tst_QSpirvAllocations::bake()
+{
+    QFETCH(GeneratedShaders, targets);
+    QFETCH(int, expectedCount);
+
+    QShaderBaker baker;
+    baker.setSourceSpirv(spirv, QShader::VertexStage);
+    baker.setGeneratedShaderVariants({ QShader::StandardShader });
+    baker.setGeneratedShaders(targets);
+
+    AllocationCounter counter(spirv.size());
+    QVERIFY(baker.bake().isValid());
+    QCOMPARE(counter.count(), expectedCount);
+}
+
+#include <tst_qspirvallocations.moc>
+QTEST_MAIN(tst_QSpirvAllocations)
@@ -0,0 +1,6 @@
+TEMPLATE = subdirs
+SUBDIRS = \
+    qshaderbakerscaling \
+    qshaderbatchablerewriter \
+    qspirvcompact \
+    qspirvcompilerincludes
@@ -0,0 +1,8 @@
+TARGET = tst_bench_qshaderbakerscaling
+CONFIG += benchmark
+
+QT += testlib shadertools gui-private
+
+SOURCES += tst_bench_qshaderbakerscaling.cpp
+
+RESOURCES += qshaderbakerscaling.qrc
@@ -0,0 +1,220 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#include <QtTest/QtTest>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QtShaderTools/QShaderBaker>
+#include <QtGui/private/qshader_p.h>
+
+// Bakes a mixed corpus on 1..N threads and reports the throughput and the
+// scaling efficiency relative to a single thread. The results of every run
+// are checked against a serial bake. The "compile" variants generate SPIR-V
+// only, to show how glslang on its own scales.
+
+class tst_bench_QShaderBakerScaling : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void bake_data();
+    void bake();
+    void compile_data();
+    void compile();
+    void scaling_data();
+    void scaling();
+
+private:
+    static QShader bakeOne(const QString &fileName, bool spirvOnly);
+    QVector<QShader> bakeConcurrently(int threadCount, int rounds, bool spirvOnly);
+    QVector<int> threadCounts() const;
+    void addThreadCountRows();
+    void verify(const QVector<QShader> &results, bool spirvOnly);
+
+    QStringList corpus;
+    QVector<QShader> serialResults;
+    QVector<QShader> serialSpirvResults;
+};
+
+QShader tst_bench_QShaderBakerScaling::bakeOne(const QString &fileName, bool spirvOnly)
+{
+    QShaderBaker baker;
+    baker.setSourceFileName(fileName);
+    if (spirvOnly) {
+        baker.setGeneratedShaderVariants({ QShader::StandardShader });
+        baker.setGeneratedShaders({ { QShader::SpirvShader, QShaderVersion(100) } });
+        return baker.bake();
+    }
+    baker.setGeneratedShaderVariants({ QShader::StandardShader, QShader::BatchableVertexShader });
+    baker.setGeneratedShaders({
+        { QShader::SpirvShader, QShaderVersion(100) },
+        { QShader::GlslShader, QShaderVersion(100, QShaderVersion::GlslEs) },
+        { QShader::GlslShader, QShaderVersion(120) },
+        { QShader::GlslShader, QShaderVersion(150) },
+        { QShader::HlslShader, QShaderVersion(50) },
+        { QShader::MslShader, QShaderVersion(12) }
+    });
+    return baker.bake();
+}
+
+void tst_bench_QShaderBakerScaling::initTestCase()
+{
+    QDirIterator it(QLatin1String(":/data"));
+    while (it.hasNext())
+        corpus.append(it.next());
+    QVERIFY(!corpus.isEmpty());
+
+    for (const QString &fn : qAsConst(corpus)) {
+        serialResults.append(bakeOne(fn, false));
+        QVERIFY2(serialResults.last().isValid(), qPrintable(fn));
+        serialSpirvResults.append(bakeOne(fn, true));
+        QVERIFY2(serialSpirvResults.last().isValid(), qPrintable(fn));
+    }
+}
+
+QVector<QShader> tst_bench_QShaderBakerScaling::bakeConcurrently(int threadCount, int rounds, bool spirvOnly)
+{
+    const int jobCount = corpus.count() * rounds;
+    QVector<QShader> results(jobCount);
+    QShader *out = results.data();
+    QAtomicInt next;
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadCount);
+    for (int t = 0; t < threadCount; ++t) {
+        pool.start([this, out, &next, jobCount, spirvOnly] {
+            for (int i = next.fetchAndAddRelaxed(1); i < jobCount; i = next.fetchAndAddRelaxed(1))
+                out[i] = bakeOne(corpus.at(i % corpus.count()), spirvOnly);
+        });
+    }
+    pool.waitForDone();
+
+    return results;
+}
+
+// 1, 2, 4, ... up to the number of cores, and the number of cores itself
+QVector<int> tst_bench_QShaderBakerScaling::threadCounts() const
+{
+    const int ideal = qMax(1, QThread::idealThreadCount());
+    QVector<int> counts;
+    for (int n = 1; n < ideal; n *= 2)
+        counts.append(n);
+    counts.append(ideal);
+    return counts;
+}
+
+void tst_bench_QShaderBakerScaling::addThreadCountRows()
+{
+    QTest::addColumn<int>("threadCount");
+    for (int n : threadCounts())
+        QTest::newRow(qPrintable(QString::number(n) + QLatin1String(" threads"))) << n;
+}
+
+void tst_bench_QShaderBakerScaling::verify(const QVector<QShader> &results, bool spirvOnly)
+{
+    const QVector<QShader> &expected(spirvOnly ? serialSpirvResults : serialResults);
+    for (int i = 0; i < results.count(); ++i)
+        QVERIFY(results[i] == expected[i % corpus.count()]);
+}
+
+void tst_bench_QShaderBakerScaling::bake_data()
+{
+    addThreadCountRows();
+}
+
+// Time for baking the corpus once per thread, so with perfect scaling the
+// result stays the same as the thread count grows.
+void tst_bench_QShaderBakerScaling::bake()
+{
+    QFETCH(int, threadCount);
+
+    QVector<QShader> results;
+    QBENCHMARK {
+        results = bakeConcurrently(threadCount, threadCount, false);
+    }
+    verify(results, false);
+}
+
+void tst_bench_QShaderBakerScaling::compile_data()
+{
+    addThreadCountRows();
+}
+
+void tst_bench_QShaderBakerScaling::compile()
+{
+    QFETCH(int, threadCount);
+
+    QVector<QShader> results;
+    QBENCHMARK {
+        results = bakeConcurrently(threadCount, threadCount, true);
+    }
+    verify(results, true);
+}
+
+void tst_bench_QShaderBakerScaling::scaling_data()
+{
+    QTest::addColumn<bool>("spirvOnly");
+    QTest::newRow("bake") << false;
+    QTest::newRow("compile") << true;
+}
+
+void tst_bench_QShaderBakerScaling::scaling()
+{
+    QFETCH(bool, spirvOnly);
+    // enough work to keep all threads busy in the largest configuration
+    const int rounds = qMax(4, threadCounts().last());
+    const int jobCount = corpus.count() * rounds;
+    double singleThreadRate = 0;
+
+    qDebug("%d shaders per run", jobCount);
+    for (int n : threadCounts()) {
+        // best of three, to filter out the noise of the first, cold run
+        qint64 bestNs = std::numeric_limits<qint64>::max();
+        for (int attempt = 0; attempt < 3; ++attempt) {
+            QElapsedTimer t;
+            t.start();
+            const QVector<QShader> results = bakeConcurrently(n, rounds, spirvOnly);
+            bestNs = qMin(bestNs, t.nsecsElapsed());
+            verify(results, spirvOnly);
+            if (QTest::currentTestFailed())
+                return;
+        }
+
+        const double rate = jobCount / (qMax<qint64>(1, bestNs) / 1e9);
+        if (n == 1)
+            singleThreadRate = rate;
+        const double speedup = rate / singleThreadRate;
+        qDebug("%3d threads: %8.1f shaders/s, speedup %5.2fx, efficiency %5.1f%%",
+               n, rate, speedup, 100.0 * speedup / n);
+    }
+}
+
+#include <tst_bench_qshaderbakerscaling.moc>
+QTEST_MAIN(tst_bench_QShaderBakerScaling)
@@ -0,0 +1,6 @@
+TARGET = tst_bench_qshaderbatchablerewriter
+CONFIG += benchmark
+
+QT += testlib shadertools-private
+
+SOURCES += tst_bench_qshaderbatchablerewriter.cpp
@@ -0,0 +1,102 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#include <QtTest/QtTest>
+#include <QtShaderTools/private/qshaderbatchablerewriter_p.h>
+
+using QShaderBatchableRewriter::Tokenizer;
+
+class tst_bench_QShaderBatchableRewriter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void tokenize_data();
+    void tokenize();
+    void addZAdjustment();
+
+private:
+    QByteArray source;
+};
+
+// Something resembling a large generated vertex shader: long comment
+// blocks, macro definitions with continuations, and many small functions.
+void tst_bench_QShaderBatchableRewriter::initTestCase()
+{
+    source = QByteArrayLiteral("#version 440\n\n"
+                               "layout(location = 0) in vec4 position;\n"
+                               "layout(std140, binding = 0) uniform buf { mat4 mvp; float weights[64]; } ubuf;\n\n");
+    for (int i = 0; i < 5000; ++i) {
+        const QByteArray n = QByteArray::number(i);
+        source += "/*\n * Generated helper " + n + ".\n * { Braces in comments } must not confuse the rewriter.\n */\n";
+        source += "#define WEIGHT_" + n + "(x) \\\n    ((x) * ubuf.weights[" + QByteArray::number(i % 64) + "])\n";
+        source += "float helper_" + n + "(float value)\n{\n"
+                  "    // accumulate\n"
+                  "    float acc = WEIGHT_" + n + "(value);\n"
+                  "    if (acc > 1.0) { acc = sqrt(acc); }\n"
+                  "    return acc;\n}\n\n";
+    }
+    source += "void main()\n{\n    gl_Position = ubuf.mvp * position;\n}\n";
+    qDebug("Source is %d bytes", source.size());
+}
+
+void tst_bench_QShaderBatchableRewriter::tokenize_data()
+{
+    QTest::addColumn<bool>("simd");
+    QTest::newRow("scalar") << false;
+    QTest::newRow("simd") << true;
+}
+
+void tst_bench_QShaderBatchableRewriter::tokenize()
+{
+    QFETCH(bool, simd);
+
+    int count = 0;
+    QBENCHMARK {
+        Tokenizer tok;
+        tok.initialize(source, simd);
+        count = 0;
+        while (tok.next() != Tokenizer::Token_EOF)
+            ++count;
+    }
+    QVERIFY(count > 0);
+}
+
+void tst_bench_QShaderBatchableRewriter::addZAdjustment()
+{
+    QByteArray result;
+    QBENCHMARK {
+        result = QShaderBatchableRewriter::addZAdjustment(source, 7);
+    }
+    QVERIFY(result.contains("_qt_order * gl_Position.w"));
+}
+
+#include <tst_bench_qshaderbatchablerewriter.moc>
+QTEST_MAIN(tst_bench_QShaderBatchableRewriter)
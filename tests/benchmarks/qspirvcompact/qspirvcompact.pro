@@ -0,0 +1,8 @@
+TARGET = tst_bench_qspirvcompact
+CONFIG += benchmark
+
+QT += testlib shadertools shadertools-private gui-private
+
+SOURCES += tst_bench_qspirvcompact.cpp
+
+RESOURCES += qspirvcompact.qrc
@@ -0,0 +1,128 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#include <QtTest/QtTest>
+#include <QtShaderTools/QShaderBaker>
+#include <QtShaderTools/private/qspirvcompact_p.h>
+
+class tst_bench_QSpirvCompact : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void size_data();
+    void size();
+    void encode_data();
+    void encode();
+    void decode_data();
+    void decode();
+
+private:
+    QVector<QPair<QString, QByteArray>> corpus;
+};
+
+void tst_bench_QSpirvCompact::initTestCase()
+{
+    QShaderBaker baker;
+    baker.setGeneratedShaderVariants({ QShader::StandardShader });
+    baker.setGeneratedShaders({ { QShader::SpirvShader, QShaderVersion(100) } });
+    QDirIterator it(QLatin1String(":/data"));
+    while (it.hasNext()) {
+        const QString fn = it.next();
+        baker.setSourceFileName(fn);
+        const QShader s = baker.bake();
+        QVERIFY2(s.isValid(), qPrintable(baker.errorMessage()));
+        const QByteArray spirv = s.shader(QShaderKey(QShader::SpirvShader, QShaderVersion(100))).shader();
+        QCOMPARE(QSpirvCompact::decode(QSpirvCompact::encode(spirv)), spirv);
+        corpus.append(qMakePair(it.fileName(), spirv));
+    }
+    QVERIFY(!corpus.isEmpty());
+}
+
+void tst_bench_QSpirvCompact::size_data()
+{
+    QTest::addColumn<QByteArray>("spirv");
+    for (const auto &entry : qAsConst(corpus))
+        QTest::newRow(qPrintable(entry.first)) << entry.second;
+}
+
+// Not a timing benchmark: reports the sizes of the different encodings,
+// with and without zlib on top, for each shader in the corpus.
+void tst_bench_QSpirvCompact::size()
+{
+    QFETCH(QByteArray, spirv);
+
+    const QByteArray compact = QSpirvCompact::encode(spirv);
+    const QByteArray canonical = QSpirvCompact::encode(spirv, QSpirvCompact::Canonicalize);
+    QVERIFY(!compact.isEmpty());
+    QVERIFY(!canonical.isEmpty());
+    QVERIFY(compact.size() < spirv.size());
+
+    qDebug("raw %d (zlib %d), compact %d (zlib %d), canonicalized compact %d (zlib %d)",
+           spirv.size(), qCompress(spirv).size(),
+           compact.size(), qCompress(compact).size(),
+           canonical.size(), qCompress(canonical).size());
+}
+
+void tst_bench_QSpirvCompact::encode_data()
+{
+    size_data();
+}
+
+void tst_bench_QSpirvCompact::encode()
+{
+    QFETCH(QByteArray, spirv);
+
+    QByteArray result;
+    QBENCHMARK {
+        result = QSpirvCompact::encode(spirv);
+    }
+    QVERIFY(!result.isEmpty());
+}
+
+void tst_bench_QSpirvCompact::decode_data()
+{
+    size_data();
+}
+
+void tst_bench_QSpirvCompact::decode()
+{
+    QFETCH(QByteArray, spirv);
+
+    const QByteArray compact = QSpirvCompact::encode(spirv);
+    QByteArray result;
+    QBENCHMARK {
+        result = QSpirvCompact::decode(compact);
+    }
+    QCOMPARE(result, spirv);
+}
+
+#include <tst_bench_qspirvcompact.moc>
+QTEST_MAIN(tst_bench_QSpirvCompact)
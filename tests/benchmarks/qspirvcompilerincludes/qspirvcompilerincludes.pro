@@ -0,0 +1,6 @@
+TARGET = tst_bench_qspirvcompilerincludes
+CONFIG += benchmark
+
+QT += testlib shadertools-private
+
+SOURCES += tst_bench_qspirvcompilerincludes.cpp
@@ -0,0 +1,106 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+
+#include <QtTest/QtTest>
+#include <QtShaderTools/QShaderIncludeBundle>
+#include <QtShaderTools/private/qspirvcompiler_p.h>
+
+class tst_bench_QSpirvCompilerIncludes : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void compile_data();
+    void compile();
+};
+
+// A tree of headers where every level includes the next one twice, via
+// different relative paths, each header carrying a fair amount of code.
+static void addIncludeTree(QShaderIncludeBundle *bundle, const char *guardBegin, const char *guardEnd, int depth)
+{
+    for (int level = 0; level <= depth; ++level) {
+        const QByteArray n = QByteArray::number(level);
+        QByteArray header = QString::fromLatin1(guardBegin).arg(level).toLatin1();
+        for (int i = 0; i < 200; ++i) {
+            const QByteArray f = n + '_' + QByteArray::number(i);
+            header += "// helper " + f + "\n#define SCALE_" + f + " (float(" + QByteArray::number(i) + ") * 0.01)\n"
+                      "float helper_" + f + "(float x) { return x * SCALE_" + f + " + 1.0; }\n";
+        }
+        if (level < depth) {
+            const QByteArray next = QByteArray::number(level + 1);
+            header += "#include \"level" + next + ".glsl\"\n";
+            header += "#include \"../inc/level" + next + ".glsl\"\n";
+            header += "float level" + n + "() { return level" + next + "() * helper_" + n + "_1(0.5); }\n";
+        } else {
+            header += "float level" + n + "() { return 1.0; }\n";
+        }
+        header += QString::fromLatin1(guardEnd).arg(level).toLatin1();
+        bundle->addFile(QLatin1String("inc/level") + QString::number(level) + QLatin1String(".glsl"), header);
+    }
+}
+
+void tst_bench_QSpirvCompilerIncludes::compile_data()
+{
+    QTest::addColumn<QByteArray>("guardBegin");
+    QTest::addColumn<QByteArray>("guardEnd");
+
+    QTest::newRow("ifndef") << QByteArray("#ifndef LEVEL_%1_GLSL\n#define LEVEL_%1_GLSL\n") << QByteArray("#endif\n");
+    QTest::newRow("pragma once") << QByteArray("#pragma once\n") << QByteArray();
+    // not recognized as a guard, so every include is handed to the preprocessor
+    QTest::newRow("unrecognized") << QByteArray("#if !defined(LEVEL_%1_GLSL) && 1\n#define LEVEL_%1_GLSL\n")
+                                  << QByteArray("#endif\n");
+}
+
+void tst_bench_QSpirvCompilerIncludes::compile()
+{
+    QFETCH(QByteArray, guardBegin);
+    QFETCH(QByteArray, guardEnd);
+
+    QShaderIncludeBundle bundle;
+    addIncludeTree(&bundle, guardBegin.constData(), guardEnd.constData(), 8);
+
+    QSpirvCompiler compiler;
+    compiler.setIncludeResolver(&bundle);
+    compiler.setSourceString(QByteArrayLiteral("#version 440\n"
+                                               "#extension GL_GOOGLE_include_directive : enable\n"
+                                               "#include \"level0.glsl\"\n"
+                                               "layout(location = 0) out vec4 fragColor;\n"
+                                               "void main() { fragColor = vec4(level0()); }\n"),
+                             QShader::FragmentStage, QLatin1String("inc/main.frag"));
+
+    QByteArray spirv;
+    QBENCHMARK {
+        spirv = compiler.compileToSpirv();
+    }
+    QVERIFY2(!spirv.isEmpty(), qPrintable(compiler.errorMessage()));
+}
+
+#include <tst_bench_qspirvcompilerincludes.moc>
+QTEST_MAIN(tst_bench_QSpirvCompilerIncludes)
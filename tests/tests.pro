@@ -1,3 +1,3 @@
 TEMPLATE = subdirs
 
-!package: SUBDIRS += auto
+!package: SUBDIRS += auto benchmarks
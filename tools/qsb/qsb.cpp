@@ -30,13 +30,43 @@
 #include <QtCore/qcommandlineparser.h>
 #include <QtCore/qtextstream.h>
 #include <QtCore/qfile.h>
+#include <QtCore/qsavefile.h>
+#include <QtCore/qdatastream.h>
 #include <QtCore/qdir.h>
 #include <QtCore/qtemporarydir.h>
 #include <QtCore/qprocess.h>
+#include <QtCore/qfileinfo.h>
+#include <QtCore/qfilesystemwatcher.h>
+#include <QtCore/qtimer.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qmap.h>
+#include <QtCore/qset.h>
+#include <QtCore/qcryptographichash.h>
+#include <QtCore/qcbormap.h>
+#include <QtCore/qcborvalue.h>
+#include <QtCore/qcborarray.h>
+#include <QtCore/qjsondocument.h>
+#include <QtCore/qjsonobject.h>
+#include <QtCore/qjsonarray.h>
+#include <QtCore/qendian.h>
+#include <QtCore/qthreadpool.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qstandardpaths.h>
+#include <QtCore/qdatetime.h>
+#include <QtCore/qsharedpointer.h>
 #include <QtCore/qdebug.h>
 #include <QtShaderTools/qshaderbaker.h>
+#include <QtShaderTools/private/qshaderbaker_p.h>
+#include <QtShaderTools/private/qspirvshader_p.h>
+#include <QtShaderTools/private/qspirvcompact_p.h>
+#include <QtShaderTools/private/qspirvcompiler_p.h>
+#include <QtShaderTools/private/qshaderpackwriter_p.h>
 #include <QtGui/private/qshader_p_p.h>
 
+#include <algorithm>
+#include <cctype>
+
 static bool writeToFile(const QByteArray &buf, const QString &filename, bool text = false)
 {
     QFile f(filename);
@@ -152,6 +182,24 @@ static QString sourceVariantStr(const QShader::Variant &v)
     }
 }
 
+static QString specConstantTypeStr(QSpirvShader::SpecializationConstant::Type t)
+{
+    switch (t) {
+    case QSpirvShader::SpecializationConstant::Bool:
+        return QLatin1String("bool");
+    case QSpirvShader::SpecializationConstant::Int:
+        return QLatin1String("int");
+    case QSpirvShader::SpecializationConstant::Uint:
+        return QLatin1String("uint");
+    case QSpirvShader::SpecializationConstant::Float:
+        return QLatin1String("float");
+    case QSpirvShader::SpecializationConstant::Double:
+        return QLatin1String("double");
+    default:
+        Q_UNREACHABLE();
+    }
+}
+
 static void dump(const QShader &bs)
 {
     QTextStream ts(stdout);
@@ -168,6 +216,22 @@ static void dump(const QShader &bs)
     }
     ts << "\n";
     ts << "Reflection info: " << bs.description().toJson() << "\n\n";
+    for (const QShaderKey &key : keys) {
+        if (key.source() != QShader::SpirvShader || key.sourceVariant() != QShader::StandardShader)
+            continue;
+        QSpirvShader spirvShader;
+        spirvShader.setSpirvBinary(bs.shader(key).shader());
+        const QVector<QSpirvShader::SpecializationConstant> specConstants = spirvShader.specializationConstants();
+        if (!specConstants.isEmpty()) {
+            ts << "Specialization constants:\n";
+            for (const QSpirvShader::SpecializationConstant &sc : specConstants) {
+                ts << "  constant_id " << sc.constantId << ": " << specConstantTypeStr(sc.type)
+                   << " " << sc.name << " = " << sc.defaultValue.toString() << "\n";
+            }
+            ts << "\n";
+        }
+        break;
+    }
     for (int i = 0; i < keys.count(); ++i) {
         ts << "Shader " << i << ": " << sourceStr(keys[i].source())
             << " " << sourceVersionStr(keys[i].sourceVersion())
@@ -199,7 +263,84 @@ static void dump(const QShader &bs)
     }
 }
 
-static void extract(const QShader &bs, const QString &what, bool batchable, const QString &outfn)
+// Parses the <source>.<version> form used by -x and the usage profiles, for
+// example spirv.100, glsl.300es or hlsl.50.
+static bool parseSourceAndVersion(const QString &what, QShader::Source *src, QShaderVersion *version)
+{
+    const QStringList typeAndVersion = what.split(QLatin1Char('.'), Qt::SkipEmptyParts);
+    if (typeAndVersion.count() != 2)
+        return false;
+
+    if (typeAndVersion[0] == QLatin1String("spirv"))
+        *src = QShader::SpirvShader;
+    else if (typeAndVersion[0] == QLatin1String("glsl"))
+        *src = QShader::GlslShader;
+    else if (typeAndVersion[0] == QLatin1String("hlsl"))
+        *src = QShader::HlslShader;
+    else if (typeAndVersion[0] == QLatin1String("msl"))
+        *src = QShader::MslShader;
+    else if (typeAndVersion[0] == QLatin1String("dxbc"))
+        *src = QShader::DxbcShader;
+    else if (typeAndVersion[0] == QLatin1String("dxil"))
+        *src = QShader::DxilShader;
+    else if (typeAndVersion[0] == QLatin1String("metallib"))
+        *src = QShader::MetalLibShader;
+    else
+        return false;
+
+    QShaderVersion::Flags flags;
+    QString v = typeAndVersion[1];
+    if (v.endsWith(QLatin1String(" es"))) {
+        v = v.left(v.count() - 3);
+        flags |= QShaderVersion::GlslEs;
+    } else if (v.endsWith(QLatin1String("es"))) {
+        v = v.left(v.count() - 2);
+        flags |= QShaderVersion::GlslEs;
+    }
+    bool ok = false;
+    const int ver = v.toInt(&ok);
+    if (!ok)
+        return false;
+
+    *version = QShaderVersion(ver, flags);
+    return true;
+}
+
+static QString sourceAndVersionStr(const QShaderKey &key)
+{
+    QString s;
+    switch (key.source()) {
+    case QShader::SpirvShader:
+        s = QStringLiteral("spirv");
+        break;
+    case QShader::GlslShader:
+        s = QStringLiteral("glsl");
+        break;
+    case QShader::HlslShader:
+        s = QStringLiteral("hlsl");
+        break;
+    case QShader::DxbcShader:
+        s = QStringLiteral("dxbc");
+        break;
+    case QShader::MslShader:
+        s = QStringLiteral("msl");
+        break;
+    case QShader::DxilShader:
+        s = QStringLiteral("dxil");
+        break;
+    case QShader::MetalLibShader:
+        s = QStringLiteral("metallib");
+        break;
+    default:
+        Q_UNREACHABLE();
+    }
+    s += QLatin1Char('.') + QString::number(key.sourceVersion().version());
+    if (key.sourceVersion().flags().testFlag(QShaderVersion::GlslEs))
+        s += QLatin1String("es");
+    return s;
+}
+
+static void extract(const QShader &bs, const QString &what, bool batchable, bool compactSpirv, const QString &outfn)
 {
     if (what == QLatin1String("reflect")) {
         const QByteArray reflect = bs.description().toJson();
@@ -208,43 +349,24 @@ static void extract(const QShader &bs, const QString &what, bool batchable, cons
         return;
     }
 
-    if (what.contains(QLatin1Char('.'))) {
-        const QStringList typeAndVersion = what.split(QLatin1Char('.'), Qt::SkipEmptyParts);
-        QShader::Source src;
-        if (typeAndVersion[0] == QLatin1String("spirv"))
-            src = QShader::SpirvShader;
-        else if (typeAndVersion[0] == QLatin1String("glsl"))
-            src = QShader::GlslShader;
-        else if (typeAndVersion[0] == QLatin1String("hlsl"))
-            src = QShader::HlslShader;
-        else if (typeAndVersion[0] == QLatin1String("msl"))
-            src = QShader::MslShader;
-        else if (typeAndVersion[0] == QLatin1String("dxbc"))
-            src = QShader::DxbcShader;
-        else if (typeAndVersion[0] == QLatin1String("dxil"))
-            src = QShader::DxilShader;
-        else if (typeAndVersion[0] == QLatin1String("metallib"))
-            src = QShader::MetalLibShader;
-        else
-            return;
-
-        QShaderVersion::Flags flags;
-        QString version = typeAndVersion[1];
-        if (version.endsWith(QLatin1String(" es"))) {
-            version = version.left(version.count() - 3);
-            flags |= QShaderVersion::GlslEs;
-        } else if (version.endsWith(QLatin1String("es"))) {
-            version = version.left(version.count() - 2);
-            flags |= QShaderVersion::GlslEs;
-        }
-        const int ver = version.toInt();
+    QShader::Source src;
+    QShaderVersion version;
+    if (parseSourceAndVersion(what, &src, &version)) {
+        const int ver = version.version();
+        const QShaderVersion::Flags flags = version.flags();
 
         const QShader::Variant variant = batchable ? QShader::BatchableVertexShader : QShader::StandardShader;
         const QString variantStr = sourceVariantStr(variant);
 
         const QShaderCode code = bs.shader({ src, { ver, flags }, variant });
         if (!code.shader().isEmpty()) {
-            if (writeToFile(code.shader(), outfn, false)) {
+            QByteArray data = code.shader();
+            if (compactSpirv && src == QShader::SpirvShader) {
+                data = QSpirvCompact::encode(data);
+                if (data.isEmpty())
+                    return;
+            }
+            if (writeToFile(data, outfn, false)) {
                 const QString shaderTypeString = sourceStr(src);
                 qDebug("%s %d%s code (variant %s) written to %s. Entry point is '%s'.",
                        qPrintable(shaderTypeString), ver, flags.testFlag(QShaderVersion::GlslEs) ? " es" : "",
@@ -255,11 +377,11 @@ static void extract(const QShader &bs, const QString &what, bool batchable, cons
     }
 }
 
-static QByteArray fxcProfile(const QShader &bs, const QShaderKey &k)
+static QByteArray fxcProfile(QShader::Stage stage, const QShaderKey &k)
 {
     QByteArray t;
 
-    switch (bs.stage()) {
+    switch (stage) {
     case QShader::VertexStage:
         t += QByteArrayLiteral("vs_");
         break;
@@ -291,313 +413,2165 @@ static QByteArray fxcProfile(const QShader &bs, const QShaderKey &k)
     return t;
 }
 
-int main(int argc, char **argv)
+// External tools used for --fxc and --metallib. The commands are templates,
+// with {entry}, {profile}, {input} and {output} replaced for each run, so
+// that a different tool, or a stand-in when testing, can be used.
+struct ToolSettings
 {
-    QCoreApplication app(argc, argv);
+    QString fxcCommand = QStringLiteral("fxc /nologo /E {entry} /T {profile} /Fo {output} {input}");
+    QString metalCommand = QStringLiteral("xcrun -sdk macosx metal -c {input} -o {output}");
+    QString metallibCommand = QStringLiteral("xcrun -sdk macosx metallib {input} -o {output}");
+    QString cacheDir;
+    int jobs = 0; // QThread::idealThreadCount() when 0
+};
 
-    QCommandLineParser cmdLineParser;
-    const QString appDesc = QString::asprintf("Qt Shader Baker (using QShader from Qt %s)", qVersion());
-    cmdLineParser.setApplicationDescription(appDesc);
-    app.setApplicationVersion(QLatin1String(QT_VERSION_STR));
-    cmdLineParser.addHelpOption();
-    cmdLineParser.addVersionOption();
-    cmdLineParser.addPositionalArgument(QLatin1String("file"), QObject::tr("Vulkan GLSL source file to compile"), QObject::tr("file"));
-    QCommandLineOption batchableOption({ "b", "batchable" }, QObject::tr("Also generates rewritten vertex shader for Qt Quick scene graph batching."));
-    cmdLineParser.addOption(batchableOption);
-    QCommandLineOption batchLocOption("zorder-loc",
-                                      QObject::tr("The extra vertex input location when rewriting for batching. Defaults to 7."),
-                                      QObject::tr("location"));
-    cmdLineParser.addOption(batchLocOption);
-    QCommandLineOption glslOption({ "g", "glsl" },
-                                  QObject::tr("Comma separated list of GLSL versions to generate. (for example, \"100 es,120,330\")"),
-                                  QObject::tr("versions"));
-    cmdLineParser.addOption(glslOption);
-    QCommandLineOption hlslOption({ "l", "hlsl" },
-                                  QObject::tr("Comma separated list of HLSL (Shader Model) versions to generate. F.ex. 50 is 5.0, 51 is 5.1."),
-                                  QObject::tr("versions"));
-    cmdLineParser.addOption(hlslOption);
-    QCommandLineOption mslOption({ "m", "msl" },
-                                  QObject::tr("Comma separated list of Metal Shading Language versions to generate. F.ex. 12 is 1.2, 20 is 2.0."),
-                                  QObject::tr("versions"));
-    cmdLineParser.addOption(mslOption);
-    QCommandLineOption outputOption({ "o", "output" },
-                                     QObject::tr("Output file for the shader pack."),
-                                     QObject::tr("filename"));
-    cmdLineParser.addOption(outputOption);
-    QCommandLineOption fxcOption({ "c", "fxc" }, QObject::tr("In combination with --hlsl invokes fxc to store DXBC instead of HLSL."));
-    cmdLineParser.addOption(fxcOption);
-    QCommandLineOption mtllibOption({ "t", "metallib" },
-                                    QObject::tr("In combination with --msl builds a Metal library with xcrun metal(lib) and stores that instead of the source."));
-    cmdLineParser.addOption(mtllibOption);
-    QCommandLineOption defineOption({ "D", "define" }, QObject::tr("Define macro"), QObject::tr("name[=value]"));
-    cmdLineParser.addOption(defineOption);
-    QCommandLineOption dumpOption({ "d", "dump" }, QObject::tr("Switches to dump mode. Input file is expected to be a shader pack."));
-    cmdLineParser.addOption(dumpOption);
-    QCommandLineOption extractOption({ "x", "extract" }, QObject::tr("Switches to extract mode. Input file is expected to be a shader pack. "
-                                                                     "Result is written to the output specified by -o. Pass -b to choose the batchable variant. "
-                                                                     "<what>=reflect|spirv.<version>|glsl.<version>|..."),
-                                     QObject::tr("what"));
-    cmdLineParser.addOption(extractOption);
+static bool runTool(const QString &cmdTemplate, const QByteArray &entryPoint, const QByteArray &profile,
+                    const QString &input, const QString &output)
+{
+    QString cmd = cmdTemplate;
+    cmd.replace(QLatin1String("{entry}"), QString::fromUtf8(entryPoint));
+    cmd.replace(QLatin1String("{profile}"), QString::fromUtf8(profile));
+    cmd.replace(QLatin1String("{input}"), QDir::toNativeSeparators(input));
+    cmd.replace(QLatin1String("{output}"), QDir::toNativeSeparators(output));
+    qDebug("%s", qPrintable(cmd));
+    QByteArray stdOut;
+    QByteArray errorOutput;
+    const bool success = runProcess(cmd, &stdOut, &errorOutput);
+    if (!success) {
+        if (!stdOut.isEmpty() || !errorOutput.isEmpty()) {
+            qDebug("%s\n%s",
+                   qPrintable(stdOut.constData()),
+                   qPrintable(errorOutput.constData()));
+        }
+    }
+    return success;
+}
 
-    cmdLineParser.process(app);
+// The output of running a tool just to ask for its version, or nothing when
+// it cannot be run. Only used as part of a cache key, so the exit code does
+// not matter.
+static QByteArray probeTool(const QString &program, const QStringList &arguments)
+{
+    QProcess p;
+    p.start(program, arguments);
+    if (!p.waitForFinished() || p.exitStatus() != QProcess::NormalExit)
+        return QByteArray();
+    return p.readAllStandardOutput() + p.readAllStandardError();
+}
 
-    if (cmdLineParser.positionalArguments().isEmpty()) {
-        cmdLineParser.showHelp();
-        return 0;
-    }
+static QByteArray fileIdentity(const QString &fileName)
+{
+    const QFileInfo fi(fileName);
+    if (!fi.exists())
+        return QByteArray();
+    return fi.absoluteFilePath().toUtf8()
+            + '\n' + QByteArray::number(fi.size())
+            + '\n' + QByteArray::number(fi.lastModified().toMSecsSinceEpoch());
+}
 
-    QShaderBaker baker;
-    for (const QString &fn : cmdLineParser.positionalArguments()) {
-        if (cmdLineParser.isSet(dumpOption) || cmdLineParser.isSet(extractOption)) {
-            QByteArray buf = readFile(fn);
-            if (!buf.isEmpty()) {
-                QShader bs = QShader::fromSerialized(buf);
-                if (bs.isValid()) {
-                    if (cmdLineParser.isSet(dumpOption)) {
-                        dump(bs);
-                    } else {
-                        if (cmdLineParser.isSet(outputOption)) {
-                            extract(bs, cmdLineParser.value(extractOption), cmdLineParser.isSet(batchableOption),
-                                    cmdLineParser.value(outputOption));
-                        } else {
-                            qWarning("No output file specified");
-                        }
-                    }
-                } else {
-                    qWarning("Failed to deserialize %s", qPrintable(fn));
-                }
+// What identifies the version of the tool a command runs: the executable
+// found in PATH, its size and modification time. xcrun is only a shim that
+// stays the same when Xcode is updated, so for xcrun it is the tool xcrun
+// finds, and its --version output. For fxc the banner of fxc /? is added,
+// which tells the version of the D3DCompiler DLL that does the work.
+// Evaluated once per command.
+static QByteArray toolIdentity(const QString &cmdTemplate)
+{
+    static QMutex mutex;
+    static QHash<QString, QByteArray> identities;
+    QMutexLocker lock(&mutex);
+    auto it = identities.constFind(cmdTemplate);
+    if (it != identities.cend())
+        return *it;
+
+    QByteArray identity = cmdTemplate.toUtf8();
+    const QStringList args = QProcess::splitCommand(cmdTemplate);
+    if (!args.isEmpty()) {
+        const QString program = QStandardPaths::findExecutable(args.first());
+        identity += '\n' + fileIdentity(program);
+        const QString name = QFileInfo(args.first()).completeBaseName().toLower();
+        if (name == QLatin1String("xcrun") && !program.isEmpty()) {
+            // xcrun [-sdk <sdk>] <tool> ...
+            QStringList sdk;
+            int i = 1;
+            if (i + 1 < args.count() && args[i] == QLatin1String("-sdk")) {
+                sdk << args[i] << args[i + 1];
+                i += 2;
             }
-            continue;
+            if (i < args.count()) {
+                const QString tool = args[i];
+                const QByteArray toolPath = probeTool(program, sdk + QStringList { QLatin1String("--find"), tool });
+                identity += '\n' + fileIdentity(QString::fromLocal8Bit(toolPath.trimmed()));
+                identity += '\n' + probeTool(program, sdk + QStringList { tool, QLatin1String("--version") });
+            }
+        } else if (name == QLatin1String("fxc") && !program.isEmpty()) {
+            identity += '\n' + probeTool(program, { QLatin1String("/?") });
         }
+    }
+    identities.insert(cmdTemplate, identity);
+    return identity;
+}
 
-        baker.setSourceFileName(fn);
+// Results of the external tools are cached in a directory, keyed by the
+// exact input text, the profile and entry point, and the tools and their
+// versions. Entries are written atomically, so multiple qsb processes can
+// share the directory.
+static QString toolCacheFile(const ToolSettings &tools, const QStringList &commands, const QByteArray &source,
+                             const QByteArray &entryPoint, const QByteArray &profile)
+{
+    if (tools.cacheDir.isEmpty())
+        return QString();
 
-        QVector<QShader::Variant> variants;
-        variants << QShader::StandardShader;
-        if (cmdLineParser.isSet(batchableOption)) {
-            variants << QShader::BatchableVertexShader;
-            if (cmdLineParser.isSet(batchLocOption))
-                baker.setBatchableVertexShaderExtraInputLocation(cmdLineParser.value(batchLocOption).toInt());
-        }
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    for (const QString &cmd : commands) {
+        hash.addData(toolIdentity(cmd));
+        hash.addData("\0", 1);
+    }
+    hash.addData(entryPoint);
+    hash.addData("\0", 1);
+    hash.addData(profile);
+    hash.addData("\0", 1);
+    hash.addData(source);
+    return QDir(tools.cacheDir).filePath(QString::fromLatin1(hash.result().toHex()));
+}
 
-        baker.setGeneratedShaderVariants(variants);
+static bool readToolCache(const QString &cacheFile, QByteArray *bytecode)
+{
+    if (cacheFile.isEmpty())
+        return false;
+    QFile f(cacheFile);
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+    *bytecode = f.readAll();
+    return true;
+}
 
-        QVector<QShaderBaker::GeneratedShader> genShaders;
+static void writeToolCache(const QString &cacheFile, const QByteArray &bytecode)
+{
+    if (cacheFile.isEmpty())
+        return;
+    QSaveFile f(cacheFile);
+    if (!f.open(QIODevice::WriteOnly) || f.write(bytecode) != bytecode.size() || !f.commit())
+        qWarning("Failed to write %s", qPrintable(cacheFile));
+}
 
-        genShaders << qMakePair(QShader::SpirvShader, QShaderVersion(100));
+static bool compileHlslToDxbc(QShader::Stage stage, const QShaderKey &key, const QShaderCode &hlsl,
+                              QByteArray *bytecode, const ToolSettings &tools)
+{
+    const QByteArray typeArg = fxcProfile(stage, key);
+    const QByteArray entryPoint = hlsl.entryPoint();
+    const QString cacheFile = toolCacheFile(tools, { tools.fxcCommand }, hlsl.shader(), entryPoint, typeArg);
+    if (readToolCache(cacheFile, bytecode))
+        return true;
 
-        if (cmdLineParser.isSet(glslOption)) {
-            const QStringList versions = cmdLineParser.value(glslOption).trimmed().split(',');
-            for (QString version : versions) {
-                QShaderVersion::Flags flags;
-                if (version.endsWith(QLatin1String(" es"))) {
-                    version = version.left(version.count() - 3);
-                    flags |= QShaderVersion::GlslEs;
-                } else if (version.endsWith(QLatin1String("es"))) {
-                    version = version.left(version.count() - 2);
-                    flags |= QShaderVersion::GlslEs;
-                }
-                bool ok = false;
-                int v = version.toInt(&ok);
-                if (ok)
-                    genShaders << qMakePair(QShader::GlslShader, QShaderVersion(v, flags));
-                else
-                    qWarning("Ignoring invalid GLSL version %s", qPrintable(version));
-            }
-        }
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid()) {
+        qWarning("Failed to create temporary directory");
+        return false;
+    }
 
-        if (cmdLineParser.isSet(hlslOption)) {
-            const QStringList versions = cmdLineParser.value(hlslOption).trimmed().split(',');
-            for (QString version : versions) {
-                bool ok = false;
-                int v = version.toInt(&ok);
-                if (ok)
-                    genShaders << qMakePair(QShader::HlslShader, QShaderVersion(v));
-                else
-                    qWarning("Ignoring invalid HLSL (Shader Model) version %s", qPrintable(version));
-            }
-        }
+    const QString tmpIn = tempDir.path() + QLatin1String("/qsb_hlsl_temp");
+    const QString tmpOut = tempDir.path() + QLatin1String("/qsb_hlsl_temp_out");
+    QFile f(tmpIn);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qWarning("Failed to create temporary file");
+        return false;
+    }
+    f.write(hlsl.shader());
+    f.close();
 
-        if (cmdLineParser.isSet(mslOption)) {
-            const QStringList versions = cmdLineParser.value(mslOption).trimmed().split(',');
-            for (QString version : versions) {
-                bool ok = false;
-                int v = version.toInt(&ok);
-                if (ok)
-                    genShaders << qMakePair(QShader::MslShader, QShaderVersion(v));
-                else
-                    qWarning("Ignoring invalid MSL version %s", qPrintable(version));
-            }
-        }
+    if (!runTool(tools.fxcCommand, entryPoint, typeArg, tmpIn, tmpOut))
+        return false;
 
-        baker.setGeneratedShaders(genShaders);
+    f.setFileName(tmpOut);
+    if (!f.open(QIODevice::ReadOnly)) {
+        qWarning("Failed to open fxc output %s", qPrintable(tmpOut));
+        return false;
+    }
+    *bytecode = f.readAll();
+    writeToolCache(cacheFile, *bytecode);
+    return true;
+}
 
-        if (cmdLineParser.isSet(defineOption)) {
-            QByteArray preamble;
-            const QStringList defines = cmdLineParser.values(defineOption);
-            for (const QString &def : defines) {
-                const QStringList defs = def.split(QLatin1Char('='), QString::SkipEmptyParts);
-                if (!defs.isEmpty()) {
-                    preamble.append("#define");
-                    for (const QString &s : defs) {
-                        preamble.append(' ');
-                        preamble.append(s.toUtf8());
-                    }
-                    preamble.append('\n');
-                }
-            }
-            baker.setPreamble(preamble);
-        }
+static bool compileMslToMetalLib(const QShaderCode &msl, QByteArray *bytecode, const ToolSettings &tools)
+{
+    const QString cacheFile = toolCacheFile(tools, { tools.metalCommand, tools.metallibCommand },
+                                            msl.shader(), msl.entryPoint(), QByteArray());
+    if (readToolCache(cacheFile, bytecode))
+        return true;
 
-        QShader bs = baker.bake();
-        if (!bs.isValid()) {
-            qWarning("Shader baking failed: %s", qPrintable(baker.errorMessage()));
-            return 1;
-        }
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid()) {
+        qWarning("Failed to create temporary directory");
+        return false;
+    }
 
-        if (cmdLineParser.isSet(fxcOption)) {
-            QTemporaryDir tempDir;
-            if (!tempDir.isValid()) {
-                qWarning("Failed to create temporary directory");
-                return 1;
-            }
-            auto skeys = bs.availableShaders();
-            for (QShaderKey &k : skeys) {
-                if (k.source() == QShader::HlslShader) {
-                    QShaderCode s = bs.shader(k);
-
-                    const QString tmpIn = tempDir.path() + QLatin1String("/qsb_hlsl_temp");
-                    const QString tmpOut = tempDir.path() + QLatin1String("/qsb_hlsl_temp_out");
-                    QFile f(tmpIn);
-                    if (!f.open(QIODevice::WriteOnly | QIODevice::Text)) {
-                        qWarning("Failed to create temporary file");
-                        return 1;
-                    }
-                    f.write(s.shader());
-                    f.close();
-
-                    const QByteArray tempOutFileName = QDir::toNativeSeparators(tmpOut).toUtf8();
-                    const QByteArray inFileName = QDir::toNativeSeparators(tmpIn).toUtf8();
-                    const QByteArray typeArg = fxcProfile(bs, k);
-                    const QByteArray entryPoint = s.entryPoint();
-                    const QString cmd = QString::asprintf("fxc /nologo /E %s /T %s /Fo %s %s",
-                                                          entryPoint.constData(),
-                                                          typeArg.constData(),
-                                                          tempOutFileName.constData(),
-                                                          inFileName.constData());
-                    qDebug("%s", qPrintable(cmd));
-                    QByteArray output;
-                    QByteArray errorOutput;
-                    bool success = runProcess(cmd, &output, &errorOutput);
-                    if (!success) {
-                        if (!output.isEmpty() || !errorOutput.isEmpty()) {
-                            qDebug("%s\n%s",
-                                   qPrintable(output.constData()),
-                                   qPrintable(errorOutput.constData()));
-                        }
-                        return 1;
-                    }
-                    f.setFileName(tmpOut);
-                    if (!f.open(QIODevice::ReadOnly)) {
-                        qWarning("Failed to open fxc output %s", qPrintable(tmpOut));
-                        return 1;
-                    }
-                    const QByteArray bytecode = f.readAll();
-                    f.close();
-
-                    QShaderKey dxbcKey = k;
-                    dxbcKey.setSource(QShader::DxbcShader);
-                    QShaderCode dxbcShader(bytecode, s.entryPoint());
-                    bs.setShader(dxbcKey, dxbcShader);
-                    if (const QShader::NativeResourceBindingMap *map = bs.nativeResourceBindingMap(k))
-                        bs.setResourceBindingMap(dxbcKey, *map);
-                    bs.removeShader(k);
-                }
-            }
-        }
+    const QString tmpIn = tempDir.path() + QLatin1String("/qsb_msl_temp.metal");
+    const QString tmpInterm = tempDir.path() + QLatin1String("/qsb_msl_temp_air");
+    const QString tmpOut = tempDir.path() + QLatin1String("/qsb_msl_temp_out");
+    QFile f(tmpIn);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qWarning("Failed to create temporary file");
+        return false;
+    }
+    f.write(msl.shader());
+    f.close();
 
-        if (cmdLineParser.isSet(mtllibOption)) {
-            QTemporaryDir tempDir;
-            if (!tempDir.isValid()) {
-                qWarning("Failed to create temporary directory");
-                return 1;
-            }
-            auto skeys = bs.availableShaders();
-            for (const QShaderKey &k : skeys) {
-                if (k.source() == QShader::MslShader) {
-                    QShaderCode s = bs.shader(k);
-
-                    const QString tmpIn = tempDir.path() + QLatin1String("/qsb_msl_temp.metal");
-                    const QString tmpInterm = tempDir.path() + QLatin1String("/qsb_msl_temp_air");
-                    const QString tmpOut = tempDir.path() + QLatin1String("/qsb_msl_temp_out");
-                    QFile f(tmpIn);
-                    if (!f.open(QIODevice::WriteOnly | QIODevice::Text)) {
-                        qWarning("Failed to create temporary file");
-                        return 1;
-                    }
-                    f.write(s.shader());
-                    f.close();
-
-                    const QByteArray inFileName = QDir::toNativeSeparators(tmpIn).toUtf8();
-                    const QByteArray tempIntermediateFileName = QDir::toNativeSeparators(tmpInterm).toUtf8();
-                    qDebug("About to invoke xcrun with metal and metallib.\n"
-                           "  qsb is set up for XCode 10. For earlier versions the -c argument may need to be removed.\n"
-                           "  If getting unable to find utility \"metal\", do xcode-select --switch /Applications/Xcode.app/Contents/Developer");
-                    QString cmd = QString::asprintf("xcrun -sdk macosx metal -c %s -o %s",
-                                                    inFileName.constData(),
-                                                    tempIntermediateFileName.constData());
-                    qDebug("%s", qPrintable(cmd));
-                    QByteArray output;
-                    QByteArray errorOutput;
-                    bool success = runProcess(cmd, &output, &errorOutput);
-                    if (!success) {
-                        if (!output.isEmpty() || !errorOutput.isEmpty()) {
-                            qDebug("%s\n%s",
-                                   qPrintable(output.constData()),
-                                   qPrintable(errorOutput.constData()));
-                        }
-                        return 1;
-                    }
+    static QBasicAtomicInt hintShown = Q_BASIC_ATOMIC_INITIALIZER(0);
+    if (hintShown.testAndSetRelaxed(0, 1)) {
+        qDebug("About to invoke xcrun with metal and metallib.\n"
+               "  qsb is set up for XCode 10. For earlier versions the -c argument may need to be removed.\n"
+               "  If getting unable to find utility \"metal\", do xcode-select --switch /Applications/Xcode.app/Contents/Developer");
+    }
+    if (!runTool(tools.metalCommand, msl.entryPoint(), QByteArray(), tmpIn, tmpInterm))
+        return false;
+    if (!runTool(tools.metallibCommand, msl.entryPoint(), QByteArray(), tmpInterm, tmpOut))
+        return false;
 
-                    const QByteArray tempOutFileName = QDir::toNativeSeparators(tmpOut).toUtf8();
-                    cmd = QString::asprintf("xcrun -sdk macosx metallib %s -o %s",
-                                            tempIntermediateFileName.constData(),
-                                            tempOutFileName.constData());
-                    qDebug("%s", qPrintable(cmd));
-                    output.clear();
-                    errorOutput.clear();
-                    success = runProcess(cmd, &output, &errorOutput);
-                    if (!success) {
-                        if (!output.isEmpty() || !errorOutput.isEmpty()) {
-                            qDebug("%s\n%s",
-                                   qPrintable(output.constData()),
-                                   qPrintable(errorOutput.constData()));
-                        }
-                        return 1;
-                    }
+    f.setFileName(tmpOut);
+    if (!f.open(QIODevice::ReadOnly)) {
+        qWarning("Failed to open xcrun metallib output %s", qPrintable(tmpOut));
+        return false;
+    }
+    *bytecode = f.readAll();
+    writeToolCache(cacheFile, *bytecode);
+    return true;
+}
 
-                    f.setFileName(tmpOut);
-                    if (!f.open(QIODevice::ReadOnly)) {
-                        qWarning("Failed to open xcrun metallib output %s", qPrintable(tmpOut));
-                        return 1;
-                    }
-                    const QByteArray bytecode = f.readAll();
-                    f.close();
-
-                    QShaderKey mtlKey = k;
-                    mtlKey.setSource(QShader::MetalLibShader);
-                    QShaderCode mtlShader(bytecode, s.entryPoint());
-                    bs.setShader(mtlKey, mtlShader);
-                    if (const QShader::NativeResourceBindingMap *map = bs.nativeResourceBindingMap(k))
-                        bs.setResourceBindingMap(mtlKey, *map);
-                    bs.removeShader(k);
-                }
-            }
+struct BakeSettings
+{
+    QVector<QShader::Variant> variants;
+    int batchLoc = -1;
+    QVector<QShaderBaker::GeneratedShader> genShaders;
+    QByteArray preamble;
+    QHash<int, QVariant> specConstants;
+    bool fxc = false;
+    bool metallib = false;
+    QString outputFileName;
+    int compressionLevel = -1; // zlib default
+    bool force = false;
+    ToolSettings tools;
+};
+
+// Everything but the source that affects the contents of a pack. The
+// preamble is not included, its effect shows up in the preprocessed source.
+static QByteArray settingsSignature(const BakeSettings &settings)
+{
+    QByteArray buf;
+    QDataStream ds(&buf, QIODevice::WriteOnly);
+    ds.setVersion(QDataStream::Qt_5_10);
+    ds << QByteArray(QT_VERSION_STR) << QByteArray(qVersion());
+    ds << int(settings.variants.count());
+    for (QShader::Variant v : settings.variants)
+        ds << int(v);
+    ds << settings.batchLoc;
+    ds << int(settings.genShaders.count());
+    for (const QShaderBaker::GeneratedShader &gs : settings.genShaders)
+        ds << int(gs.first) << gs.second.version() << int(gs.second.flags());
+    QList<int> specIds = settings.specConstants.keys();
+    std::sort(specIds.begin(), specIds.end());
+    for (int id : qAsConst(specIds))
+        ds << id << settings.specConstants.value(id).toString();
+    ds << settings.fxc << settings.metallib << settings.compressionLevel;
+    if (settings.fxc)
+        ds << toolIdentity(settings.tools.fxcCommand);
+    if (settings.metallib)
+        ds << toolIdentity(settings.tools.metalCommand) << toolIdentity(settings.tools.metallibCommand);
+    return QCryptographicHash::hash(buf, QCryptographicHash::Sha256);
+}
+
+// qsb keeps some data of its own after the end of the compressed pack, where
+// QShader does not look: a CBOR map, its size as a 32-bit little endian
+// integer, and a magic. This trailer is qsb's own extension of the format,
+// nothing else reads or writes it. Every pack written by qsb has one. The
+// packs baked from a source file have:
+//
+//   "fingerprint"  inputFingerprint() of the source and the includes
+//   "includes"     the files the source included
+//   "macros"       the preamble macros the source referred to
+//   "sourceHash"   QSpirvCompiler::normalizedSourceHash(), once computed
+//   "settings"     settingsSignature()
+//   "specIds"      the constant_ids that got specialized
+//
+// The packs written by the other modes have only "mode" instead, telling
+// which one it was ("pipeline", "prune", "retarget", "merge", "strip",
+// "split"). A bake into such a file is never skipped.
+static const char PACK_TRAILER_MAGIC[4] = { 'Q', 'S', 'B', 'T' };
+
+// Returns the position of the trailer in f, or -1 when there is none.
+static qint64 packTrailerPos(QFile *f)
+{
+    if (f->size() < 8 || !f->seek(f->size() - 8))
+        return -1;
+
+    const QByteArray tail = f->read(8);
+    if (tail.size() != 8 || memcmp(tail.constData() + 4, PACK_TRAILER_MAGIC, 4))
+        return -1;
+
+    const quint32 size = qFromLittleEndian<quint32>(tail.constData());
+    if (size > f->size() - 8)
+        return -1;
+
+    return f->size() - 8 - size;
+}
+
+static QCborMap readPackTrailer(const QString &fn)
+{
+    QFile f(fn);
+    if (!f.open(QIODevice::ReadOnly))
+        return QCborMap();
+
+    const qint64 pos = packTrailerPos(&f);
+    if (pos < 0 || !f.seek(pos))
+        return QCborMap();
+
+    return QCborValue::fromCbor(f.read(f.size() - 8 - pos)).toMap();
+}
+
+static bool writePackTrailer(QIODevice *dev, const QCborMap &trailer)
+{
+    const QByteArray data = trailer.toCborValue().toCbor();
+    char tail[8];
+    qToLittleEndian<quint32>(quint32(data.size()), tail);
+    memcpy(tail + 4, PACK_TRAILER_MAGIC, 4);
+    return dev->write(data) == data.size() && dev->write(tail, 8) == 8;
+}
+
+// Replaces the trailer of an existing pack in place. The modification time
+// is kept, the pack itself does not change, so nothing that depends on it
+// needs to be rebuilt.
+static bool replacePackTrailer(const QString &fn, const QCborMap &trailer)
+{
+    QFile f(fn);
+    if (!f.open(QIODevice::ReadWrite))
+        return false;
+
+    const QDateTime modified = f.fileTime(QFileDevice::FileModificationTime);
+    const qint64 pos = packTrailerPos(&f);
+    if (pos < 0 || !f.resize(pos) || !f.seek(pos) || !writePackTrailer(&f, trailer) || !f.flush())
+        return false;
+
+    return f.setFileTime(modified, QFileDevice::FileModificationTime);
+}
+
+// A hash of the exact contents of the source, the files it included the
+// last time, the preamble, and the settings. Unlike sourceHash(), this needs
+// no preprocessing, only reading the files.
+static QByteArray inputFingerprint(const QString &fn, const QStringList &includedFiles, const BakeSettings &settings)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(settingsSignature(settings));
+    hash.addData(settings.preamble);
+    hash.addData("\0", 1);
+    QStringList files = includedFiles;
+    files.prepend(fn);
+    for (const QString &file : qAsConst(files)) {
+        QFile f(file);
+        if (!f.open(QIODevice::ReadOnly))
+            return QByteArray();
+        hash.addData(file.toUtf8());
+        hash.addData("\0", 1);
+        hash.addData(QByteArray::number(f.size()));
+        hash.addData("\0", 1);
+        if (!hash.addData(&f))
+            return QByteArray();
+    }
+    return hash.result();
+}
+
+// Writes a pack atomically via QSaveFile, while comparing what gets written
+// with what the existing file has at the same position. When the result is
+// identical, the existing file is left alone, so that its timestamp, which
+// later build steps (rcc, for example) depend on, does not change.
+class PackOutputDevice : public QIODevice
+{
+public:
+    explicit PackOutputDevice(const QString &fileName)
+        : file(fileName),
+          existing(fileName)
+    { }
+
+    bool open(OpenMode mode) override;
+    bool seek(qint64 pos) override;
+    bool commit();
+    bool isUnchanged() const { return identical && end == existingSize; }
+
+protected:
+    qint64 readData(char *, qint64) override { return -1; }
+    qint64 writeData(const char *data, qint64 len) override;
+
+private:
+    QSaveFile file;
+    QFile existing;
+    qint64 existingSize = -1;
+    qint64 end = 0;
+    bool identical = false;
+};
+
+bool PackOutputDevice::open(OpenMode mode)
+{
+    if (!file.open(QIODevice::WriteOnly)) {
+        setErrorString(file.errorString());
+        return false;
+    }
+    identical = existing.open(QIODevice::ReadOnly);
+    if (identical)
+        existingSize = existing.size();
+    return QIODevice::open(mode | QIODevice::Unbuffered);
+}
+
+bool PackOutputDevice::seek(qint64 pos)
+{
+    return QIODevice::seek(pos) && file.seek(pos);
+}
+
+qint64 PackOutputDevice::writeData(const char *data, qint64 len)
+{
+    const qint64 p = pos();
+    if (identical) {
+        if (p + len > existingSize || !existing.seek(p)) {
+            identical = false;
+        } else {
+            const QByteArray old = existing.read(len);
+            identical = old.size() == len && !memcmp(old.constData(), data, size_t(len));
         }
+    }
+    const qint64 written = file.write(data, len);
+    if (written < 0)
+        setErrorString(file.errorString());
+    else
+        end = qMax(end, p + written);
+    return written;
+}
+
+bool PackOutputDevice::commit()
+{
+    close();
+    if (isUnchanged()) {
+        file.cancelWriting(); // the temporary file is removed
+        return true;
+    }
+    existing.close();
+    return file.commit();
+}
+
+// A hash of the input that does not change with whitespace, comments, and
+// inactive #if blocks in the source.
+static QByteArray sourceHash(const QString &fn, const BakeSettings &settings,
+                             QStringList *includedFiles, QByteArrayList *referencedMacros)
+{
+    if (QFileInfo(fn).suffix() == QStringLiteral("spv")) {
+        QFile f(fn);
+        if (!f.open(QIODevice::ReadOnly))
+            return QByteArray();
+        QCryptographicHash hash(QCryptographicHash::Sha256);
+        hash.addData(&f);
+        return hash.result();
+    }
+
+    QSpirvCompiler compiler;
+    compiler.setSourceFileName(fn);
+    compiler.setPreamble(settings.preamble);
+    const QByteArray result = compiler.normalizedSourceHash();
+    *includedFiles = compiler.includedFiles();
+    *referencedMacros = compiler.referencedPreambleMacros();
+    return result;
+}
 
-        if (cmdLineParser.isSet(outputOption))
-            writeToFile(bs.serialized(), cmdLineParser.value(outputOption));
+static void applySettings(QShaderBaker *baker, const BakeSettings &settings)
+{
+    baker->setGeneratedShaderVariants(settings.variants);
+    if (settings.batchLoc >= 0)
+        baker->setBatchableVertexShaderExtraInputLocation(settings.batchLoc);
+    baker->setGeneratedShaders(settings.genShaders);
+    baker->setPreamble(settings.preamble);
+    baker->setSpecializationConstants(settings.specConstants);
+}
+
+static bool needsTool(const QShaderKey &key, const BakeSettings &settings)
+{
+    return (settings.fxc && key.source() == QShader::HlslShader)
+            || (settings.metallib && key.source() == QShader::MslShader);
+}
+
+// HLSL is replaced by DXBC, and MSL by a Metal library, when requested.
+static bool processShader(QShader::Stage stage, QShaderKey *key, QShaderCode *shader, const BakeSettings &settings)
+{
+    QByteArray bytecode;
+    if (settings.fxc && key->source() == QShader::HlslShader) {
+        if (!compileHlslToDxbc(stage, *key, *shader, &bytecode, settings.tools))
+            return false;
+        key->setSource(QShader::DxbcShader);
+        shader->setShader(bytecode);
+    } else if (settings.metallib && key->source() == QShader::MslShader) {
+        if (!compileMslToMetalLib(*shader, &bytecode, settings.tools))
+            return false;
+        key->setSource(QShader::MetalLibShader);
+        shader->setShader(bytecode);
+    }
+    return true;
+}
+
+// Gets the shaders from QShaderBaker one by one and writes them out right
+// away, so a pack is never held in memory as a whole. The exception are the
+// shaders that go through an external tool: those run on a thread pool, and
+// from the first of them on the shaders are kept until finish(), so that the
+// pack lists them in the same order as without the tools.
+class PackSink : public QShaderBakerSink
+{
+public:
+    PackSink(QShaderPackWriter *writer, const BakeSettings &settings)
+        : writer(writer), settings(settings)
+    {
+        if (settings.tools.jobs > 0)
+            pool.setMaxThreadCount(settings.tools.jobs);
+    }
+
+    ~PackSink()
+    {
+        pool.waitForDone();
+    }
+
+    bool begin(QShader::Stage stage, const QShaderDescription &description,
+               const QVector<QShaderKey> &keys) override
+    {
+        this->stage = stage;
+        return !writer || writer->begin(stage, description, keys.count());
+    }
+
+    bool addShader(const QShaderKey &key, const QShaderCode &shader,
+                   const QShader::NativeResourceBindingMap *nativeBindings) override
+    {
+        Entry entry;
+        entry.key = key;
+        entry.code = shader;
+        if (nativeBindings) {
+            entry.hasNativeBindings = true;
+            entry.nativeBindings = *nativeBindings;
+        }
+
+        if (needsTool(key, settings)) {
+            entry.job.reset(new ToolJob(stage, entry.key, entry.code, settings));
+            pool.start(entry.job.data());
+        } else if (pending.isEmpty()) {
+            return write(entry);
+        }
+        pending.append(entry);
+        return true;
+    }
+
+    bool finish()
+    {
+        pool.waitForDone();
+        bool ok = true;
+        for (Entry &entry : pending) {
+            if (entry.job) {
+                if (!entry.job->ok) {
+                    qWarning("Failed to process shader %s", qPrintable(sourceAndVersionStr(entry.key)));
+                    ok = false;
+                    continue;
+                }
+                entry.key = entry.job->key;
+                entry.code = entry.job->code;
+            }
+            if (ok)
+                ok = write(entry);
+        }
+        pending.clear();
+        return ok;
+    }
+
+private:
+    struct ToolJob : public QRunnable
+    {
+        ToolJob(QShader::Stage stage, const QShaderKey &key, const QShaderCode &code, const BakeSettings &settings)
+            : stage(stage), key(key), code(code), settings(settings)
+        {
+            setAutoDelete(false);
+        }
+        void run() override
+        {
+            ok = processShader(stage, &key, &code, settings);
+        }
+        QShader::Stage stage;
+        QShaderKey key;
+        QShaderCode code;
+        const BakeSettings &settings;
+        bool ok = false;
+    };
+
+    struct Entry
+    {
+        QShaderKey key;
+        QShaderCode code;
+        bool hasNativeBindings = false;
+        QShader::NativeResourceBindingMap nativeBindings;
+        QSharedPointer<ToolJob> job;
+    };
+
+    bool write(const Entry &entry)
+    {
+        if (!writer)
+            return true;
+        if (!writer->addShader(entry.key, entry.code))
+            return false;
+        if (entry.hasNativeBindings)
+            writer->addResourceBindingMap(entry.key, entry.nativeBindings);
+        return true;
+    }
+
+    QShaderPackWriter *writer;
+    const BakeSettings &settings;
+    QShader::Stage stage = QShader::VertexStage;
+    QThreadPool pool;
+    QVector<Entry> pending;
+};
+
+static QStringList toStringList(const QCborValue &v)
+{
+    QStringList result;
+    for (const QCborValue &e : v.toArray())
+        result.append(e.toString());
+    return result;
+}
+
+static QByteArrayList toByteArrayList(const QCborValue &v)
+{
+    QByteArrayList result;
+    for (const QCborValue &e : v.toArray())
+        result.append(e.toString().toUtf8());
+    return result;
+}
+
+// With several inputs sharing the constants given by --spec, each input gets
+// the ones it declares. Only constants that no input declares are an error.
+static bool checkSpecConstants(const BakeSettings &settings, const QSet<int> &specializedIds)
+{
+    QList<int> ids = settings.specConstants.keys();
+    std::sort(ids.begin(), ids.end());
+    bool ok = true;
+    for (int id : qAsConst(ids)) {
+        if (!specializedIds.contains(id)) {
+            qWarning("No input declares a specialization constant with constant_id %d", id);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// Records the inputs of a bake in a trailer: the files, and what they
+// contained.
+static void setInputs(QCborMap *trailer, const QString &fn, const QStringList &includedFiles,
+                      const QByteArrayList &referencedMacros, const BakeSettings &settings)
+{
+    trailer->insert(QLatin1String("fingerprint"), inputFingerprint(fn, includedFiles, settings));
+    trailer->insert(QLatin1String("includes"), QCborArray::fromStringList(includedFiles));
+    QCborArray macros;
+    for (const QByteArray &macro : referencedMacros)
+        macros.append(QString::fromUtf8(macro));
+    trailer->insert(QLatin1String("macros"), macros);
+}
+
+static bool bakeFile(QShaderBaker *baker, const QString &fn, const BakeSettings &settings)
+{
+    const bool hasOutput = !settings.outputFileName.isEmpty();
+    QShaderBakerPrivate *bd = QShaderBakerPrivate::get(baker);
+    QCborMap existing;
+    const auto skip = [bd, &existing](const QStringList &includedFiles, const QByteArrayList &referencedMacros) {
+        // as if it was baked, for the watch mode and the specialization check
+        bd->errorMessage.clear();
+        bd->includedFiles = includedFiles;
+        bd->referencedPreambleMacros = referencedMacros;
+        bd->specializedIds.clear();
+        for (const QCborValue &id : existing.value(QLatin1String("specIds")).toArray())
+            bd->specializedIds.insert(int(id.toInteger()));
+        return true;
+    };
+
+    QByteArray hash;
+    const QByteArray signature = settingsSignature(settings);
+    if (hasOutput)
+        existing = readPackTrailer(settings.outputFileName);
+    if (hasOutput && !settings.force && !existing.isEmpty()) {
+        // Cheapest is when none of the inputs changed at all.
+        const QByteArray fingerprint = existing.value(QLatin1String("fingerprint")).toByteArray();
+        const QStringList existingIncludes = toStringList(existing.value(QLatin1String("includes")));
+        if (!fingerprint.isEmpty() && inputFingerprint(fn, existingIncludes, settings) == fingerprint)
+            return skip(existingIncludes, toByteArrayList(existing.value(QLatin1String("macros"))));
+
+        // Preprocessing is still much cheaper than compiling and translating,
+        // skip the rest when the output was generated from the same tokens.
+        // Only the trailer is updated then, so that the next run gets away
+        // with the fingerprint again.
+        QStringList includedFiles;
+        QByteArrayList referencedMacros;
+        hash = sourceHash(fn, settings, &includedFiles, &referencedMacros);
+        if (!hash.isEmpty() && existing.value(QLatin1String("sourceHash")).toByteArray() == hash
+                && existing.value(QLatin1String("settings")).toByteArray() == signature)
+        {
+            QCborMap trailer = existing;
+            setInputs(&trailer, fn, includedFiles, referencedMacros, settings);
+            if (!replacePackTrailer(settings.outputFileName, trailer))
+                qWarning("Failed to update %s", qPrintable(settings.outputFileName));
+            return skip(includedFiles, referencedMacros);
+        }
+    }
+
+    baker->setSourceFileName(fn);
+    applySettings(baker, settings);
+
+    PackOutputDevice f(settings.outputFileName);
+    if (hasOutput && !f.open(QIODevice::WriteOnly)) {
+        qWarning("Failed to open %s for writing", qPrintable(settings.outputFileName));
+        return false;
+    }
+    QShaderPackWriter writer(&f, settings.compressionLevel);
+    PackSink sink(hasOutput ? &writer : nullptr, settings);
+
+    bd->sink = &sink;
+    baker->bake();
+    bd->sink = nullptr;
+    if (!baker->errorMessage().isEmpty()) {
+        qWarning("Shader baking failed: %s", qPrintable(baker->errorMessage()));
+        return false;
+    }
+    if (!sink.finish())
+        return false;
+
+    if (!hasOutput)
+        return true;
+
+    QCborMap trailer;
+    setInputs(&trailer, fn, baker->includedFiles(), baker->referencedPreambleMacros(), settings);
+    // The source hash takes a preprocessing run of its own, so it is only
+    // computed above, when there is an earlier output to compare with. After
+    // the first bake and with --force the next run adds it. The existing one
+    // is still right when the inputs are the same.
+    const QByteArray fingerprint = trailer.value(QLatin1String("fingerprint")).toByteArray();
+    if (hash.isEmpty() && !fingerprint.isEmpty()
+            && existing.value(QLatin1String("fingerprint")).toByteArray() == fingerprint)
+    {
+        hash = existing.value(QLatin1String("sourceHash")).toByteArray();
+    }
+    if (!hash.isEmpty())
+        trailer.insert(QLatin1String("sourceHash"), hash);
+    trailer.insert(QLatin1String("settings"), signature);
+    QList<int> specIds = bd->specializedIds.values();
+    std::sort(specIds.begin(), specIds.end());
+    QCborArray specIdArray;
+    for (int id : qAsConst(specIds))
+        specIdArray.append(id);
+    trailer.insert(QLatin1String("specIds"), specIdArray);
+
+    if (!writer.finish() || !writePackTrailer(&f, trailer) || !f.commit()) {
+        qWarning("Failed to write %s", qPrintable(settings.outputFileName));
+        return false;
+    }
+
+    return true;
+}
+
+static bool writeShaderPack(const QShader &bs, const QString &outputFileName, const BakeSettings &settings,
+                            const QString &mode)
+{
+    const bool hasOutput = !outputFileName.isEmpty();
+    PackOutputDevice f(outputFileName);
+    if (hasOutput && !f.open(QIODevice::WriteOnly)) {
+        qWarning("Failed to open %s for writing", qPrintable(outputFileName));
+        return false;
+    }
+    QShaderPackWriter writer(&f, settings.compressionLevel);
+    PackSink sink(hasOutput ? &writer : nullptr, settings);
+
+    const QVector<QShaderKey> keys = bs.availableShaders();
+    if (!sink.begin(bs.stage(), bs.description(), keys))
+        return false;
+    for (const QShaderKey &key : keys) {
+        if (!sink.addShader(key, bs.shader(key), bs.nativeResourceBindingMap(key)))
+            return false;
+    }
+
+    if (!sink.finish())
+        return false;
+
+    QCborMap trailer;
+    trailer.insert(QLatin1String("mode"), mode);
+    if (hasOutput && (!writer.finish() || !writePackTrailer(&f, trailer) || !f.commit())) {
+        qWarning("Failed to write %s", qPrintable(outputFileName));
+        return false;
+    }
+
+    return true;
+}
+
+// With a pipeline the output is a directory, receiving <name>.qsb for each stage.
+static bool bakePipelineFiles(QShaderBaker *baker, const QStringList &fileNames, const BakeSettings &settings)
+{
+    applySettings(baker, settings);
+
+    const QVector<QShader> shaders = baker->bakePipeline(fileNames);
+    if (shaders.isEmpty()) {
+        qWarning("Shader baking failed: %s", qPrintable(baker->errorMessage()));
+        return false;
+    }
+
+    if (!settings.outputFileName.isEmpty() && !QDir().mkpath(settings.outputFileName)) {
+        qWarning("Failed to create output directory %s", qPrintable(settings.outputFileName));
+        return false;
+    }
+
+    for (int i = 0; i < shaders.count(); ++i) {
+        QString outFn;
+        if (!settings.outputFileName.isEmpty()) {
+            outFn = QDir(settings.outputFileName).filePath(QFileInfo(fileNames[i]).fileName()
+                                                           + QLatin1String(".qsb"));
+        }
+        if (!writeShaderPack(shaders[i], outFn, settings, QStringLiteral("pipeline")))
+            return false;
+    }
+
+    return true;
+}
+
+// A usage profile lists the shaders an application requested at run time, one
+// per line, in the order of first use:
+//
+//   <pack> <source>.<version> [batchable]
+//
+// for example "shaders/texture.frag.qsb glsl.300es". Packs are matched by file
+// name, so the path the application loaded the pack from does not matter.
+// Empty lines and lines starting with # are ignored. Any other line that does
+// not parse fails the whole profile: skipping it would prune shaders the
+// application uses. The warm-up list written by --prune-with uses the same
+// format.
+struct UsageProfileEntry
+{
+    QString pack;
+    QShaderKey key;
+};
+
+static bool readUsageProfile(const QString &fn, QVector<UsageProfileEntry> *entries)
+{
+    QFile f(fn);
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qWarning("Failed to open %s", qPrintable(fn));
+        return false;
+    }
+
+    int lineNumber = 0;
+    while (!f.atEnd()) {
+        const QString line = QString::fromUtf8(f.readLine()).trimmed();
+        ++lineNumber;
+        if (line.isEmpty() || line.startsWith(QLatin1Char('#')))
+            continue;
+
+        const QStringList parts = line.split(QLatin1Char(' '), Qt::SkipEmptyParts);
+        QShader::Source src;
+        QShaderVersion version;
+        QShader::Variant variant = QShader::StandardShader;
+        bool ok = parts.count() >= 2 && parts.count() <= 3 && parseSourceAndVersion(parts[1], &src, &version);
+        if (ok && parts.count() == 3) {
+            if (parts[2] == QLatin1String("batchable"))
+                variant = QShader::BatchableVertexShader;
+            else
+                ok = false;
+        }
+        if (!ok) {
+            qWarning("%s:%d: Invalid entry %s", qPrintable(fn), lineNumber, qPrintable(line));
+            return false;
+        }
+
+        const UsageProfileEntry e = { QFileInfo(parts[0]).fileName(), { src, version, variant } };
+        if (!std::any_of(entries->cbegin(), entries->cend(), [&e](const UsageProfileEntry &other) {
+            return other.pack == e.pack && other.key == e.key;
+        })) {
+            entries->append(e);
+        }
+    }
+
+    return true;
+}
+
+// Modes that rewrite existing packs do it in place, unless -o is given. With
+// multiple packs -o names a directory.
+static bool prepareOutputDirectory(const QStringList &fileNames, const BakeSettings &settings)
+{
+    const bool toDirectory = fileNames.count() > 1 && !settings.outputFileName.isEmpty();
+    if (toDirectory && !QDir().mkpath(settings.outputFileName)) {
+        qWarning("Failed to create output directory %s", qPrintable(settings.outputFileName));
+        return false;
+    }
+    return true;
+}
+
+static QString outputFileNameFor(const QString &fn, const QStringList &fileNames, const BakeSettings &settings)
+{
+    if (settings.outputFileName.isEmpty())
+        return fn;
+    if (fileNames.count() > 1)
+        return QDir(settings.outputFileName).filePath(QFileInfo(fn).fileName());
+    return settings.outputFileName;
+}
+
+// Rewrites each pack with only the shaders listed in the profile. Packs the
+// profile does not mention at all are left alone, since not having recorded
+// any use of them more likely means the profile is incomplete than that they
+// are unused.
+static bool pruneShaderPacks(const QStringList &fileNames, const QString &profileFileName,
+                             const QString &warmupFileName, const BakeSettings &settings)
+{
+    QVector<UsageProfileEntry> profile;
+    if (!readUsageProfile(profileFileName, &profile))
+        return false;
+
+    if (!prepareOutputDirectory(fileNames, settings))
+        return false;
+
+    QHash<QString, QString> outputs; // pack file name -> pruned pack
+    for (const QString &fn : fileNames) {
+        const QString packName = QFileInfo(fn).fileName();
+        const QShader bs = QShader::fromSerialized(readFile(fn));
+        if (!bs.isValid()) {
+            qWarning("Failed to deserialize %s", qPrintable(fn));
+            return false;
+        }
+
+        const QString outFn = outputFileNameFor(fn, fileNames, settings);
+        outputs.insert(packName, outFn);
+
+        QVector<QShaderKey> used;
+        for (const UsageProfileEntry &e : qAsConst(profile)) {
+            if (e.pack == packName)
+                used.append(e.key);
+        }
+        if (used.isEmpty()) {
+            qWarning("%s is not used according to the profile, leaving it unchanged", qPrintable(fn));
+            if (outFn != fn && !writeShaderPack(bs, outFn, settings, QStringLiteral("prune")))
+                return false;
+            continue;
+        }
+
+        QShader pruned;
+        pruned.setStage(bs.stage());
+        pruned.setDescription(bs.description());
+        const QVector<QShaderKey> keys = bs.availableShaders();
+        for (const QShaderKey &key : keys) {
+            if (!used.contains(key))
+                continue;
+            pruned.setShader(key, bs.shader(key));
+            if (const QShader::NativeResourceBindingMap *map = bs.nativeResourceBindingMap(key))
+                pruned.setResourceBindingMap(key, *map);
+        }
+        for (const QShaderKey &key : qAsConst(used)) {
+            if (!keys.contains(key)) {
+                qWarning("%s has no %s%s shader, the profile does not match the pack", qPrintable(fn),
+                         qPrintable(sourceAndVersionStr(key)),
+                         key.sourceVariant() == QShader::BatchableVertexShader ? " batchable" : "");
+            }
+        }
+
+        if (!writeShaderPack(pruned, outFn, settings, QStringLiteral("prune")))
+            return false;
+        qDebug("%s: kept %d of %d shaders", qPrintable(outFn), pruned.availableShaders().count(), keys.count());
+    }
+
+    if (!warmupFileName.isEmpty()) {
+        QByteArray warmup;
+        for (const UsageProfileEntry &e : qAsConst(profile)) {
+            const QString outFn = outputs.value(e.pack);
+            if (outFn.isEmpty())
+                continue;
+            warmup += outFn.toUtf8() + ' ' + sourceAndVersionStr(e.key).toUtf8();
+            if (e.key.sourceVariant() == QShader::BatchableVertexShader)
+                warmup += " batchable";
+            warmup += '\n';
+        }
+        if (!writeToFile(warmup, warmupFileName, true))
+            return false;
+    }
+
+    return true;
+}
+
+// Generates the requested GLSL, HLSL and MSL targets from the SPIR-V stored
+// in the packs, without the original source and without compiling anything.
+// The new shaders are added to the pack, replacing ones with the same key.
+// A SPIR-V version the pack does not have yet gets the same module.
+static bool retargetShaderPacks(const QStringList &fileNames, const BakeSettings &settings)
+{
+    if (!prepareOutputDirectory(fileNames, settings))
+        return false;
+
+    for (const QString &fn : fileNames) {
+        QShader bs = QShader::fromSerialized(readFile(fn));
+        if (!bs.isValid()) {
+            qWarning("Failed to deserialize %s", qPrintable(fn));
+            return false;
+        }
+
+        // any SPIR-V version will do, they are all the same module
+        QByteArray spirv[2];
+        for (const QShaderKey &key : bs.availableShaders()) {
+            if (key.source() != QShader::SpirvShader)
+                continue;
+            const int i = key.sourceVariant() == QShader::BatchableVertexShader ? 1 : 0;
+            if (spirv[i].isEmpty())
+                spirv[i] = bs.shader(key).shader();
+        }
+        if (spirv[0].isEmpty() && spirv[1].isEmpty()) {
+            qWarning("%s contains no SPIR-V, it can only be rebaked from source", qPrintable(fn));
+            return false;
+        }
+
+        int added = 0;
+        for (int i = 0; i < 2; ++i) {
+            if (spirv[i].isEmpty())
+                continue;
+            const QShader::Variant variant = i ? QShader::BatchableVertexShader : QShader::StandardShader;
+            QSpirvShader spirvShader;
+            spirvShader.setSpirvBinary(spirv[i]);
+            for (const QShaderBaker::GeneratedShader &req : settings.genShaders) {
+                const QShaderKey key(req.first, req.second, variant);
+                QShaderCode shader;
+                QShader::NativeResourceBindingMap nativeBindings;
+                bool hasNativeBindings = false;
+                shader.setEntryPoint(QByteArrayLiteral("main"));
+                switch (req.first) {
+                case QShader::GlslShader: {
+                    QSpirvShader::GlslFlags flags;
+                    if (req.second.flags().testFlag(QShaderVersion::GlslEs))
+                        flags |= QSpirvShader::GlslEs;
+                    shader.setShader(spirvShader.translateToGLSL(req.second.version(), flags));
+                    break;
+                }
+                case QShader::HlslShader:
+                    shader.setShader(spirvShader.translateToHLSL(req.second.version()));
+                    break;
+                case QShader::MslShader:
+                    shader.setShader(spirvShader.translateToMSL(req.second.version(), &nativeBindings));
+                    shader.setEntryPoint(QByteArrayLiteral("main0"));
+                    hasNativeBindings = true;
+                    break;
+                case QShader::SpirvShader:
+                    // the same module, under the requested version
+                    if (bs.availableShaders().contains(key))
+                        continue;
+                    shader.setShader(spirv[i]);
+                    break;
+                default:
+                    Q_UNREACHABLE();
+                }
+                if (shader.shader().isEmpty()) {
+                    qWarning("Failed to generate %s for %s: %s", qPrintable(sourceAndVersionStr(key)),
+                             qPrintable(fn), qPrintable(spirvShader.translationErrorMessage()));
+                    return false;
+                }
+                bs.setShader(key, shader);
+                if (hasNativeBindings)
+                    bs.setResourceBindingMap(key, nativeBindings);
+                ++added;
+            }
+        }
+
+        const QString outFn = outputFileNameFor(fn, fileNames, settings);
+        if (!writeShaderPack(bs, outFn, settings, QStringLiteral("retarget")))
+            return false;
+        qDebug("%s: generated %d shaders", qPrintable(outFn), added);
+    }
+
+    return true;
+}
+
+static void copyShader(QShader *dst, const QShader &src, const QShaderKey &key)
+{
+    dst->setShader(key, src.shader(key));
+    if (const QShader::NativeResourceBindingMap *map = src.nativeResourceBindingMap(key))
+        dst->setResourceBindingMap(key, *map);
+}
+
+static bool hasBatchableVariant(const QShader &bs)
+{
+    for (const QShaderKey &key : bs.availableShaders()) {
+        if (key.sourceVariant() == QShader::BatchableVertexShader)
+            return true;
+    }
+    return false;
+}
+
+// Tells if two packs have matching reflection data, as packs of the same
+// shader do. Packs baked with -b have the extra vertex input the batchable
+// variant needs, so between a pack with and one without batchable variants
+// the inputs of the latter only need to be a subset.
+static bool sameInterface(const QShader &a, const QShader &b)
+{
+    if (hasBatchableVariant(a) == hasBatchableVariant(b))
+        return a.description() == b.description();
+
+    const bool batchableFirst = hasBatchableVariant(a);
+    QJsonObject batchable = QJsonDocument::fromJson((batchableFirst ? a : b).description().toJson()).object();
+    QJsonObject standard = QJsonDocument::fromJson((batchableFirst ? b : a).description().toJson()).object();
+    const QJsonArray batchableInputs = batchable.take(QLatin1String("inputs")).toArray();
+    const QJsonArray standardInputs = standard.take(QLatin1String("inputs")).toArray();
+    for (const QJsonValue &input : standardInputs) {
+        if (!batchableInputs.contains(input))
+            return false;
+    }
+    return batchable == standard;
+}
+
+// Combines packs for the same shader, for example the outputs of per-backend
+// jobs, into one. Shaders in later packs replace ones with the same key. The
+// reflection data comes from a pack with batchable variants when there is
+// one, as that is what a full bake would have. Packs with reflection data
+// that does not match are not for the same shader, and are refused.
+static bool mergeShaderPacks(const QStringList &fileNames, const BakeSettings &settings)
+{
+    if (settings.outputFileName.isEmpty()) {
+        qWarning("Merging needs an output file, use -o");
+        return false;
+    }
+
+    QShader merged;
+    bool first = true;
+    for (const QString &fn : fileNames) {
+        const QShader bs = QShader::fromSerialized(readFile(fn));
+        if (!bs.isValid()) {
+            qWarning("Failed to deserialize %s", qPrintable(fn));
+            return false;
+        }
+        if (first) {
+            merged.setStage(bs.stage());
+            merged.setDescription(bs.description());
+        } else if (bs.stage() != merged.stage()) {
+            qWarning("%s is a %s shader, cannot merge it with %s shaders", qPrintable(fn),
+                     qPrintable(stageStr(bs.stage())), qPrintable(stageStr(merged.stage())));
+            return false;
+        }
+
+        if (!first && !sameInterface(merged, bs)) {
+            qWarning("%s has different reflection data than the packs before it, "
+                     "they are not for the same shader", qPrintable(fn));
+            return false;
+        }
+
+        if (!first && hasBatchableVariant(bs) && !hasBatchableVariant(merged))
+            merged.setDescription(bs.description());
+        first = false;
+
+        for (const QShaderKey &key : bs.availableShaders()) {
+            if (merged.availableShaders().contains(key)
+                    && merged.shader(key).shader() != bs.shader(key).shader()) {
+                qWarning("%s has a different %s%s shader than the packs before it, using that", qPrintable(fn),
+                         qPrintable(sourceAndVersionStr(key)),
+                         key.sourceVariant() == QShader::BatchableVertexShader ? " batchable" : "");
+            }
+            copyShader(&merged, bs, key);
+        }
+    }
+
+    if (!writeShaderPack(merged, settings.outputFileName, settings, QStringLiteral("merge")))
+        return false;
+    qDebug("%s: %d shaders", qPrintable(settings.outputFileName), merged.availableShaders().count());
+    return true;
+}
+
+// An entry of --strip: either <source>.<version> as in -x, or just <source>
+// for all versions, or "batchable" for all batchable variants. The spec is
+// parsed like -x does, so "glsl.300 es" and "glsl.300es" are the same.
+static bool matchesKeySpec(const QShaderKey &key, const QString &spec)
+{
+    if (spec == QLatin1String("batchable"))
+        return key.sourceVariant() == QShader::BatchableVertexShader;
+    QShader::Source src;
+    QShaderVersion version;
+    if (!spec.contains(QLatin1Char('.')))
+        return parseSourceAndVersion(spec + QLatin1String(".100"), &src, &version) && key.source() == src;
+    return parseSourceAndVersion(spec, &src, &version) && key.source() == src && key.sourceVersion() == version;
+}
+
+static bool stripShaderPacks(const QStringList &fileNames, const QString &specs, const BakeSettings &settings)
+{
+    const QStringList specList = specs.split(QLatin1Char(','), Qt::SkipEmptyParts);
+    for (const QString &spec : specList) {
+        QShader::Source src;
+        QShaderVersion version;
+        if (spec == QLatin1String("batchable"))
+            continue;
+        const QString key = spec.contains(QLatin1Char('.')) ? spec : spec + QLatin1String(".100");
+        if (!parseSourceAndVersion(key, &src, &version)) {
+            qWarning("Invalid shader key %s", qPrintable(spec));
+            return false;
+        }
+    }
+
+    if (!prepareOutputDirectory(fileNames, settings))
+        return false;
+
+    for (const QString &fn : fileNames) {
+        const QShader bs = QShader::fromSerialized(readFile(fn));
+        if (!bs.isValid()) {
+            qWarning("Failed to deserialize %s", qPrintable(fn));
+            return false;
+        }
+
+        QShader stripped;
+        stripped.setStage(bs.stage());
+        stripped.setDescription(bs.description());
+        const QVector<QShaderKey> keys = bs.availableShaders();
+        for (const QShaderKey &key : keys) {
+            const bool strip = std::any_of(specList.cbegin(), specList.cend(), [&key](const QString &spec) {
+                return matchesKeySpec(key, spec);
+            });
+            if (!strip)
+                copyShader(&stripped, bs, key);
+        }
+
+        const QString outFn = outputFileNameFor(fn, fileNames, settings);
+        if (!writeShaderPack(stripped, outFn, settings, QStringLiteral("strip")))
+            return false;
+        qDebug("%s: kept %d of %d shaders", qPrintable(outFn), stripped.availableShaders().count(), keys.count());
+    }
+
+    return true;
+}
+
+// The graphics API a shader is for. Used for splitting packs per platform.
+static QString platformStr(QShader::Source source)
+{
+    switch (source) {
+    case QShader::SpirvShader:
+        return QStringLiteral("vulkan");
+    case QShader::GlslShader:
+        return QStringLiteral("opengl");
+    case QShader::HlslShader:
+    case QShader::DxbcShader:
+    case QShader::DxilShader:
+        return QStringLiteral("d3d");
+    case QShader::MslShader:
+    case QShader::MetalLibShader:
+        return QStringLiteral("metal");
+    default:
+        Q_UNREACHABLE();
+    }
+}
+
+// Writes <dir>/<platform>/<pack name> for each platform that has shaders in
+// the pack, so a deployment can ship one directory only.
+static bool splitShaderPacks(const QStringList &fileNames, const BakeSettings &settings)
+{
+    if (settings.outputFileName.isEmpty()) {
+        qWarning("Splitting needs an output directory, use -o");
+        return false;
+    }
+    const QDir outDir(settings.outputFileName);
+
+    for (const QString &fn : fileNames) {
+        const QShader bs = QShader::fromSerialized(readFile(fn));
+        if (!bs.isValid()) {
+            qWarning("Failed to deserialize %s", qPrintable(fn));
+            return false;
+        }
+
+        QMap<QString, QShader> perPlatform;
+        for (const QShaderKey &key : bs.availableShaders()) {
+            QShader &out = perPlatform[platformStr(key.source())];
+            if (!out.isValid()) {
+                out.setStage(bs.stage());
+                out.setDescription(bs.description());
+            }
+            copyShader(&out, bs, key);
+        }
+
+        for (auto it = perPlatform.cbegin(), end = perPlatform.cend(); it != end; ++it) {
+            if (!outDir.mkpath(it.key())) {
+                qWarning("Failed to create output directory %s", qPrintable(outDir.filePath(it.key())));
+                return false;
+            }
+            const QString outFn = outDir.filePath(it.key() + QLatin1Char('/') + QFileInfo(fn).fileName());
+            if (!writeShaderPack(*it, outFn, settings, QStringLiteral("split")))
+                return false;
+        }
+        qDebug("%s: split into %s", qPrintable(fn), qPrintable(QStringList(perPlatform.keys()).join(QLatin1String(", "))));
+    }
+
+    return true;
+}
+
+// The metrics printed by --analyze, with the names used in --budget.
+static const struct {
+    const char *name;
+    int QSpirvShader::CostInfo::*value;
+} costMetrics[] = {
+    { "instructions", &QSpirvShader::CostInfo::instructionCount },
+    { "alu", &QSpirvShader::CostInfo::aluInstructionCount },
+    { "texture", &QSpirvShader::CostInfo::textureInstructionCount },
+    { "branches", &QSpirvShader::CostInfo::branchCount },
+    { "loops", &QSpirvShader::CostInfo::loopCount },
+    { "live", &QSpirvShader::CostInfo::maxLiveComponents },
+    { "inputs", &QSpirvShader::CostInfo::inputComponents },
+    { "outputs", &QSpirvShader::CostInfo::outputComponents },
+    { "uniforms", &QSpirvShader::CostInfo::uniformBlockSize },
+    { "samplers", &QSpirvShader::CostInfo::samplerCount }
+};
+
+// A limit from --budget, for all stages when stage is empty.
+struct CostBudget
+{
+    QString stage;
+    int metric;
+    int limit;
+};
+
+// Entries are [<stage>.]<metric>=<limit>, separated by commas or newlines,
+// for example "fragment.texture=8,live=64". The stage is spelled as
+// analyzeShaderPacks() compares it, stageStr() in lowercase. @<file> reads
+// entries from a file, where lines starting with # are ignored.
+static bool parseBudget(const QString &spec, QVector<CostBudget> *budget)
+{
+    QString text = spec;
+    if (spec.startsWith(QLatin1Char('@'))) {
+        QFile f(spec.mid(1));
+        if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            qWarning("Failed to open %s", qPrintable(spec.mid(1)));
+            return false;
+        }
+        text.clear();
+        while (!f.atEnd()) {
+            const QString line = QString::fromUtf8(f.readLine()).trimmed();
+            if (!line.startsWith(QLatin1Char('#')))
+                text += line + QLatin1Char(',');
+        }
+    }
+
+    for (const QString &entry : text.split(QLatin1Char(','), Qt::SkipEmptyParts)) {
+        const QString name = entry.section(QLatin1Char('='), 0, 0).trimmed();
+        bool ok = false;
+        const int limit = entry.section(QLatin1Char('='), 1).trimmed().toInt(&ok);
+        CostBudget b;
+        b.stage = name.contains(QLatin1Char('.')) ? name.section(QLatin1Char('.'), 0, 0) : QString();
+        b.metric = -1;
+        const QString metric = name.section(QLatin1Char('.'), -1);
+        for (int i = 0; i < int(sizeof(costMetrics) / sizeof(costMetrics[0])); ++i) {
+            if (metric == QLatin1String(costMetrics[i].name))
+                b.metric = i;
+        }
+        bool knownStage = b.stage.isEmpty();
+        for (QShader::Stage stage : { QShader::VertexStage, QShader::TessellationControlStage,
+                                      QShader::TessellationEvaluationStage, QShader::GeometryStage,
+                                      QShader::FragmentStage, QShader::ComputeStage })
+        {
+            if (b.stage == stageStr(stage).toLower())
+                knownStage = true;
+        }
+        if (!ok || b.metric < 0 || !knownStage || name.count(QLatin1Char('.')) > 1) {
+            qWarning("Invalid budget entry %s", qPrintable(entry.trimmed()));
+            return false;
+        }
+        b.limit = limit;
+        budget->append(b);
+    }
+    return true;
+}
+
+// Prints a static estimate of the cost of the shaders in the packs, based on
+// their SPIR-V, and checks it against the budget. All shaders are checked
+// before failing, so that a build log shows every violation at once.
+static bool analyzeShaderPacks(const QStringList &fileNames, const QVector<CostBudget> &budget)
+{
+    QTextStream ts(stdout);
+    bool withinBudget = true;
+    for (const QString &fn : fileNames) {
+        const QShader bs = QShader::fromSerialized(readFile(fn));
+        if (!bs.isValid()) {
+            qWarning("Failed to deserialize %s", qPrintable(fn));
+            return false;
+        }
+        const QString stage = stageStr(bs.stage()).toLower();
+
+        bool hasSpirv = false;
+        for (QShader::Variant variant : { QShader::StandardShader, QShader::BatchableVertexShader }) {
+            QByteArray spirv;
+            for (const QShaderKey &key : bs.availableShaders()) {
+                if (key.source() == QShader::SpirvShader && key.sourceVariant() == variant) {
+                    spirv = bs.shader(key).shader();
+                    break;
+                }
+            }
+            if (spirv.isEmpty())
+                continue;
+            hasSpirv = true;
+
+            QSpirvShader spirvShader;
+            spirvShader.setSpirvBinary(spirv);
+            const QSpirvShader::CostInfo cost = spirvShader.costInfo();
+            const QString name = fn + (variant == QShader::BatchableVertexShader ? QLatin1String(" (batchable)") : QLatin1String(""));
+            ts << name << ": " << stageStr(bs.stage()) << " shader\n"
+               << "  instructions: " << cost.instructionCount
+               << " (ALU " << cost.aluInstructionCount
+               << ", texture " << cost.textureInstructionCount
+               << ", branches " << cost.branchCount
+               << ", loops " << cost.loopCount << ")\n"
+               << "  live values: up to " << cost.maxLiveComponents << " components\n"
+               << "  interface: " << cost.inputComponents << " input components, "
+               << cost.outputComponents << " output components, "
+               << cost.uniformBlockSize << " bytes of uniforms, "
+               << cost.samplerCount << " samplers\n";
+
+            for (const CostBudget &b : budget) {
+                if (!b.stage.isEmpty() && b.stage != stage)
+                    continue;
+                const int value = cost.*costMetrics[b.metric].value;
+                if (value > b.limit) {
+                    ts.flush();
+                    qWarning("%s: %s is %d, over the budget of %d", qPrintable(name),
+                             costMetrics[b.metric].name, value, b.limit);
+                    withinBudget = false;
+                }
+            }
+        }
+        if (!hasSpirv)
+            qWarning("%s contains no SPIR-V, cannot analyze it", qPrintable(fn));
+    }
+    return withinBudget;
+}
+
+// A compact summary of a pack for tooling, instead of parsing the output of
+// -d: the keys, with the size, entry point and native binding map of each
+// shader, and a hash of the reflection data, which tells if two packs have
+// the same interface.
+static QJsonObject packSummary(const QString &fn)
+{
+    QJsonObject result;
+    result.insert(QLatin1String("file"), fn);
+
+    const QByteArray data = readFile(fn);
+    const QShader bs = QShader::fromSerialized(data);
+    if (!bs.isValid()) {
+        result.insert(QLatin1String("error"), QLatin1String("Failed to deserialize"));
+        return result;
+    }
+
+    result.insert(QLatin1String("size"), data.size());
+    result.insert(QLatin1String("stage"), stageStr(bs.stage()).toLower());
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+    result.insert(QLatin1String("qsbVersion"), QShaderPrivate::get(&bs)->qsbVersion);
+#endif
+    result.insert(QLatin1String("reflectionHash"), QString::fromLatin1(
+                      QCryptographicHash::hash(bs.description().toJson(), QCryptographicHash::Sha256).toHex()));
+
+    QVector<QShaderKey> keys = bs.availableShaders();
+    // the order in the pack is not defined, the output should be stable
+    std::sort(keys.begin(), keys.end(), [](const QShaderKey &a, const QShaderKey &b) {
+        const QString sa = sourceAndVersionStr(a);
+        const QString sb = sourceAndVersionStr(b);
+        return sa < sb || (sa == sb && a.sourceVariant() < b.sourceVariant());
+    });
+    QJsonArray shaders;
+    for (const QShaderKey &key : qAsConst(keys)) {
+        const QShaderCode code = bs.shader(key);
+        QJsonObject shader;
+        shader.insert(QLatin1String("key"), sourceAndVersionStr(key));
+        if (key.sourceVariant() == QShader::BatchableVertexShader)
+            shader.insert(QLatin1String("batchable"), true);
+        shader.insert(QLatin1String("size"), code.shader().size());
+        shader.insert(QLatin1String("entryPoint"), QString::fromUtf8(code.entryPoint()));
+        if (const QShader::NativeResourceBindingMap *map = bs.nativeResourceBindingMap(key)) {
+            QJsonObject bindings;
+            for (auto it = map->cbegin(), end = map->cend(); it != end; ++it)
+                bindings.insert(QString::number(it.key()), QJsonArray { it.value().first, it.value().second });
+            shader.insert(QLatin1String("nativeBindings"), bindings);
+        }
+        shaders.append(shader);
+    }
+    result.insert(QLatin1String("shaders"), shaders);
+    return result;
+}
+
+// Summarizes the packs on a thread pool and prints one compact JSON object
+// per line, in the order of the input. Each task takes a batch of packs, to
+// keep the overhead low when there are many small ones.
+class PackSummaryTask : public QRunnable
+{
+public:
+    PackSummaryTask(const QStringList &fileNames, int first, int last,
+                    QVector<QByteArray> *summaries, QVector<bool> *failed)
+        : fileNames(fileNames), first(first), last(last), summaries(summaries), failed(failed)
+    { }
+
+    void run() override
+    {
+        for (int i = first; i < last; ++i) {
+            const QJsonObject summary = packSummary(fileNames[i]);
+            (*failed)[i] = summary.contains(QLatin1String("error"));
+            (*summaries)[i] = QJsonDocument(summary).toJson(QJsonDocument::Compact);
+        }
+    }
+
+private:
+    const QStringList &fileNames;
+    int first;
+    int last;
+    QVector<QByteArray> *summaries;
+    QVector<bool> *failed;
+};
+
+static bool dumpPackSummaries(const QStringList &fileNames, int jobs)
+{
+    QVector<QByteArray> summaries(fileNames.count());
+    QVector<bool> failed(fileNames.count());
+    QThreadPool pool;
+    if (jobs > 0)
+        pool.setMaxThreadCount(jobs);
+
+    const int batchSize = qMax(1, fileNames.count() / (pool.maxThreadCount() * 8));
+    for (int first = 0; first < fileNames.count(); first += batchSize)
+        pool.start(new PackSummaryTask(fileNames, first, qMin(first + batchSize, fileNames.count()), &summaries, &failed));
+    pool.waitForDone();
+
+    QFile out;
+    if (!out.open(stdout, QIODevice::WriteOnly))
+        return false;
+    for (const QByteArray &summary : qAsConst(summaries)) {
+        out.write(summary);
+        out.write("\n");
+    }
+    return !failed.contains(true);
+}
+
+// Turns NAME[=VALUE] definitions, as given to -D, into a preamble.
+static QByteArray definesToPreamble(const QStringList &defines)
+{
+    QByteArray preamble;
+    for (const QString &def : defines) {
+        const QStringList defs = def.split(QLatin1Char('='), QString::SkipEmptyParts);
+        if (!defs.isEmpty()) {
+            preamble.append("#define");
+            for (const QString &s : defs) {
+                preamble.append(' ');
+                preamble.append(s.toUtf8());
+            }
+            preamble.append('\n');
+        }
+    }
+    return preamble;
+}
+
+// A define file has one NAME[=VALUE] per line. Empty lines and lines starting
+// with # are ignored.
+static bool readDefineFile(const QString &fn, QStringList *defines)
+{
+    QFile f(fn);
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qWarning("Failed to open %s", qPrintable(fn));
+        return false;
+    }
+    while (!f.atEnd()) {
+        const QString line = QString::fromUtf8(f.readLine()).trimmed();
+        if (!line.isEmpty() && !line.startsWith(QLatin1Char('#')))
+            defines->append(line);
+    }
+    return true;
+}
+
+static QHash<QByteArray, QByteArray> defineValues(const QStringList &defines)
+{
+    QHash<QByteArray, QByteArray> values;
+    for (const QString &def : defines) {
+        const int sep = def.indexOf(QLatin1Char('='));
+        const QString name = (sep >= 0 ? def.left(sep) : def).trimmed();
+        if (!name.isEmpty())
+            values.insert(name.toUtf8(), sep >= 0 ? def.mid(sep + 1).toUtf8() : QByteArray());
+    }
+    return values;
+}
+
+static bool mentionsIdentifier(const QByteArray &text, const QByteArray &name)
+{
+    for (int i = text.indexOf(name); i >= 0; i = text.indexOf(name, i + 1)) {
+        const auto isIdentChar = [](char c) { return isalnum(uchar(c)) || c == '_'; };
+        if ((i == 0 || !isIdentChar(text[i - 1]))
+                && (i + name.size() == text.size() || !isIdentChar(text[i + name.size()])))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+class Watcher : public QObject
+{
+public:
+    Watcher(QShaderBaker *baker, const BakeSettings &settings,
+            const QStringList &defines, const QString &defineFile);
+
+    void addInput(const QString &fn, bool ok);
+
+private:
+    void fileChanged(const QString &path);
+    void directoryChanged(const QString &path);
+    void watchFile(const QString &path);
+    void defineFileChanged();
+    void rebuild();
+    void updateWatches(const QString &input, bool ok);
+    bool needsRebake(const QString &input, const QSet<QByteArray> &changed, const QSet<QByteArray> &added) const;
+
+    struct InputState {
+        QStringList includedFiles;
+        QByteArrayList referencedMacros;
+        bool ok = false;
+    };
+
+    QShaderBaker *baker;
+    BakeSettings settings;
+    QStringList defines; // from the command line
+    QString defineFile;
+    QHash<QByteArray, QByteArray> currentDefines;
+    QFileSystemWatcher fsWatcher;
+    QTimer rebuildTimer;
+    QHash<QString, QStringList> dependents; // watched file -> inputs that need rebaking when it changes
+    QHash<QString, InputState> inputs;
+    QStringList pending;
+    QSet<QString> missing; // watched files that were removed, their directory is watched instead
+};
+
+Watcher::Watcher(QShaderBaker *baker, const BakeSettings &settings,
+                 const QStringList &defines, const QString &defineFile)
+    : baker(baker),
+      settings(settings),
+      defines(defines)
+{
+    // Editors tend to generate multiple change notifications per save, so
+    // collect them for a short while before rebaking.
+    rebuildTimer.setSingleShot(true);
+    rebuildTimer.setInterval(10);
+    connect(&rebuildTimer, &QTimer::timeout, this, &Watcher::rebuild);
+    connect(&fsWatcher, &QFileSystemWatcher::fileChanged, this, &Watcher::fileChanged);
+    connect(&fsWatcher, &QFileSystemWatcher::directoryChanged, this, &Watcher::directoryChanged);
+
+    QStringList allDefines = defines;
+    if (!defineFile.isEmpty()) {
+        this->defineFile = QFileInfo(defineFile).canonicalFilePath();
+        if (!this->defineFile.isEmpty()) {
+            readDefineFile(this->defineFile, &allDefines);
+            fsWatcher.addPath(this->defineFile);
+        } else {
+            qWarning("Cannot watch %s", qPrintable(defineFile));
+        }
+    }
+    currentDefines = defineValues(allDefines);
+}
+
+void Watcher::addInput(const QString &fn, bool ok)
+{
+    const QString input = QFileInfo(fn).canonicalFilePath();
+    if (input.isEmpty()) {
+        qWarning("Cannot watch %s", qPrintable(fn));
+        return;
+    }
+    QStringList &d(dependents[input]);
+    if (!d.contains(input))
+        d.append(input);
+    fsWatcher.addPath(input);
+    updateWatches(input, ok);
+}
+
+// Saving by writing a new file and renaming it over the old one removes the
+// path from the watcher. When the new file is not there yet, the directory is
+// watched until it appears.
+void Watcher::watchFile(const QString &path)
+{
+    if (fsWatcher.files().contains(path))
+        return;
+    if (QFileInfo::exists(path) && fsWatcher.addPath(path)) {
+        missing.remove(path);
+        return;
+    }
+    missing.insert(path);
+    const QString dir = QFileInfo(path).absolutePath();
+    if (!fsWatcher.directories().contains(dir))
+        fsWatcher.addPath(dir);
+}
+
+void Watcher::directoryChanged(const QString &path)
+{
+    const QSet<QString> files = missing;
+    for (const QString &fn : files) {
+        if (QFileInfo(fn).absolutePath() == path && QFileInfo::exists(fn)) {
+            watchFile(fn);
+            fileChanged(fn);
+        }
+    }
+}
+
+void Watcher::fileChanged(const QString &path)
+{
+    watchFile(path);
+
+    if (path == defineFile) {
+        defineFileChanged();
+        return;
+    }
+
+    for (const QString &input : dependents.value(path)) {
+        if (!pending.contains(input))
+            pending.append(input);
+    }
+    rebuildTimer.start();
+}
+
+// Only the inputs that refer to a macro whose definition changed need
+// rebaking, not everything.
+void Watcher::defineFileChanged()
+{
+    QStringList allDefines = defines;
+    if (!readDefineFile(defineFile, &allDefines))
+        return;
+
+    const QHash<QByteArray, QByteArray> newDefines = defineValues(allDefines);
+    QSet<QByteArray> changed; // changed or removed
+    QSet<QByteArray> added;
+    for (auto it = currentDefines.cbegin(), end = currentDefines.cend(); it != end; ++it) {
+        auto newIt = newDefines.constFind(it.key());
+        if (newIt == newDefines.cend() || *newIt != it.value())
+            changed.insert(it.key());
+    }
+    for (auto it = newDefines.cbegin(), end = newDefines.cend(); it != end; ++it) {
+        if (!currentDefines.contains(it.key()))
+            added.insert(it.key());
+    }
+    currentDefines = newDefines;
+    settings.preamble = definesToPreamble(allDefines);
+
+    if (changed.isEmpty() && added.isEmpty())
+        return;
+
+    for (auto it = inputs.cbegin(), end = inputs.cend(); it != end; ++it) {
+        if (!pending.contains(it.key()) && needsRebake(it.key(), changed, added))
+            pending.append(it.key());
+    }
+    rebuildTimer.start();
+}
+
+bool Watcher::needsRebake(const QString &input, const QSet<QByteArray> &changed, const QSet<QByteArray> &added) const
+{
+    const InputState &state(inputs[input]);
+    if (!state.ok)
+        return true;
+
+    for (const QByteArray &macro : state.referencedMacros) {
+        if (changed.contains(macro))
+            return true;
+    }
+
+    // A new macro was not in the preamble during the last bake, so it cannot
+    // have been recorded. It matters if its name appears anywhere.
+    if (!added.isEmpty()) {
+        QStringList files = state.includedFiles;
+        files.prepend(input);
+        for (const QString &fn : qAsConst(files)) {
+            QFile f(fn);
+            if (!f.open(QIODevice::ReadOnly))
+                return true;
+            const QByteArray text = f.readAll();
+            for (const QByteArray &macro : added) {
+                if (mentionsIdentifier(text, macro))
+                    return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void Watcher::rebuild()
+{
+    // in case a directory notification got lost
+    const QSet<QString> files = missing;
+    for (const QString &fn : files)
+        watchFile(fn);
+
+    const QStringList toBake = pending;
+    pending.clear();
+    for (const QString &input : toBake) {
+        QElapsedTimer timer;
+        timer.start();
+        const bool ok = bakeFile(baker, input, settings);
+        const qint64 elapsed = timer.elapsed();
+        updateWatches(input, ok);
+        if (ok)
+            qDebug("Rebaked %s in %lld ms", qPrintable(input), elapsed);
+        else
+            qWarning("Rebaking %s failed after %lld ms", qPrintable(input), elapsed);
+    }
+}
+
+void Watcher::updateWatches(const QString &input, bool ok)
+{
+    // Includes may have been added or removed. If the bake failed early, the
+    // list may be incomplete, so only ever add in that case.
+    const QStringList includes = baker->includedFiles();
+    for (const QString &inc : includes) {
+        QStringList &d(dependents[inc]);
+        if (!d.contains(input))
+            d.append(input);
+        watchFile(inc);
+    }
+
+    InputState &state(inputs[input]);
+    state.includedFiles = includes;
+    state.referencedMacros = baker->referencedPreambleMacros();
+    state.ok = ok;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser cmdLineParser;
+    const QString appDesc = QString::asprintf("Qt Shader Baker (using QShader from Qt %s)", qVersion());
+    cmdLineParser.setApplicationDescription(appDesc);
+    app.setApplicationVersion(QLatin1String(QT_VERSION_STR));
+    cmdLineParser.addHelpOption();
+    cmdLineParser.addVersionOption();
+    cmdLineParser.addPositionalArgument(QLatin1String("file"), QObject::tr("Vulkan GLSL source file to compile, or SPIR-V binary (.spv, for example shader.frag.spv) to translate"), QObject::tr("file"));
+    QCommandLineOption batchableOption({ "b", "batchable" }, QObject::tr("Also generates rewritten vertex shader for Qt Quick scene graph batching."));
+    cmdLineParser.addOption(batchableOption);
+    QCommandLineOption batchLocOption("zorder-loc",
+                                      QObject::tr("The extra vertex input location when rewriting for batching. Defaults to 7."),
+                                      QObject::tr("location"));
+    cmdLineParser.addOption(batchLocOption);
+    QCommandLineOption glslOption({ "g", "glsl" },
+                                  QObject::tr("Comma separated list of GLSL versions to generate. (for example, \"100 es,120,330\")"),
+                                  QObject::tr("versions"));
+    cmdLineParser.addOption(glslOption);
+    QCommandLineOption hlslOption({ "l", "hlsl" },
+                                  QObject::tr("Comma separated list of HLSL (Shader Model) versions to generate. F.ex. 50 is 5.0, 51 is 5.1."),
+                                  QObject::tr("versions"));
+    cmdLineParser.addOption(hlslOption);
+    QCommandLineOption mslOption({ "m", "msl" },
+                                  QObject::tr("Comma separated list of Metal Shading Language versions to generate. F.ex. 12 is 1.2, 20 is 2.0."),
+                                  QObject::tr("versions"));
+    cmdLineParser.addOption(mslOption);
+    QCommandLineOption outputOption({ "o", "output" },
+                                     QObject::tr("Output file for the shader pack."),
+                                     QObject::tr("filename"));
+    cmdLineParser.addOption(outputOption);
+    QCommandLineOption fxcOption({ "c", "fxc" }, QObject::tr("In combination with --hlsl invokes fxc to store DXBC instead of HLSL."));
+    cmdLineParser.addOption(fxcOption);
+    QCommandLineOption mtllibOption({ "t", "metallib" },
+                                    QObject::tr("In combination with --msl builds a Metal library with xcrun metal(lib) and stores that instead of the source."));
+    cmdLineParser.addOption(mtllibOption);
+    QCommandLineOption defineOption({ "D", "define" }, QObject::tr("Define macro"), QObject::tr("name[=value]"));
+    cmdLineParser.addOption(defineOption);
+    QCommandLineOption defineFileOption("define-file", QObject::tr("Reads additional macro definitions from a file with one name[=value] per line. "
+                                                                   "In watch mode the file is watched too, and when it changes, only the shaders "
+                                                                   "referring to a macro whose definition changed get rebaked."),
+                                        QObject::tr("filename"));
+    cmdLineParser.addOption(defineFileOption);
+    QCommandLineOption specOption("spec", QObject::tr("Sets the value of the specialization constant with the given constant_id, "
+                                                      "turning it into a regular constant in all generated shaders."),
+                                  QObject::tr("id=value"));
+    cmdLineParser.addOption(specOption);
+    QCommandLineOption compressionOption({ "z", "compression-level" },
+                                         QObject::tr("zlib compression level for the shader pack, from 0 (store only, fastest to load) "
+                                                     "to 9 (smallest). Defaults to the zlib default."),
+                                         QObject::tr("level"));
+    cmdLineParser.addOption(compressionOption);
+    QCommandLineOption dumpOption({ "d", "dump" }, QObject::tr("Switches to dump mode. Input file is expected to be a shader pack."));
+    cmdLineParser.addOption(dumpOption);
+    QCommandLineOption extractOption({ "x", "extract" }, QObject::tr("Switches to extract mode. Input file is expected to be a shader pack. "
+                                                                     "Result is written to the output specified by -o. Pass -b to choose the batchable variant. "
+                                                                     "<what>=reflect|spirv.<version>|glsl.<version>|..."),
+                                     QObject::tr("what"));
+    cmdLineParser.addOption(extractOption);
+    QCommandLineOption compactSpirvOption("compact-spirv", QObject::tr("In combination with -x spirv.<version>, writes the SPIR-V in a compact encoding "
+                                                                       "that is smaller and compresses better. Such files are accepted as input "
+                                                                       "by qsb like regular .spv files."));
+    cmdLineParser.addOption(compactSpirvOption);
+    QCommandLineOption watchOption({ "w", "watch" }, QObject::tr("Keeps running after the initial bake, and rebakes whenever an input file "
+                                                                 "or one of the files it includes changes."));
+    cmdLineParser.addOption(watchOption);
+    QCommandLineOption pipelineOption({ "p", "pipeline" }, QObject::tr("Treats the input files as the stages of one graphics pipeline, in order, "
+                                                                       "and removes the outputs a stage produces that the next stage does not read. "
+                                                                       "The output specified by -o is a directory in this case."));
+    cmdLineParser.addOption(pipelineOption);
+    QCommandLineOption pruneOption("prune-with", QObject::tr("Switches to prune mode. Input files are expected to be shader packs. Removes the "
+                                                             "shaders the usage profile does not list, rewriting the packs in place, or to "
+                                                             "the output specified by -o (a directory with multiple inputs). "
+                                                             "Each line of the profile is <pack> <source>.<version> [batchable], "
+                                                             "for example \"texture.frag.qsb glsl.300es\"."),
+                                   QObject::tr("profile"));
+    cmdLineParser.addOption(pruneOption);
+    QCommandLineOption warmupOption("warmup-list", QObject::tr("In combination with --prune-with, writes the shaders kept to the given file, "
+                                                               "in the order the application first used them, in the profile format."),
+                                    QObject::tr("filename"));
+    cmdLineParser.addOption(warmupOption);
+    QCommandLineOption forceOption({ "f", "force" }, QObject::tr("Bakes even when the output is up to date. By default the bake is skipped "
+                                                                 "when the output was generated with the same settings from a source that "
+                                                                 "only differs in comments, whitespace, or inactive #if blocks. qsb "
+                                                                 "records what it needs for this in a trailer after the pack data, "
+                                                                 "which QShader ignores."));
+    cmdLineParser.addOption(forceOption);
+    QCommandLineOption fxcCommandOption("fxc-command", QObject::tr("Command to run for --fxc. {entry}, {profile}, {input} and {output} "
+                                                                   "are replaced by the entry point, the target profile, and the files. "
+                                                                   "Defaults to \"%1\".").arg(ToolSettings().fxcCommand),
+                                        QObject::tr("command"));
+    cmdLineParser.addOption(fxcCommandOption);
+    QCommandLineOption metalCommandOption("metal-command", QObject::tr("Command to compile MSL with for --metallib. "
+                                                                       "Defaults to \"%1\".").arg(ToolSettings().metalCommand),
+                                          QObject::tr("command"));
+    cmdLineParser.addOption(metalCommandOption);
+    QCommandLineOption metallibCommandOption("metallib-command", QObject::tr("Command to create the Metal library with for --metallib. "
+                                                                             "Defaults to \"%1\".").arg(ToolSettings().metallibCommand),
+                                             QObject::tr("command"));
+    cmdLineParser.addOption(metallibCommandOption);
+    QCommandLineOption toolCacheOption("tool-cache", QObject::tr("Caches the results of --fxc and --metallib in the given directory, keyed by "
+                                                                 "the generated source, the profile, and the version of the tools."),
+                                       QObject::tr("dir"));
+    cmdLineParser.addOption(toolCacheOption);
+    QCommandLineOption jobsOption({ "j", "jobs" }, QObject::tr("Maximum number of --fxc and --metallib runs, or of packs summarized "
+                                                               "by --dump-json, in parallel. "
+                                                               "Defaults to the number of CPU cores."),
+                                  QObject::tr("count"));
+    cmdLineParser.addOption(jobsOption);
+    QCommandLineOption retargetOption("retarget", QObject::tr("Switches to retarget mode. Input files are expected to be shader packs. "
+                                                              "The targets given by --glsl, --hlsl and --msl are generated from the "
+                                                              "SPIR-V in the packs, standard and batchable, and added to them. "
+                                                              "The packs are updated in place unless -o is given."));
+    cmdLineParser.addOption(retargetOption);
+    QCommandLineOption mergeOption("merge", QObject::tr("Switches to merge mode. Input files are expected to be shader packs for the "
+                                                        "same shader, which are combined into the pack given by -o."));
+    cmdLineParser.addOption(mergeOption);
+    QCommandLineOption stripOption("strip", QObject::tr("Removes shaders from the input packs. Takes a comma separated list of "
+                                                        "<source>.<version> keys as in -x (e.g. hlsl.50), or sources (e.g. msl) to "
+                                                        "remove all versions, or batchable to remove the batchable variants. "
+                                                        "The packs are updated in place unless -o is given."),
+                                   QObject::tr("keys"));
+    cmdLineParser.addOption(stripOption);
+    QCommandLineOption splitOption("split", QObject::tr("Splits the input packs per graphics API. The output directory given by -o "
+                                                        "receives vulkan, opengl, d3d and metal subdirectories, each with packs "
+                                                        "that only contain the shaders for that API."));
+    cmdLineParser.addOption(splitOption);
+    QCommandLineOption analyzeOption("analyze", QObject::tr("Switches to analyze mode. Input files are expected to be shader packs. "
+                                                            "Prints a static estimate of the cost of their SPIR-V: instruction counts, "
+                                                            "live values, and interface sizes."));
+    cmdLineParser.addOption(analyzeOption);
+    QCommandLineOption budgetOption("budget", QObject::tr("In analyze mode, fails when a shader exceeds one of the given limits. "
+                                                          "Takes a comma separated list of [<stage>.]<metric>=<max> entries, such as "
+                                                          "fragment.texture=8,live=64, or @<file> with one entry per line. Stages are "
+                                                          "vertex, tessellationcontrol, tessellationevaluation, geometry, fragment "
+                                                          "and compute. Metrics are instructions, alu, texture, branches, loops, live, "
+                                                          "inputs, outputs, uniforms and samplers."),
+                                    QObject::tr("limits"));
+    cmdLineParser.addOption(budgetOption);
+    QCommandLineOption dumpJsonOption("dump-json", QObject::tr("Switches to JSON dump mode. Input files are expected to be shader packs. "
+                                                               "Prints a summary of each pack as one line of compact JSON: the keys, "
+                                                               "sizes, entry points and native binding maps of the shaders, and a hash "
+                                                               "of the reflection data. The packs are processed in parallel, see -j."));
+    cmdLineParser.addOption(dumpJsonOption);
+
+    cmdLineParser.process(app);
+
+    if (cmdLineParser.positionalArguments().isEmpty()) {
+        cmdLineParser.showHelp();
+        return 0;
+    }
+
+    if (cmdLineParser.isSet(dumpJsonOption)) {
+        const int jobs = cmdLineParser.isSet(jobsOption) ? cmdLineParser.value(jobsOption).toInt() : 0;
+        return dumpPackSummaries(cmdLineParser.positionalArguments(), jobs) ? 0 : 1;
+    }
+
+    if (cmdLineParser.isSet(analyzeOption)) {
+        QVector<CostBudget> budget;
+        if (cmdLineParser.isSet(budgetOption) && !parseBudget(cmdLineParser.value(budgetOption), &budget))
+            return 1;
+        return analyzeShaderPacks(cmdLineParser.positionalArguments(), budget) ? 0 : 1;
+    }
+
+    if (cmdLineParser.isSet(dumpOption) || cmdLineParser.isSet(extractOption)) {
+        for (const QString &fn : cmdLineParser.positionalArguments()) {
+            QByteArray buf = readFile(fn);
+            if (!buf.isEmpty()) {
+                QShader bs = QShader::fromSerialized(buf);
+                if (bs.isValid()) {
+                    if (cmdLineParser.isSet(dumpOption)) {
+                        dump(bs);
+                    } else {
+                        if (cmdLineParser.isSet(outputOption)) {
+                            extract(bs, cmdLineParser.value(extractOption), cmdLineParser.isSet(batchableOption),
+                                    cmdLineParser.isSet(compactSpirvOption), cmdLineParser.value(outputOption));
+                        } else {
+                            qWarning("No output file specified");
+                        }
+                    }
+                } else {
+                    qWarning("Failed to deserialize %s", qPrintable(fn));
+                }
+            }
+        }
+        return 0;
+    }
+
+    BakeSettings settings;
+
+    settings.variants << QShader::StandardShader;
+    if (cmdLineParser.isSet(batchableOption)) {
+        settings.variants << QShader::BatchableVertexShader;
+        if (cmdLineParser.isSet(batchLocOption))
+            settings.batchLoc = cmdLineParser.value(batchLocOption).toInt();
+    }
+
+    settings.genShaders << qMakePair(QShader::SpirvShader, QShaderVersion(100));
+
+    if (cmdLineParser.isSet(glslOption)) {
+        const QStringList versions = cmdLineParser.value(glslOption).trimmed().split(',');
+        for (QString version : versions) {
+            QShaderVersion::Flags flags;
+            if (version.endsWith(QLatin1String(" es"))) {
+                version = version.left(version.count() - 3);
+                flags |= QShaderVersion::GlslEs;
+            } else if (version.endsWith(QLatin1String("es"))) {
+                version = version.left(version.count() - 2);
+                flags |= QShaderVersion::GlslEs;
+            }
+            bool ok = false;
+            int v = version.toInt(&ok);
+            if (ok)
+                settings.genShaders << qMakePair(QShader::GlslShader, QShaderVersion(v, flags));
+            else
+                qWarning("Ignoring invalid GLSL version %s", qPrintable(version));
+        }
+    }
+
+    if (cmdLineParser.isSet(hlslOption)) {
+        const QStringList versions = cmdLineParser.value(hlslOption).trimmed().split(',');
+        for (QString version : versions) {
+            bool ok = false;
+            int v = version.toInt(&ok);
+            if (ok)
+                settings.genShaders << qMakePair(QShader::HlslShader, QShaderVersion(v));
+            else
+                qWarning("Ignoring invalid HLSL (Shader Model) version %s", qPrintable(version));
+        }
+    }
+
+    if (cmdLineParser.isSet(mslOption)) {
+        const QStringList versions = cmdLineParser.value(mslOption).trimmed().split(',');
+        for (QString version : versions) {
+            bool ok = false;
+            int v = version.toInt(&ok);
+            if (ok)
+                settings.genShaders << qMakePair(QShader::MslShader, QShaderVersion(v));
+            else
+                qWarning("Ignoring invalid MSL version %s", qPrintable(version));
+        }
+    }
+
+    const QStringList defines = cmdLineParser.values(defineOption);
+    QStringList allDefines = defines;
+    if (cmdLineParser.isSet(defineFileOption) && !readDefineFile(cmdLineParser.value(defineFileOption), &allDefines))
+        return 1;
+    settings.preamble = definesToPreamble(allDefines);
+
+    if (cmdLineParser.isSet(specOption)) {
+        const QStringList specs = cmdLineParser.values(specOption);
+        for (const QString &spec : specs) {
+            const int sep = spec.indexOf(QLatin1Char('='));
+            bool ok = false;
+            const int id = sep > 0 ? spec.left(sep).trimmed().toInt(&ok) : -1;
+            if (ok && id >= 0)
+                settings.specConstants.insert(id, spec.mid(sep + 1).trimmed());
+            else
+                qWarning("Ignoring invalid specialization constant %s", qPrintable(spec));
+        }
+    }
+
+    settings.fxc = cmdLineParser.isSet(fxcOption);
+    settings.metallib = cmdLineParser.isSet(mtllibOption);
+    if (cmdLineParser.isSet(compressionOption)) {
+        bool ok = false;
+        const int level = cmdLineParser.value(compressionOption).toInt(&ok);
+        if (ok && level >= 0 && level <= 9)
+            settings.compressionLevel = level;
+        else
+            qWarning("Ignoring invalid compression level %s", qPrintable(cmdLineParser.value(compressionOption)));
+    }
+    if (cmdLineParser.isSet(outputOption))
+        settings.outputFileName = cmdLineParser.value(outputOption);
+    settings.force = cmdLineParser.isSet(forceOption);
+    if (cmdLineParser.isSet(fxcCommandOption))
+        settings.tools.fxcCommand = cmdLineParser.value(fxcCommandOption);
+    if (cmdLineParser.isSet(metalCommandOption))
+        settings.tools.metalCommand = cmdLineParser.value(metalCommandOption);
+    if (cmdLineParser.isSet(metallibCommandOption))
+        settings.tools.metallibCommand = cmdLineParser.value(metallibCommandOption);
+    if (cmdLineParser.isSet(toolCacheOption)) {
+        settings.tools.cacheDir = cmdLineParser.value(toolCacheOption);
+        if (!QDir().mkpath(settings.tools.cacheDir)) {
+            qWarning("Failed to create %s, not caching tool results", qPrintable(settings.tools.cacheDir));
+            settings.tools.cacheDir.clear();
+        }
+    }
+    if (cmdLineParser.isSet(jobsOption)) {
+        bool ok = false;
+        const int jobs = cmdLineParser.value(jobsOption).toInt(&ok);
+        if (ok && jobs > 0)
+            settings.tools.jobs = jobs;
+        else
+            qWarning("Ignoring invalid job count %s", qPrintable(cmdLineParser.value(jobsOption)));
+    }
+
+    if (cmdLineParser.isSet(mergeOption))
+        return mergeShaderPacks(cmdLineParser.positionalArguments(), settings) ? 0 : 1;
+
+    if (cmdLineParser.isSet(stripOption))
+        return stripShaderPacks(cmdLineParser.positionalArguments(), cmdLineParser.value(stripOption), settings) ? 0 : 1;
+
+    if (cmdLineParser.isSet(splitOption))
+        return splitShaderPacks(cmdLineParser.positionalArguments(), settings) ? 0 : 1;
+
+    if (cmdLineParser.isSet(retargetOption))
+        return retargetShaderPacks(cmdLineParser.positionalArguments(), settings) ? 0 : 1;
+
+    if (cmdLineParser.isSet(pruneOption)) {
+        return pruneShaderPacks(cmdLineParser.positionalArguments(), cmdLineParser.value(pruneOption),
+                                cmdLineParser.value(warmupOption), settings) ? 0 : 1;
+    }
+
+    // Keep using the same baker, so that anything that can be kept warm
+    // between bakes (such as glslang's built-in symbol tables) is reused.
+    QShaderBaker baker;
+    QShaderBakerPrivate::get(&baker)->skipUnknownSpecConstants = true;
+    QSet<int> specializedIds;
+
+    if (cmdLineParser.isSet(pipelineOption)) {
+        if (cmdLineParser.isSet(watchOption))
+            qWarning("Watch mode is not supported with --pipeline, ignoring");
+        return bakePipelineFiles(&baker, cmdLineParser.positionalArguments(), settings) ? 0 : 1;
+    }
+
+    if (cmdLineParser.isSet(watchOption)) {
+        Watcher watcher(&baker, settings, defines, cmdLineParser.value(defineFileOption));
+        for (const QString &fn : cmdLineParser.positionalArguments()) {
+            QElapsedTimer timer;
+            timer.start();
+            const bool ok = bakeFile(&baker, fn, settings);
+            if (ok)
+                qDebug("Baked %s in %lld ms", qPrintable(fn), timer.elapsed());
+            specializedIds += QShaderBakerPrivate::get(&baker)->specializedIds;
+            watcher.addInput(fn, ok);
+        }
+        checkSpecConstants(settings, specializedIds);
+        qDebug("Watching for changes, press Ctrl+C to exit");
+        return app.exec();
+    }
+
+    for (const QString &fn : cmdLineParser.positionalArguments()) {
+        if (!bakeFile(&baker, fn, settings))
+            return 1;
+        specializedIds += QShaderBakerPrivate::get(&baker)->specializedIds;
     }
 
-    return 0;
+    return checkSpecConstants(settings, specializedIds) ? 0 : 1;
 }
@@ -1,5 +1,5 @@
 SOURCES += qsb.cpp
 
-QT += shadertools gui-private
+QT += shadertools shadertools-private gui-private
 
 load(qt_tool)